@@ -3,11 +3,35 @@
 // for antibot module
 //-----------------------------------------------------
 #include <antibot/antibot.h>
+#include <checkqueue.h>
 #include <index/addrindex.h>
 
 //-----------------------------------------------------
 std::unique_ptr <AntiBot> g_antibot;
 //-----------------------------------------------------
+static CCheckQueue<CAntiBotCheck> antibotcheckqueue(16);
+
+void ThreadAntiBotCheck()
+{
+    RenameThread("pocketcoin-antibot");
+    antibotcheckqueue.Thread();
+}
+
+bool CAntiBotCheck::operator()()
+{
+    for (auto& item : items)
+    {
+        ANTIBOTRESULT& resultCode = (*results)[item.first];
+        antibot->CheckTransactionRIItem(*item.second, *blockVtx, false, height, resultCode);
+
+        // Next items of this address can't be first failure of block
+        if (resultCode != ANTIBOTRESULT::Success)
+            break;
+    }
+
+    return true;
+}
+//-----------------------------------------------------
 AntiBot::AntiBot()
 {
 }
@@ -175,7 +199,7 @@ bool AntiBot::CheckRegistration(UniValue oitm, std::string address, bool checkMe
     // Or maybe registration in this block?
     if (userType < 0 && blockVtx.Exists("Users"))
     {
-        for (auto& mtx : blockVtx.Data["Users"])
+        for (const UniValue& mtx : blockVtx.Find("Users", BlockVTXAddress, address))
         {
             if (mtx["txid"].get_str() != txId && mtx["address"].get_str() == address)
             {
@@ -339,7 +363,7 @@ bool AntiBot::check_post(const UniValue oitm, BlockVTX& blockVtx, bool checkMemp
     // Check block
     if (blockVtx.Exists("Posts"))
     {
-        for (auto& mtx : blockVtx.Data["Posts"])
+        for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXAddress, _address))
         {
             if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address &&
                 mtx["txidEdit"].get_str().empty())
@@ -443,7 +467,7 @@ bool AntiBot::check_post_edit(const UniValue& oitm, BlockVTX& blockVtx, bool che
     // Double edit in block denied
     if (blockVtx.Exists("Posts"))
     {
-        for (auto& mtx : blockVtx.Data["Posts"])
+        for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXTxid, _txid))
         {
             if (mtx["txid"].get_str() == _txid && mtx["txidEdit"].get_str() != _txidEdit)
             {
@@ -561,7 +585,7 @@ bool AntiBot::check_video(const UniValue oitm, BlockVTX& blockVtx, bool checkMem
     // Check block
     if (blockVtx.Exists("Posts"))
     {
-        for (auto& mtx : blockVtx.Data["Posts"])
+        for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXAddress, _address))
         {
             if (mtx["txid"].get_str() != _txid &&
                 mtx["address"].get_str() == _address &&
@@ -650,7 +674,7 @@ bool AntiBot::check_video_edit(const UniValue& oitm, BlockVTX& blockVtx, bool ch
     // Double edit in block denied
     if (blockVtx.Exists("Posts"))
     {
-        for (auto& mtx : blockVtx.Data["Posts"])
+        for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXTxid, _txid))
         {
             if (mtx["txid"].get_str() == _txid && mtx["txidEdit"].get_str() != _txidEdit)
             {
@@ -756,7 +780,7 @@ bool AntiBot::check_score(const UniValue oitm, BlockVTX& blockVtx, bool checkMem
         // Maybe in current block?
         if (blockVtx.Exists("Posts"))
         {
-            for (auto& mtx : blockVtx.Data["Posts"])
+            for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXTxid, _post))
             {
                 if (mtx["txid"].get_str() == _post)
                 {
@@ -788,8 +812,8 @@ bool AntiBot::check_score(const UniValue oitm, BlockVTX& blockVtx, bool checkMem
     reindexer::Item doubleScoreItm;
     if (g_pocketdb->SelectOne(
             reindexer::Query("Scores")
-                .Where("address", CondEq, _address)
-                .Where("posttxid", CondEq, _post)
+                .Where("address_id", CondEq, g_pocketdb->GetKeyId(_address))
+                .Where("posttxid_id", CondEq, g_pocketdb->GetKeyId(_post))
                 .Where("block", CondLt, height),
             doubleScoreItm)
         .ok())
@@ -802,7 +826,7 @@ bool AntiBot::check_score(const UniValue oitm, BlockVTX& blockVtx, bool checkMem
     int scoresCount = 0;
 
     // Calculate in DB
-    auto query = reindexer::Query("Scores").Where("address", CondEq, _address).Where("block", CondLt, height);
+    auto query = reindexer::Query("Scores").Where("address_id", CondEq, g_pocketdb->GetKeyId(_address)).Where("block", CondLt, height);
     if (checkTime_19_6) query = query.Where("time", CondGe, _time - 86400);
     else query = query.Where("block", CondGe, height - 1440);
     scoresCount += g_pocketdb->SelectCount(query);
@@ -841,7 +865,7 @@ bool AntiBot::check_score(const UniValue oitm, BlockVTX& blockVtx, bool checkMem
     // Check block
     if (blockVtx.Exists("Scores"))
     {
-        for (auto& mtx : blockVtx.Data["Scores"])
+        for (const UniValue& mtx : blockVtx.Find("Scores", BlockVTXAddress, _address))
         {
             if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address)
             {
@@ -926,7 +950,7 @@ bool AntiBot::check_complain(const UniValue oitm, BlockVTX& blockVtx, bool check
         // Maybe in current block?
         if (blockVtx.Exists("Posts"))
         {
-            for (auto& mtx : blockVtx.Data["Posts"])
+            for (const UniValue& mtx : blockVtx.Find("Posts", BlockVTXTxid, _post))
             {
                 if (mtx["txid"].get_str() == _post)
                 {
@@ -1012,7 +1036,7 @@ bool AntiBot::check_complain(const UniValue oitm, BlockVTX& blockVtx, bool check
     // Check block
     if (blockVtx.Exists("Complains"))
     {
-        for (auto& mtx : blockVtx.Data["Complains"])
+        for (const UniValue& mtx : blockVtx.Find("Complains", BlockVTXAddress, _address))
         {
             if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address)
             {
@@ -1108,7 +1132,7 @@ bool AntiBot::check_changeInfo(const UniValue oitm, BlockVTX& blockVtx, bool che
     // Check block
     if (blockVtx.Exists("Users"))
     {
-        for (auto& mtx : blockVtx.Data["Users"])
+        for (const UniValue& mtx : blockVtx.Find("Users", BlockVTXAddress, _address))
         {
             if (mtx["address"].get_str() == _address && mtx["txid"].get_str() != _txid)
             {
@@ -1199,7 +1223,7 @@ bool AntiBot::check_subscribe(const UniValue oitm, BlockVTX& blockVtx, bool chec
     // Check block
     if (blockVtx.Exists("Subscribes"))
     {
-        for (auto& mtx : blockVtx.Data["Subscribes"])
+        for (const UniValue& mtx : blockVtx.Find("Subscribes", BlockVTXAddressTo, BlockVTX::AddressToKey(_address, _address_to)))
         {
             if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address &&
                 mtx["address_to"].get_str() == _address_to)
@@ -1304,7 +1328,7 @@ bool AntiBot::check_blocking(const UniValue oitm, BlockVTX& blockVtx, bool check
     // Check block
     if (blockVtx.Exists("Blocking"))
     {
-        for (auto& mtx : blockVtx.Data["Blocking"])
+        for (const UniValue& mtx : blockVtx.Find("Blocking", BlockVTXAddressTo, BlockVTX::AddressToKey(_address, _address_to)))
         {
             if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address &&
                 mtx["address_to"].get_str() == _address_to)
@@ -1437,7 +1461,7 @@ bool AntiBot::check_comment(const UniValue oitm, BlockVTX& blockVtx, bool checkM
         // Check block
         if (blockVtx.Exists("Comment"))
         {
-            for (auto& mtx : blockVtx.Data["Comment"])
+            for (const UniValue& mtx : blockVtx.Find("Comment", BlockVTXAddress, _address))
             {
                 if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address &&
                     mtx["otxid"].get_str() == mtx["txid"].get_str())
@@ -1555,7 +1579,7 @@ bool AntiBot::check_comment_edit(const UniValue oitm, BlockVTX& blockVtx, bool c
     // Double edit in block denied
     if (blockVtx.Exists("Comment"))
     {
-        for (auto& mtx : blockVtx.Data["Comment"])
+        for (const UniValue& mtx : blockVtx.Find("Comment", BlockVTXOtxid, _otxid))
         {
             if (mtx["txid"].get_str() != _txid && mtx["otxid"].get_str() == _otxid)
             {
@@ -1661,7 +1685,7 @@ bool AntiBot::check_comment_delete(const UniValue oitm, BlockVTX& blockVtx, bool
     // Double delete in block denied
     if (blockVtx.Exists("Comment"))
     {
-        for (auto& mtx : blockVtx.Data["Comment"])
+        for (const UniValue& mtx : blockVtx.Find("Comment", BlockVTXOtxid, _otxid))
         {
             if (mtx["txid"].get_str() != _txid && mtx["otxid"].get_str() == _otxid)
             {
@@ -1744,7 +1768,7 @@ bool AntiBot::check_comment_score(const UniValue oitm, BlockVTX& blockVtx, bool
         // Maybe in current block?
         if (blockVtx.Exists("Comment"))
         {
-            for (auto& mtx : blockVtx.Data["Comment"])
+            for (const UniValue& mtx : blockVtx.Find("Comment", BlockVTXOtxid, _comment_id))
             {
                 if (mtx["otxid"].get_str() == _comment_id && mtx["msg"].get_str() != "")
                 {
@@ -1829,7 +1853,7 @@ bool AntiBot::check_comment_score(const UniValue oitm, BlockVTX& blockVtx, bool
         // Check block
         if (blockVtx.Exists("CommentScores"))
         {
-            for (auto& mtx : blockVtx.Data["CommentScores"])
+            for (const UniValue& mtx : blockVtx.Find("CommentScores", BlockVTXAddress, _address))
             {
                 if (mtx["txid"].get_str() != _txid && mtx["address"].get_str() == _address)
                 {
@@ -2015,20 +2039,60 @@ bool AntiBot::CheckInputs(CTransactionRef& tx)
 
 bool AntiBot::CheckBlock(BlockVTX& blockVtx, int height)
 {
+    // All items of block in check order <table, item>
+    std::vector<std::pair<std::string, const UniValue*>> items;
     for (auto& t : blockVtx.Data)
     {
         for (auto& mtx : t.second)
+            items.emplace_back(t.first, &mtx);
+    }
+
+    std::vector<ANTIBOTRESULT> results(items.size(), ANTIBOTRESULT::Success);
+
+    if (nScriptCheckThreads > 1 && items.size() > 1)
+    {
+        // Items of one address checked serially, addresses - in parallel
+        std::map<std::string, CAntiBotCheck> checksByAddress;
+        for (size_t i = 0; i < items.size(); i++)
         {
-            ANTIBOTRESULT resultCode = ANTIBOTRESULT::Success;
-            CheckTransactionRIItem(mtx, blockVtx, false, height, resultCode);
-            if (resultCode != ANTIBOTRESULT::Success)
-            {
-                LogPrintf("Transaction check with the AntiBot failed (%s) %s %s\n", mtx["txid"].get_str(), resultCode,
-                    t.first);
+            std::string address = find_value(*items[i].second, "address").getValStr();
 
-                // Skip next transactions - already error
-                return false;
-            }
+            auto it = checksByAddress.find(address);
+            if (it == checksByAddress.end())
+                it = checksByAddress.emplace(address, CAntiBotCheck(this, &blockVtx, height, &results)).first;
+
+            it->second.Add(i, items[i].second);
+        }
+
+        std::vector<CAntiBotCheck> vChecks(checksByAddress.size());
+        size_t i = 0;
+        for (auto& check : checksByAddress)
+            vChecks[i++].swap(check.second);
+
+        CCheckQueueControl<CAntiBotCheck> control(&antibotcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    else
+    {
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            CheckTransactionRIItem(*items[i].second, blockVtx, false, height, results[i]);
+            if (results[i] != ANTIBOTRESULT::Success)
+                break;
+        }
+    }
+
+    // First failure in block order
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (results[i] != ANTIBOTRESULT::Success)
+        {
+            LogPrintf("Transaction check with the AntiBot failed (%s) %s %s\n", find_value(*items[i].second, "txid").getValStr(), results[i],
+                items[i].first);
+
+            // Skip next transactions - already error
+            return false;
         }
     }
 
@@ -2148,7 +2212,7 @@ bool AntiBot::AllowModifyReputationOverPost(std::string _score_address, std::str
     // TODO (brangr): change time to blocks
     size_t scores_one_to_one_count = g_pocketdb->SelectCount(
         reindexer::Query("Scores")
-            .Where("address", CondEq, _score_address)
+            .Where("address_id", CondEq, g_pocketdb->GetKeyId(_score_address))
             .Where("time", CondGe, tx_time - _scores_one_to_one_depth)
             .Where("time", CondLt, tx_time)
             .Where("block", CondLe, blockHeight)
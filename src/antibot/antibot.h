@@ -12,6 +12,8 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <timedata.h>
+#include <functional>
+#include <unordered_map>
 //-----------------------------------------------------
 struct UserStateItem {
     std::string address;
@@ -147,9 +149,42 @@ enum ANTIBOTRESULT {
     ChangeTxType = 45
 };
 //-----------------------------------------------------
+enum BlockVTXIndex {
+    BlockVTXAddress = 0,   // address
+    BlockVTXAddressTo = 1, // address + address_to
+    BlockVTXTxid = 2,      // txid
+    BlockVTXOtxid = 3,     // otxid
+};
+
 struct BlockVTX {
     std::map<std::string, std::vector<UniValue>> Data;
 
+    // Hash indexes over Data
+    // <<index, table>, <key, positions in Data[table]>>
+    std::map<std::pair<int, std::string>, std::unordered_map<std::string, std::vector<size_t>>> Indexes;
+
+    static std::string AddressToKey(const std::string& address, const std::string& address_to)
+    {
+        return address + ":" + address_to;
+    }
+
+    static std::string IndexKey(BlockVTXIndex index, const UniValue& itm)
+    {
+        switch (index) {
+        case BlockVTXAddress:
+            return find_value(itm, "address").getValStr();
+        case BlockVTXAddressTo:
+            if (find_value(itm, "address_to").isNull()) return "";
+            return AddressToKey(find_value(itm, "address").getValStr(), find_value(itm, "address_to").getValStr());
+        case BlockVTXTxid:
+            return find_value(itm, "txid").getValStr();
+        case BlockVTXOtxid:
+            return find_value(itm, "otxid").getValStr();
+        default:
+            return "";
+        }
+    }
+
     size_t Size()
     {
         return Data.size();
@@ -162,6 +197,12 @@ struct BlockVTX {
             Data.insert_or_assign(table, vtxri);
         }
 
+        size_t pos = Data[table].size();
+        for (int index = BlockVTXAddress; index <= BlockVTXOtxid; index++) {
+            std::string key = IndexKey((BlockVTXIndex)index, itm);
+            if (!key.empty()) Indexes[{index, table}][key].push_back(pos);
+        }
+
         Data[table].push_back(itm);
     }
 
@@ -170,8 +211,30 @@ struct BlockVTX {
         return Data.find(table) != Data.end();
     }
 
+    // Items of table with key in index, in order of adding
+    std::vector<std::reference_wrapper<const UniValue>> Find(const std::string& table, BlockVTXIndex index, const std::string& key) const
+    {
+        std::vector<std::reference_wrapper<const UniValue>> result;
+
+        auto itIndex = Indexes.find({index, table});
+        if (itIndex == Indexes.end()) return result;
+
+        auto itKey = itIndex->second.find(key);
+        if (itKey == itIndex->second.end()) return result;
+
+        const std::vector<UniValue>& items = Data.at(table);
+        for (size_t pos : itKey->second) result.emplace_back(items[pos]);
+        return result;
+    }
+
     void RemoveLast(std::string table) {
-        if (Data.find(table) != Data.end()) {
+        if (Data.find(table) != Data.end() && !Data[table].empty()) {
+            const UniValue& itm = Data[table].back();
+            for (int index = BlockVTXAddress; index <= BlockVTXOtxid; index++) {
+                std::string key = IndexKey((BlockVTXIndex)index, itm);
+                if (!key.empty()) Indexes[{index, table}][key].pop_back();
+            }
+
             Data[table].pop_back();
         }
     }
@@ -253,6 +316,44 @@ public:
     bool AllowModifyReputationOverComment(std::string _score_address, std::string _comment_address, int height, const CTransactionRef& tx, bool lottery);
 };
 //-----------------------------------------------------
+/*
+    Closure of antibot checks for all block items of one address.
+    Result of every item written to own slot by index of item in block,
+    so first failure of block not depends on order of execution.
+*/
+class CAntiBotCheck
+{
+private:
+    AntiBot* antibot;
+    BlockVTX* blockVtx;
+    int height;
+    std::vector<ANTIBOTRESULT>* results;
+    // <index of item in block, item>
+    std::vector<std::pair<size_t, const UniValue*>> items;
+
+public:
+    CAntiBotCheck() : antibot(nullptr), blockVtx(nullptr), height(0), results(nullptr) {}
+    CAntiBotCheck(AntiBot* _antibot, BlockVTX* _blockVtx, int _height, std::vector<ANTIBOTRESULT>* _results)
+        : antibot(_antibot), blockVtx(_blockVtx), height(_height), results(_results) {}
+
+    void Add(size_t index, const UniValue* item) { items.emplace_back(index, item); }
+
+    // Always true - results returned through slots
+    bool operator()();
+
+    void swap(CAntiBotCheck& check)
+    {
+        std::swap(antibot, check.antibot);
+        std::swap(blockVtx, check.blockVtx);
+        std::swap(height, check.height);
+        std::swap(results, check.results);
+        items.swap(check.items);
+    }
+};
+
+/* Run an instance of the antibot checking thread */
+void ThreadAntiBotCheck();
+//-----------------------------------------------------
 extern std::unique_ptr<AntiBot> g_antibot;
 //-----------------------------------------------------
 #endif // ADDRINDEX_H
\ No newline at end of file
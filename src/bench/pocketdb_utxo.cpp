@@ -0,0 +1,127 @@
+// Copyright (c) 2018 PocketNet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <pocketdb/pocketdb.h>
+#include <chainparams.h>
+#include <fs.h>
+#include <random.h>
+#include <util.h>
+#include <utiltime.h>
+
+// One iteration indexes UTXO changes of one synthetic block:
+// every tx creates two outputs and spends both outputs of a tx from previous block.
+// Blocks per second = 1 / average iteration time.
+static const int BENCH_BLOCK_TXS = 250;
+
+// Every run writes into fresh database in temporary datadir, so runs are comparable
+static fs::path InitBenchPocketDB()
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    fs::path path = fs::temp_directory_path() / "bench_pocketcoin" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)GetRand(1 << 30));
+    fs::create_directories(path);
+    gArgs.ForceSetArg("-datadir", path.string());
+    ClearDatadirCache();
+
+    g_pocketdb.reset(new PocketDB());
+    bool inited = g_pocketdb->Init();
+    assert(inited);
+
+    return path;
+}
+
+static void ShutdownBenchPocketDB(const fs::path& path)
+{
+    g_pocketdb->DropTable("UTXO");
+    g_pocketdb.reset();
+
+    gArgs.ForceSetArg("-datadir", "");
+    ClearDatadirCache();
+    fs::remove_all(path);
+}
+
+static UTXOBatch MakeBlockBatch(int height, const std::vector<std::string>& prevTxids, std::vector<std::string>& txids)
+{
+    UTXOBatch batch(height);
+    txids.clear();
+
+    for (int i = 0; i < BENCH_BLOCK_TXS; i++) {
+        std::string txid = GetRandHash().GetHex();
+        txids.push_back(txid);
+
+        batch.outs.push_back({"addr" + std::to_string(i), txid, 0, height, 100});
+        batch.outs.push_back({"addr" + std::to_string(i + 1), txid, 1, height, 100});
+
+        if (i < (int)prevTxids.size()) {
+            batch.spents.emplace_back(prevTxids[i], 0);
+            batch.spents.emplace_back(prevTxids[i], 1);
+        }
+    }
+
+    return batch;
+}
+
+// Old way: select every spent output separately. Commit of reindexer is a no-op,
+// difference of both benches is lookups of spent outputs only
+static void PocketDBUTXOPerRow(benchmark::State& state)
+{
+    fs::path path = InitBenchPocketDB();
+
+    int height = 1;
+    std::vector<std::string> prevTxids, txids;
+    while (state.KeepRunning()) {
+        UTXOBatch batch = MakeBlockBatch(height, prevTxids, txids);
+
+        for (const auto& out : batch.outs) {
+            Item item = g_pocketdb->DB()->NewItem("UTXO");
+            item["address"] = out.address;
+            item["txid"] = out.txid;
+            item["block"] = batch.height;
+            item["txout"] = out.txout;
+            item["time"] = out.time;
+            item["amount"] = out.amount;
+            item["spent_block"] = 0;
+            g_pocketdb->UpsertWithCommit("UTXO", item);
+        }
+
+        for (const auto& spent : batch.spents) {
+            QueryResults res;
+            Error err = g_pocketdb->DB()->Select(Query("UTXO", 0, 1).WhereComposite("txid+txout", CondEq, {{Variant(spent.first), Variant(spent.second)}}), res);
+            if (err.ok() && res.Count() > 0) {
+                Item item = res[0].GetItem();
+                item["spent_block"] = batch.height;
+                g_pocketdb->UpsertWithCommit("UTXO", item);
+            }
+        }
+
+        prevTxids.swap(txids);
+        height++;
+    }
+
+    ShutdownBenchPocketDB(path);
+}
+
+static void PocketDBUTXOBatch(benchmark::State& state)
+{
+    fs::path path = InitBenchPocketDB();
+
+    int height = 1;
+    std::vector<std::string> prevTxids, txids;
+    while (state.KeepRunning()) {
+        UTXOBatch batch = MakeBlockBatch(height, prevTxids, txids);
+
+        Error err = g_pocketdb->WriteUTXOBatch(batch);
+        assert(err.ok());
+
+        prevTxids.swap(txids);
+        height++;
+    }
+
+    ShutdownBenchPocketDB(path);
+}
+
+BENCHMARK(PocketDBUTXOPerRow, 5);
+BENCHMARK(PocketDBUTXOBatch, 5);
@@ -11,6 +11,7 @@
 #include <random.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
+#include <rpc/stream.h>
 #include <stdio.h>
 #include <sync.h>
 #include <ui_interface.h>
@@ -187,7 +188,8 @@ static bool HTTPReq(HTTPRequest* req, bool rpcAuthenticate)
             }
         }
 
-        if (!valRequest.read(req->ReadBody()))
+        std::string strRequest = req->ReadBody();
+        if (!valRequest.read(strRequest))
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
             
         // Set the URI
@@ -217,10 +219,37 @@ static bool HTTPReq(HTTPRequest* req, bool rpcAuthenticate)
 
             jreq.parse(valRequest);
 
+            // Large results can be sent part by part with chunked reply
+            // Envelope same as JSONRPCResultReply
+            bool replyStarted = false;
+            JSONStreamWriter stream([req, &replyStarted](const std::string& chunk) {
+                if (!replyStarted) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->WriteReplyStart(HTTP_OK);
+                    replyStarted = true;
+                }
+                if (!req->WriteReplyChunk(chunk))
+                    throw JSONRPCError(RPC_MISC_ERROR, "Connection closed");
+            }, "{\"result\":");
+            jreq.stream = &stream;
+
             auto start = gStatEngineInstance.GetCurrentSystemTime();
 
-            UniValue result = tableRPC.execute(jreq);
-            
+            // Reply serialized once - for send and for statistic
+            try {
+                strReply = tableRPC.executeReply(jreq);
+                if (stream.Written())
+                    strReply = stream.Finish(",\"error\":null,\"id\":" + jreq.id.write() + "}\n");
+            } catch (...) {
+                // Part of result already sent - reply can be only closed
+                if (stream.Flushed()) {
+                    LogPrint(BCLog::RPC, "RPC Method %s interrupted after %d bytes\n", jreq.strMethod, stream.Size());
+                    req->WriteReplyEnd();
+                    return false;
+                }
+                throw;
+            }
+
             auto stop = gStatEngineInstance.GetCurrentSystemTime();
 
             gStatEngineInstance.AddSample(
@@ -229,16 +258,18 @@ static bool HTTPReq(HTTPRequest* req, bool rpcAuthenticate)
                     start,
                     stop,
                     jreq.peerAddr.substr(0, jreq.peerAddr.find(':')),
-                    valRequest.write().size(),
-                    result.write().size()
+                    strRequest.size(),
+                    stream.Flushed() ? stream.Size() : strReply.size()
                 }
             );
 
             auto diff = (stop - start);
             LogPrint(BCLog::RPC, "RPC Method time %s (%s) - %ldms\n", jreq.strMethod, jreq.peerAddr.substr(0, jreq.peerAddr.find(':')), diff.count());
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (stream.Flushed()) {
+                req->WriteReplyEnd();
+                return true;
+            }
 
             // array of requests
         } else {
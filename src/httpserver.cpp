@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <deque>
+#include <map>
+#include <set>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -45,6 +47,52 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Deficit of work queue client used by item of cost class */
+static const int WORK_COSTS[WORK_COST_CLASSES] = {1, 1, 4};
+/** Deficit added to client on every turn */
+static const int WORK_QUANTUM = 4;
+/** Deficit added to fast lane on every turn of lanes, normal lane gets WORK_QUANTUM.
+ * Fast items take at most this share of workers while other items wait. */
+static const int WORK_FAST_QUANTUM = 3 * WORK_QUANTUM;
+
+/** RPC methods answered from memory or with single lookup */
+static const std::set<std::string> WORK_FAST_METHODS = {
+    "converttxidaddress",
+    "getaddressid",
+    "getaddressregistration",
+    "getbestblockhash",
+    "getblockcount",
+    "getnodeinfo",
+    "gettime",
+    "getuseraddress",
+    "getuserstate",
+};
+
+/** RPC methods scanning many items */
+static const std::set<std::string> WORK_HEAVY_METHODS = {
+    "getaddressscores",
+    "getcontents",
+    "getcontentsstatistic",
+    "gethierarchicalstrip",
+    "gethistoricalstrip",
+    "gethotposts",
+    "gethotposts2",
+    "getmissedinfo",
+    "getmissedinfo2",
+    "getrawtransactionwithmessage",
+    "getrawtransactionwithmessage2",
+    "getrecomendedsubscriptionsforuser",
+    "getrecommendedposts",
+    "getrecommendedposts2",
+    "gettags",
+    "getusercontents",
+    "search",
+    "search2",
+    "searchlinks",
+    "searchtags",
+    "txunspent",
+};
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
 {
@@ -65,27 +113,124 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
+/** Work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
+ * Fast items have separate depth and larger share of workers: lanes take
+ * turns by deficit round robin with WORK_FAST_QUANTUM and WORK_QUANTUM.
+ * Inside each lane clients take turns by deficit round robin, so client
+ * with heavy items gets fewer turns and one client can not fill the queue.
  */
 template<typename WorkItem>
 class WorkQueue
 {
 private:
+    struct Entry
+    {
+        std::unique_ptr<WorkItem> item;
+        WorkCost cost;
+        int64_t enqueued;
+    };
+
+    /** Items of one client */
+    struct Flow
+    {
+        std::deque<Entry> entries;
+        int deficit = 0;
+    };
+
+    /** Deficit round robin over clients with queued items */
+    struct Scheduler
+    {
+        std::map<std::string, Flow> flows;
+        // Front - client of current turn
+        std::deque<std::string> turns;
+        size_t size = 0;
+
+        void Push(const std::string &client, Entry &&entry)
+        {
+            Flow &flow = flows[client];
+            if (flow.entries.empty()) turns.push_back(client);
+            flow.entries.push_back(std::move(entry));
+            size += 1;
+        }
+
+        /** Precondition: size > 0 */
+        Entry Pop()
+        {
+            while (true)
+            {
+                auto it = flows.find(turns.front());
+                Flow &flow = it->second;
+                if (flow.deficit >= WORK_COSTS[flow.entries.front().cost])
+                {
+                    Entry entry = std::move(flow.entries.front());
+                    flow.entries.pop_front();
+                    flow.deficit -= WORK_COSTS[entry.cost];
+                    size -= 1;
+
+                    // Idle client does not keep deficit
+                    if (flow.entries.empty())
+                    {
+                        flows.erase(it);
+                        turns.pop_front();
+                    }
+                    return entry;
+                }
+
+                flow.deficit += WORK_QUANTUM;
+                turns.push_back(turns.front());
+                turns.pop_front();
+            }
+        }
+    };
+
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    Scheduler fast;
+    Scheduler other;
+    // Deficits of lanes, charged after item is taken
+    int fastDeficit = 0;
+    int otherDeficit = 0;
     bool running;
     size_t maxDepth;
+    size_t maxClientDepth;
+
+    /** Precondition: fast.size > 0 || other.size > 0 */
+    Entry Pop()
+    {
+        // Idle lane does not keep deficit
+        if (fast.size == 0 || other.size == 0)
+        {
+            fastDeficit = 0;
+            otherDeficit = 0;
+            return fast.size > 0 ? fast.Pop() : other.Pop();
+        }
 
-    // int maxsize = 0;
-    // int period = 100;
+        while (fastDeficit <= 0 && otherDeficit <= 0)
+        {
+            fastDeficit += WORK_FAST_QUANTUM;
+            otherDeficit += WORK_QUANTUM;
+        }
 
+        if (fastDeficit > 0)
+        {
+            Entry entry = fast.Pop();
+            fastDeficit -= WORK_COSTS[entry.cost];
+            return entry;
+        }
+
+        Entry entry = other.Pop();
+        otherDeficit -= WORK_COSTS[entry.cost];
+        return entry;
+    }
+
+    WorkQueueStat stats[WORK_COST_CLASSES];
 
 public:
-    explicit WorkQueue(size_t _maxDepth) : running(true),
-                                           maxDepth(_maxDepth)
+    WorkQueue(size_t _maxDepth, int clientPercent) : running(true),
+                                                     maxDepth(_maxDepth),
+                                                     maxClientDepth(std::max<size_t>(_maxDepth * std::max(clientPercent, 0) / 100, 1))
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -93,28 +238,20 @@ public:
     ~WorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem *item)
+    /** Enqueue a work item, limitClient - client can hold only part of queue */
+    bool Enqueue(WorkItem *item, const std::string &client, WorkCost cost, bool limitClient)
     {
         LOCK(cs);
 
-
-        //--------------------------
-        // period -= 1;
-        // if (queue.size() > maxsize) maxsize = queue.size();
-        // if (period <= 0) {
-        //     LogPrintf("--- max queue.size() from last 100 requests: %d\n", maxsize);
-        //     period = 100;
-        //     maxsize = 0;
-        // }
-        //--------------------------
-
-        if (queue.size() >= maxDepth)
+        Scheduler &scheduler = cost == WORK_FAST ? fast : other;
+        auto it = scheduler.flows.find(client);
+        if (scheduler.size >= maxDepth || (limitClient && it != scheduler.flows.end() && it->second.entries.size() >= maxClientDepth))
         {
+            stats[cost].rejected += 1;
             return false;
         }
 
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        scheduler.Push(client, Entry{std::unique_ptr<WorkItem>(item), cost, GetTimeMicros()});
         cond.notify_one();
 
         return true;
@@ -124,17 +261,22 @@ public:
     {
         while (true)
         {
-            std::unique_ptr<WorkItem> i;
+            Entry entry;
             {
                 WAIT_LOCK(cs, lock);
-                while (running && queue.empty())
+                while (running && fast.size == 0 && other.size == 0)
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                entry = Pop();
+
+                int64_t wait = GetTimeMicros() - entry.enqueued;
+                WorkQueueStat &stat = stats[entry.cost];
+                stat.count += 1;
+                stat.waitTotal += wait;
+                stat.waitMax = std::max(stat.waitMax, wait);
             }
-            (*i)();
+            (*entry.item)();
         }
     }
     /** Interrupt and exit loops */
@@ -144,6 +286,18 @@ public:
         running = false;
         cond.notify_all();
     }
+    /** Statistic of cost class and count of queued items */
+    WorkQueueStat GetStat(WorkCost cost)
+    {
+        LOCK(cs);
+        WorkQueueStat stat = stats[cost];
+        stat.queued = 0;
+        const Scheduler &scheduler = cost == WORK_FAST ? fast : other;
+        for (const auto &flow : scheduler.flows)
+            for (const auto &entry : flow.second.entries)
+                if (entry.cost == cost) stat.queued += 1;
+        return stat;
+    }
 };
 
 struct HTTPPathHandler
@@ -239,6 +393,90 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
 }
 
 static std::string sendrawtransaction("sendrawtransaction");
+
+/** Value of "method" key of top level JSON object, found without building the value.
+ * ambiguous - top level key or method has escapes and can be read differently by parser */
+static std::string GetTopLevelMethod(const char *data, size_t size, bool &ambiguous)
+{
+    ambiguous = false;
+    int depth = 0;
+    bool expectKey = false;
+    std::string key;
+    for (size_t i = 0; i < size; i++)
+    {
+        char c = data[i];
+        if (c == '"')
+        {
+            size_t start = ++i;
+            bool escaped = false;
+            while (i < size && data[i] != '"')
+            {
+                if (data[i] == '\\')
+                {
+                    escaped = true;
+                    i++;
+                }
+                i++;
+            }
+            if (i >= size) return "";
+            if (depth != 1) continue;
+
+            if (expectKey)
+            {
+                key.assign(data + start, i - start);
+                expectKey = false;
+                if (escaped) ambiguous = true;
+            }
+            else if (key == "method")
+            {
+                if (escaped) ambiguous = true;
+                return std::string(data + start, i - start);
+            }
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+            if (depth == 1) expectKey = (c == '{');
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (--depth <= 0) return "";
+        }
+        else if (c == ',' && depth == 1)
+        {
+            expectKey = true;
+        }
+    }
+
+    return "";
+}
+
+/** Cost class by JSON-RPC method of request body */
+static WorkCost GetWorkCost(struct evhttp_request *req)
+{
+    struct evbuffer *buf = evhttp_request_get_input_buffer(req);
+    if (!buf) return WORK_NORMAL;
+
+    size_t size = evbuffer_get_length(buf);
+    if (size == 0) return WORK_NORMAL;
+
+    // Body is read whole by worker anyway
+    const char *data = (const char *) evbuffer_pullup(buf, -1);
+    if (!data) return WORK_NORMAL;
+
+    // Batch of requests
+    size_t first = 0;
+    while (first < size && isspace((unsigned char) data[first])) first++;
+    if (first < size && data[first] == '[') return WORK_HEAVY;
+
+    bool ambiguous = false;
+    std::string method = GetTopLevelMethod(data, size, ambiguous);
+    if (ambiguous) return WORK_HEAVY;
+    if (WORK_FAST_METHODS.count(method)) return WORK_FAST;
+    if (WORK_HEAVY_METHODS.count(method)) return WORK_HEAVY;
+    return WORK_NORMAL;
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request *req, void *arg)
 {
@@ -300,7 +538,9 @@ static void http_request_cb(struct evhttp_request *req, void *arg)
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
 
         assert(httpSock->m_workQueue);
-        if (httpSock->m_workQueue->Enqueue(item.get()))
+        // Clients from allow list (local reverse proxy) share one address - not limited
+        bool limitClient = !ClientAllowed(item->req->GetPeer());
+        if (httpSock->m_workQueue->Enqueue(item.get(), item->req->GetPeer().ToStringIP(), GetWorkCost(req), limitClient))
             item.release();
         else
         {
@@ -565,7 +805,7 @@ HTTPSocket::HTTPSocket(struct event_base *base, int timeout, int queueDepth, boo
     evhttp_set_max_body_size(http, MAX_SIZE);
     evhttp_set_gencb(http, http_request_cb, (void*) this);
 
-    m_workQueue = new WorkQueue<HTTPClosure>(queueDepth);
+    m_workQueue = new WorkQueue<HTTPClosure>(queueDepth, gArgs.GetArg("-rpcworkclientqueue", DEFAULT_HTTP_CLIENT_WORKQUEUE));
     LogPrintf("HTTP: creating work queue of depth %d\n", queueDepth);
 
     // transfer ownership to eventBase/HTTP via .release()
@@ -658,6 +898,29 @@ void HTTPSocket::UnregisterHTTPHandler(const std::string &prefix, bool exactMatc
     }
 }
 
+UniValue HTTPSocket::GetQueueStat()
+{
+    static const char* names[WORK_COST_CLASSES] = {"fast", "normal", "heavy"};
+
+    UniValue result(UniValue::VOBJ);
+    if (!m_workQueue) return result;
+
+    for (int cost = 0; cost < WORK_COST_CLASSES; cost++)
+    {
+        WorkQueueStat stat = m_workQueue->GetStat((WorkCost) cost);
+
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("count", stat.count);
+        entry.pushKV("rejected", stat.rejected);
+        entry.pushKV("queued", stat.queued);
+        entry.pushKV("AvgWait", stat.count > 0 ? stat.waitTotal / (int64_t) stat.count / 1000.0 : 0.0);
+        entry.pushKV("MaxWait", stat.waitMax / 1000.0);
+        result.pushKV(names[cost], entry);
+    }
+
+    return result;
+}
+
 HTTPEvent::HTTPEvent(struct event_base *base, bool _deleteWhenTriggered, const std::function<void()> &_handler) :
     deleteWhenTriggered(_deleteWhenTriggered), handler(_handler)
 {
@@ -681,7 +944,13 @@ HTTPRequest::HTTPRequest(struct evhttp_request *_req) : req(_req),
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent)
+    if (!replySent && replyStream)
+    {
+        // Chunked reply interrupted - close it as is
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        WriteReplyEnd();
+    }
+    else if (!replySent)
     {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -733,9 +1002,27 @@ void HTTPRequest::WriteHeader(const std::string &hdr, const std::string &value)
  * Replies must be sent in the main loop in the main http thread,
  * this cannot be done from worker threads.
  */
+// Re-enable reading from the socket. This is the second part of the libevent
+// workaround in http_request_cb.
+static void http_reply_sent(struct evhttp_request *req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001)
+    {
+        evhttp_connection *conn = evhttp_request_get_connection(req);
+        if (conn)
+        {
+            bufferevent *bev = evhttp_connection_get_bufferevent(conn);
+            if (bev)
+            {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 void HTTPRequest::WriteReply(int nStatus, const std::string &strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyStream && req);
 
     // Send event to main http thread to send reply message
     struct evbuffer *evb = evhttp_request_get_output_buffer(req);
@@ -745,20 +1032,128 @@ void HTTPRequest::WriteReply(int nStatus, const std::string &strReply)
     HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]
     {
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001)
+        http_reply_sent(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+/** Chunked reply flow control.
+ * Worker counts queued bytes, main http thread counts bytes passed to connection
+ * and confirms them when connection output is flushed.
+ */
+struct HTTPReplyStream
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t queued = 0;
+    size_t passed = 0;
+    size_t sent = 0;
+    bool closed = false;
+};
+
+static void http_stream_sent_cb(struct evhttp_connection *conn, void *arg)
+{
+    HTTPReplyStream *stream = (HTTPReplyStream*) arg;
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->sent = stream->passed;
+    stream->cond.notify_all();
+}
+
+static void http_stream_close_cb(struct evhttp_connection *conn, void *arg)
+{
+    HTTPReplyStream *stream = (HTTPReplyStream*) arg;
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->closed = true;
+    stream->cond.notify_all();
+}
+
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !replyStream && req);
+
+    replyStream = std::make_shared<HTTPReplyStream>();
+    auto req_copy = req;
+    auto stream = replyStream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, stream, nStatus]
+    {
+        evhttp_connection *conn = evhttp_request_get_connection(req_copy);
+        if (!conn)
         {
+            http_stream_close_cb(nullptr, stream.get());
+            return;
+        }
+
+        // Connection closed before end - request kept by libevent for WriteReplyEnd
+        evhttp_connection_set_closecb(conn, http_stream_close_cb, stream.get());
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string &chunk)
+{
+    assert(!replySent && replyStream && req);
+
+    {
+        std::unique_lock<std::mutex> lock(replyStream->cs);
+        replyStream->cond.wait(lock, [this] {
+            return replyStream->closed || replyStream->queued - replyStream->sent <= HTTP_STREAM_MAX_PENDING;
+        });
+        if (replyStream->closed) return false;
+        replyStream->queued += chunk.size();
+    }
+
+    struct evbuffer *evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, chunk.data(), chunk.size());
+
+    auto req_copy = req;
+    auto stream = replyStream;
+    size_t size = chunk.size();
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, stream, evb, size]
+    {
+        bool closed;
+        {
+            std::lock_guard<std::mutex> lock(stream->cs);
+            closed = stream->closed;
+            stream->passed += size;
+        }
+
+        if (!closed)
+            evhttp_send_reply_chunk_with_cb(req_copy, evb, http_stream_sent_cb, stream.get());
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(!replySent && replyStream && req);
+
+    auto req_copy = req;
+    auto stream = replyStream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, stream]
+    {
+        bool closed;
+        {
+            std::lock_guard<std::mutex> lock(stream->cs);
+            closed = stream->closed;
+        }
+
+        if (!closed)
+        {
+            // Stream state is released with this event
             evhttp_connection *conn = evhttp_request_get_connection(req_copy);
-            if (conn)
-            {
-                bufferevent *bev = evhttp_connection_get_bufferevent(conn);
-                if (bev)
-                {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+            if (conn) evhttp_connection_set_closecb(conn, nullptr, nullptr);
+            // Request can be freed by reply end
+            http_reply_sent(req_copy);
         }
+
+        // Frees request itself if connection is already closed
+        evhttp_send_reply_end(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <functional>
 #include <future>
+#include <memory>
 #include <rpc/protocol.h> // For HTTP status codes
 #include <event2/thread.h>
 #include <event2/buffer.h>
@@ -24,7 +25,29 @@ static const int DEFAULT_HTTP_PUBLIC_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_POST_WORKQUEUE=16;
 static const int DEFAULT_HTTP_PUBLIC_WORKQUEUE=16;
+/** Percent of work queue depth one client address can take */
+static const int DEFAULT_HTTP_CLIENT_WORKQUEUE=50;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Maximum bytes of chunked reply queued and not yet sent to client */
+static const size_t HTTP_STREAM_MAX_PENDING=4 * 1024 * 1024;
+
+/** Cost classes of HTTP work items */
+enum WorkCost {
+    WORK_FAST = 0,
+    WORK_NORMAL = 1,
+    WORK_HEAVY = 2,
+    WORK_COST_CLASSES = 3
+};
+
+/** Work items of cost class served from start */
+struct WorkQueueStat {
+    uint64_t count = 0;
+    uint64_t rejected = 0;
+    uint64_t queued = 0;
+    // Microseconds in queue
+    int64_t waitTotal = 0;
+    int64_t waitMax = 0;
+};
 
 struct evhttp_request;
 class CService;
@@ -32,6 +55,7 @@ class HTTPRequest;
 template<typename WorkItem> class WorkQueue;
 
 struct HTTPPathHandler;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -67,6 +91,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    // State of chunked reply shared with main http thread
+    std::shared_ptr<HTTPReplyStream> replyStream;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -122,6 +148,28 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start chunked HTTP reply. Body is sent with WriteReplyChunk and
+     * completed with WriteReplyEnd.
+     *
+     * @note Call WriteHeader before. Can not be mixed with WriteReply.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send part of chunked reply body.
+     * Waits while more than HTTP_STREAM_MAX_PENDING bytes are not sent to client.
+     * Returns false if connection is closed - rest of reply can be dropped.
+     */
+    bool WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Complete chunked reply.
+     *
+     * @note Same as WriteReply gives the request back to the main thread.
+     */
+    void WriteReplyEnd();
 };
 
 /** Event handler closure.
@@ -192,6 +240,8 @@ public:
     void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
     /** Unregister handler for prefix */
     void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
+    /** Queue wait times by cost class */
+    UniValue GetQueueStat();
 };
 
 std::string urlDecode(const std::string &urlEncoded);
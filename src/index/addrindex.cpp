@@ -74,49 +74,38 @@ bool AddrIndex::insert_to_mempool(reindexer::Item& item, std::string table)
     return WriteMemRTransaction(memItm);
 }
 
-bool AddrIndex::indexUTXO(const CTransactionRef& tx, CBlockIndex* pindex)
+bool AddrIndex::indexUTXO(const CBlock& block, CBlockIndex* pindex)
 {
-    std::string txid = tx->GetHash().GetHex();
+    UTXOBatch batch(pindex->nHeight);
 
-    // Get all addresses from tx outs
-    for (int i = 0; i < tx->vout.size(); i++) {
-        const CTxOut& txout = tx->vout[i];
-        //-------------------------
-        CTxDestination destAddress;
-        if (!ExtractDestination(txout.scriptPubKey, destAddress)) continue;
-        std::string encoded_address = EncodeDestination(destAddress);
+    for (const auto& tx : block.vtx) {
+        std::string txid = tx->GetHash().GetHex();
 
-        // Add Unspent transaction for this addresses
-        reindexer::Item item = g_pocketdb->DB()->NewItem("UTXO");
-        item["address"] = encoded_address;
-        item["txid"] = txid;
-        item["block"] = pindex->nHeight;
-        item["txout"] = i;
-        item["time"] = (int64_t)tx->nTime;
-        item["amount"] = (int64_t)txout.nValue;
-        item["spent_block"] = 0;
-
-        if (!g_pocketdb->UpsertWithCommit("UTXO", item).ok()) return false;
-    }
-
-    // Get all addresses from tx ins
-    if (!tx->IsCoinBase()) {
-        for (int i = 0; i < tx->vin.size(); i++) {
-            const CTxIn& txin = tx->vin[i];
-            std::string txinid = txin.prevout.hash.GetHex();
-            int txinout = (int)txin.prevout.n;
-
-            // Mark UTXO item as deleted
-            reindexer::QueryResults _res;
-            reindexer::Error err = g_pocketdb->DB()->Select(reindexer::Query("UTXO", 0, 1).WhereComposite("txid+txout", CondEq, {{ Variant(txinid), Variant(txinout) }}), _res);
-            if (err.ok() && _res.Count() > 0) {
-                reindexer::Item item = _res[0].GetItem();
-                item["spent_block"] = pindex->nHeight;
-                if (!g_pocketdb->UpsertWithCommit("UTXO", item).ok()) return false;
+        // Get all addresses from tx outs
+        for (int i = 0; i < tx->vout.size(); i++) {
+            const CTxOut& txout = tx->vout[i];
+            //-------------------------
+            CTxDestination destAddress;
+            if (!ExtractDestination(txout.scriptPubKey, destAddress)) continue;
+
+            // Add Unspent transaction for this addresses
+            batch.outs.push_back({EncodeDestination(destAddress), txid, i, (int64_t)tx->nTime, (int64_t)txout.nValue});
+        }
+
+        // Get all addresses from tx ins
+        if (!tx->IsCoinBase()) {
+            for (const auto& txin : tx->vin) {
+                batch.spents.emplace_back(txin.prevout.hash.GetHex(), (int)txin.prevout.n);
             }
         }
     }
 
+    Error err = g_pocketdb->WriteUTXOBatch(batch);
+    if (!err.ok()) {
+        LogPrintf("(AddrIndex::indexUTXO) WriteUTXOBatch - %s\n", err.what());
+        return false;
+    }
+
     return true;
 }
 
@@ -439,13 +428,13 @@ bool AddrIndex::IndexBlock(const CBlock& block, CBlockIndex* pindex)
     // <commentid, rep>
     std::map<std::string, int> commentReputations;
 
-    for (const auto& tx : block.vtx) {
-        // Indexing UTXOs
-        if (!indexUTXO(tx, pindex)) {
-            LogPrintf("(AddrIndex::IndexBlock) indexUTXO - tx (%s)\n", tx->GetHash().GetHex());
-            return false;
-        }
+    // Indexing UTXOs
+    if (!indexUTXO(block, pindex)) {
+        LogPrintf("(AddrIndex::IndexBlock) indexUTXO - block (%s)\n", block.GetHash().GetHex());
+        return false;
+    }
 
+    for (const auto& tx : block.vtx) {
         // Indexing addresses
         if (!indexAddress(tx, pindex)) {
             LogPrintf("(AddrIndex::IndexBlock) indexAddress - tx (%s)\n", tx->GetHash().GetHex());
@@ -566,6 +555,9 @@ bool AddrIndex::WriteRTransaction(const CTransactionRef& tx, std::string table,
         item["message_"] = ClearHtmlTags(message_decoded);
 
         if (!g_pocketdb->CommitPostItem(item, height).ok()) return false;
+
+        std::string _txid_repost = item["txidRepost"].As<string>();
+        if (_txid_repost != "" && !g_pocketdb->UpdatePostCounters(_txid_repost).ok()) return false;
     }
 
     // Score for post
@@ -593,6 +585,10 @@ bool AddrIndex::WriteRTransaction(const CTransactionRef& tx, std::string table,
     // New Comment
     if (table == "Comment") {
         if (!g_pocketdb->CommitLastItem("Comment", item, height).ok()) return false;
+        if (!g_pocketdb->UpdatePostCounters(item["postid"].As<string>()).ok()) return false;
+
+        std::string _parentid = item["parentid"].As<string>();
+        if (_parentid != "" && !g_pocketdb->UpdateCommentCounters(_parentid).ok()) return false;
     }
 
     // Comment score
@@ -647,6 +643,16 @@ bool AddrIndex::IsPocketnetTransaction(const CTransaction& tx)
 
 bool AddrIndex::RollbackDB(int blockHeight, bool back_to_mempool)
 {
+    // Rating history below checkpoint not restorable
+    int ratingCheckpoint = g_pocketdb->GetRatingCheckpoint();
+    if (blockHeight < ratingCheckpoint) {
+        LogPrintf("(AddrIndex::RollbackDB) height %d below rating checkpoint %d - reindex required\n", blockHeight, ratingCheckpoint);
+        return false;
+    }
+
+    g_pocketdb->RollbackBlockRHash(blockHeight);
+    g_pocketdb->ResetUserCache();
+
     // Deleting Scores
     {
         if (back_to_mempool) {
@@ -662,6 +668,10 @@ bool AddrIndex::RollbackDB(int blockHeight, bool back_to_mempool)
         if (!g_pocketdb->DeleteWithCommit(reindexer::Query("Scores").Where("block", CondGt, blockHeight)).ok()) return false;
     }
 
+    // Posts and comments with counters changed by rollback
+    std::set<std::string> _counters_posts;
+    std::set<std::string> _counters_comments;
+
     // Rollback Posts
     {
         reindexer::QueryResults _posts_res;
@@ -669,6 +679,8 @@ bool AddrIndex::RollbackDB(int blockHeight, bool back_to_mempool)
         for (auto& it : _posts_res) {
             reindexer::Item _delete_post_itm = it.GetItem();
             std::string _post_txid = _delete_post_itm["txid"].As<string>();
+            std::string _txid_repost = _delete_post_itm["txidRepost"].As<string>();
+            if (_txid_repost != "") _counters_posts.insert(_txid_repost);
 
             if (back_to_mempool && !insert_to_mempool(_delete_post_itm, "Posts")) return false;
             if (!g_pocketdb->RestorePostItem(_post_txid, blockHeight).ok()) return false;
@@ -697,6 +709,9 @@ bool AddrIndex::RollbackDB(int blockHeight, bool back_to_mempool)
 
     // Rollback UTXO
     {
+        // Outputs pruned to archive but spent in disconnected blocks
+        if (!g_pocketdb->RollbackUTXOArchive(blockHeight).ok()) return false;
+
         if (!g_pocketdb->DeleteWithCommit(reindexer::Query("UTXO").Where("block", CondGt, blockHeight)).ok()) return false;
 
         reindexer::QueryResults _utxo_res;
@@ -790,6 +805,21 @@ bool AddrIndex::RollbackDB(int blockHeight, bool back_to_mempool)
 
             if (back_to_mempool && !insert_to_mempool(_delete_comment_itm, "Comment")) return false;
             if (!g_pocketdb->RestoreLastItem("Comment", _comment_txid, _comment_otxid, blockHeight).ok()) return false;
+
+            _counters_posts.insert(_delete_comment_itm["postid"].As<string>());
+            std::string _parentid = _delete_comment_itm["parentid"].As<string>();
+            if (_parentid != "") _counters_comments.insert(_parentid);
+        }
+    }
+
+    // Recount comments, reposts and answers
+    {
+        for (const auto& _txid : _counters_posts) {
+            if (!g_pocketdb->UpdatePostCounters(_txid).ok()) return false;
+        }
+
+        for (const auto& _otxid : _counters_comments) {
+            if (!g_pocketdb->UpdateCommentCounters(_otxid).ok()) return false;
         }
     }
 
@@ -1131,7 +1161,7 @@ bool AddrIndex::GetRecommendedPostsByScores(std::string _address, int count, int
         reindexer::Query("Scores")
             .Where("block", CondLe, nHeightFrom)
             .Where("time", CondLe, GetAdjustedTime())
-            .Where("address", CondEq, _address)
+            .Where("address_id", CondEq, g_pocketdb->GetKeyId(_address))
             .Where("value", CondSet, score_values)
             .Sort("time", true)
             .Limit(50),
@@ -1148,7 +1178,7 @@ bool AddrIndex::GetRecommendedPostsByScores(std::string _address, int count, int
             reindexer::Query("Scores")
                 .Where("block", CondLe, nHeightFrom)
                 .Where("time", CondLe, GetAdjustedTime())
-                .Where("posttxid", CondSet, userLikedPosts)
+                .Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(userLikedPosts))
                 .Where("value", CondSet, score_values)
                 .Limit(sampleSize),
             queryScores2);
@@ -1166,7 +1196,7 @@ bool AddrIndex::GetRecommendedPostsByScores(std::string _address, int count, int
                 reindexer::Query("Scores")
                     .Where("block", CondLe, nHeightFrom)
                     .Where("time", CondLe, GetAdjustedTime())
-                    .Where("address", CondSet, fellowLikers)
+                    .Where("address_id", CondSet, g_pocketdb->GetKeyIds(fellowLikers))
                     .Where("value", CondSet, score_values)
                     .Aggregate("posttxid", AggFacet),
                 "posttxid",
@@ -1198,45 +1228,34 @@ bool AddrIndex::GetRecommendedPostsByScores(std::string _address, int count, int
     return true;
 }
 
-bool AddrIndex::GetBlockRIData(CBlock block, std::string& data)
+bool AddrIndex::GetBlockRIData(CBlock block, PocketBlockData& data)
 {
-    UniValue ret_data(UniValue::VOBJ);
     uint256 blockhash = block.GetHash();
 
     // Maybe reindexer part data received from another node?
     // .. then relay from global POCKETNET_DATA
-    if (POCKETNET_DATA.find(blockhash) != POCKETNET_DATA.end()) {
-        data = POCKETNET_DATA[blockhash];
+    if (POCKETNET_DATA.Get(blockhash, data)) {
         return true;
     }
 
     // .. or data already in reindexer DB
     for (CTransactionRef& tr : block.vtx) {
-        std::string d;
+        PocketTxData d;
         if (IsPocketTX(tr)) {
             if (!GetTXRIData(tr, d)) return false;
-            ret_data.pushKV(tr->GetHash().GetHex(), d);
+            data.emplace(tr->GetHash(), std::move(d));
         }
     }
 
-    if (ret_data.size()) {
-        data = ret_data.write();
-    }
-
     return true;
 }
 
-bool AddrIndex::SetBlockRIData(const CBlock& block, std::string& data, int height)
+bool AddrIndex::SetBlockRIData(const CBlock& block, const PocketBlockData& data, int height)
 {
-    UniValue _data(UniValue::VOBJ);
-    _data.read(data);
-
     for (const auto& tx : block.vtx) {
-        auto key = tx->GetHash().GetHex();
-        if (_data.exists(key))
-        {
-            std::string _d = _data[key].get_str();
-            if (!SetTXRIData(tx, _d, height))
+        auto it = data.find(tx->GetHash());
+        if (it != data.end()) {
+            if (!SetTXRIData(tx, it->second, height))
                 return false;
         }
     }
@@ -1244,7 +1263,7 @@ bool AddrIndex::SetBlockRIData(const CBlock& block, std::string& data, int heigh
     return true;
 }
 
-bool AddrIndex::GetTXRIData(CTransactionRef& tx, std::string& data)
+bool AddrIndex::GetTXRIData(CTransactionRef& tx, PocketTxData& data)
 {
     std::string ri_table = "";
 
@@ -1252,7 +1271,6 @@ bool AddrIndex::GetTXRIData(CTransactionRef& tx, std::string& data)
     if (!GetPocketnetTXType(tx, ri_table)) return true;
     //----------------------
     std::string txid = tx->GetHash().GetHex();
-    UniValue ret_data(UniValue::VOBJ);
 
     // Type of transaction is "pocketnet"
     // First check RIMempool for transactions from mempool
@@ -1317,27 +1335,69 @@ bool AddrIndex::GetTXRIData(CTransactionRef& tx, std::string& data)
         }
     }
 
-    ret_data.pushKV("t", (mempool ? "Mempool" : ri_table));
-    ret_data.pushKV("d", EncodeBase64(itm.GetJSON().ToString()));
-    data = ret_data.write();
+    data.table = (mempool ? "Mempool" : ri_table);
+    data.data = itm.GetJSON().ToString();
     return true;
 }
 
-bool AddrIndex::SetTXRIData(const CTransactionRef& tx, std::string& data, int height)
+bool AddrIndex::SetTXRIData(const CTransactionRef& tx, const PocketTxData& data, int height)
 {
-    UniValue _data(UniValue::VOBJ);
-    if (!_data.read(data)) return false;
-    //----------------------
-    std::string table = _data["t"].get_str();
-    std::string itm_src = DecodeBase64(_data["d"].get_str());
+    if (data.table.empty()) return false;
 
-    reindexer::Item itm = g_pocketdb->DB()->NewItem(table);
-    if (!itm.FromJSON(itm_src).ok()) return false;
-    if (!WriteRTransaction(tx, table, itm, height)) return false;
+    reindexer::Item itm = g_pocketdb->DB()->NewItem(data.table);
+    if (!itm.FromJSON(data.data).ok()) return false;
+    if (!WriteRTransaction(tx, data.table, itm, height)) return false;
     //----------------------
     return true;
 }
 
+std::string AddrIndex::EncodeTXRIData(const PocketTxData& data)
+{
+    UniValue ret_data(UniValue::VOBJ);
+    ret_data.pushKV("t", data.table);
+    ret_data.pushKV("d", EncodeBase64(data.data));
+    return ret_data.write();
+}
+
+bool AddrIndex::DecodeTXRIData(const std::string& src, PocketTxData& data)
+{
+    UniValue _data(UniValue::VOBJ);
+    if (!_data.read(src) || !_data.isObject()) return false;
+    if (!_data["t"].isStr() || !_data["d"].isStr()) return false;
+
+    data.table = _data["t"].get_str();
+    data.data = DecodeBase64(_data["d"].get_str());
+    return true;
+}
+
+std::string AddrIndex::EncodeBlockRIData(const PocketBlockData& data)
+{
+    if (data.empty()) return "";
+
+    UniValue ret_data(UniValue::VOBJ);
+    for (const auto& it : data) {
+        ret_data.pushKV(it.first.GetHex(), EncodeTXRIData(it.second));
+    }
+
+    return ret_data.write();
+}
+
+bool AddrIndex::DecodeBlockRIData(const std::string& src, PocketBlockData& data)
+{
+    UniValue _data(UniValue::VOBJ);
+    if (!_data.read(src) || !_data.isObject()) return false;
+
+    for (const auto& key : _data.getKeys()) {
+        if (!_data[key].isStr()) return false;
+
+        PocketTxData d;
+        if (!DecodeTXRIData(_data[key].get_str(), d)) return false;
+        data.emplace(uint256S(key), std::move(d));
+    }
+
+    return true;
+}
+
 bool AddrIndex::CommitRIMempool(const CBlock& block, int height)
 {
     reindexer::Error err;
@@ -1401,246 +1461,9 @@ bool GetBlockRHash(const CBlock& block, std::string& blockRHash)
 
 bool AddrIndex::ComputeRHash(CBlockIndex* pindexPrev, std::string& hash)
 {
+    // Hash of reindexer tables computed while block written
     std::string data = "";
-
-    // Compute hashes for reindexer tables
-    {
-        // Get hash of Users
-        {
-            std::string usersData = "";
-            reindexer::QueryResults usersRes;
-            g_pocketdb->Select(reindexer::Query("Users").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), usersRes);
-            for (auto& u : usersRes) {
-                std::string _usersData = "";
-                reindexer::Item userItm(u.GetItem());
-
-                _usersData += userItm["txid"].As<string>();
-                _usersData += userItm["block"].As<string>();
-                _usersData += userItm["time"].As<string>();
-                _usersData += userItm["address"].As<string>();
-                _usersData += userItm["name"].As<string>();
-                _usersData += userItm["birthday"].As<string>();
-                _usersData += userItm["gender"].As<string>();
-                _usersData += userItm["regdate"].As<string>();
-                _usersData += userItm["avatar"].As<string>();
-                _usersData += userItm["about"].As<string>();
-                _usersData += userItm["lang"].As<string>();
-                _usersData += userItm["url"].As<string>();
-                _usersData += userItm["pubkey"].As<string>();
-                _usersData += userItm["donations"].As<string>();
-                _usersData += userItm["referrer"].As<string>();
-                _usersData += userItm["id"].As<string>();
-
-                usersData += ComputeHash(_usersData);
-            }
-
-            if (usersData != "") data += ComputeHash(usersData);
-        }
-
-        // Get hash of Posts
-        {
-            std::string postsData = "";
-            reindexer::QueryResults postsRes;
-            g_pocketdb->Select(reindexer::Query("Posts").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), postsRes);
-            for (auto& postIt : postsRes) {
-                std::string _postsData = "";
-                reindexer::Item postItm(postIt.GetItem());
-
-                _postsData += postItm["txid"].As<string>();
-                _postsData += postItm["block"].As<string>();
-                _postsData += postItm["time"].As<string>();
-                _postsData += postItm["address"].As<string>();
-                _postsData += postItm["lang"].As<string>();
-                _postsData += postItm["caption"].As<string>();
-                _postsData += postItm["message"].As<string>();
-                _postsData += postItm["settings"].As<string>();
-                _postsData += postItm["url"].As<string>();
-
-                reindexer::VariantArray postTags = postItm["tags"];
-                for (unsigned int i = 0; i < postTags.size(); i++) { _postsData += postTags[i].As<string>(); }
-
-                reindexer::VariantArray postImages = postItm["images"];
-                for (unsigned int i = 0; i < postImages.size(); i++) { _postsData += postImages[i].As<string>(); }
-
-                postsData += ComputeHash(_postsData);
-            }
-
-            if (postsData != "") data += ComputeHash(postsData);
-        }
-
-        // Get hash of Scores
-        {
-            std::string scoresData = "";
-            reindexer::QueryResults scoresRes;
-            g_pocketdb->Select(reindexer::Query("Scores").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), scoresRes);
-            for (auto& scoreIt : scoresRes) {
-                std::string _scoresData = "";
-                reindexer::Item scoreItm(scoreIt.GetItem());
-
-                _scoresData += scoreItm["txid"].As<string>();
-                _scoresData += scoreItm["block"].As<string>();
-                _scoresData += scoreItm["time"].As<string>();
-                _scoresData += scoreItm["posttxid"].As<string>();
-                _scoresData += scoreItm["address"].As<string>();
-                _scoresData += scoreItm["value"].As<string>();
-
-                scoresData += ComputeHash(_scoresData);
-            }
-
-            if (scoresData != "") data += ComputeHash(scoresData);
-        }
-
-        // Get hash of Subscribes
-        {
-            std::string subscribesData = "";
-            reindexer::QueryResults subscribesRes;
-            g_pocketdb->Select(reindexer::Query("Subscribes").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), subscribesRes);
-            for (auto& subscribeIt : subscribesRes) {
-                std::string _subscribesData = "";
-                reindexer::Item subscribeItm(subscribeIt.GetItem());
-
-                _subscribesData += subscribeItm["txid"].As<string>();
-                _subscribesData += subscribeItm["block"].As<string>();
-                _subscribesData += subscribeItm["time"].As<string>();
-                _subscribesData += subscribeItm["address"].As<string>();
-                _subscribesData += subscribeItm["address_to"].As<string>();
-                _subscribesData += subscribeItm["private"].As<string>();
-                _subscribesData += subscribeItm["unsubscribe"].As<string>();
-
-                subscribesData += ComputeHash(_subscribesData);
-            }
-
-            if (subscribesData != "") data += ComputeHash(subscribesData);
-        }
-
-        // Get hash of Blocking
-        {
-            std::string blockingsData = "";
-            reindexer::QueryResults blockingsRes;
-            g_pocketdb->Select(reindexer::Query("Blocking").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), blockingsRes);
-            for (auto& blockingIt : blockingsRes) {
-                std::string _blockingData = "";
-                reindexer::Item blockingItm(blockingIt.GetItem());
-
-                _blockingData += blockingItm["txid"].As<string>();
-                _blockingData += blockingItm["block"].As<string>();
-                _blockingData += blockingItm["time"].As<string>();
-                _blockingData += blockingItm["address"].As<string>();
-                _blockingData += blockingItm["address_to"].As<string>();
-                _blockingData += blockingItm["unblocking"].As<string>();
-
-                blockingsData += ComputeHash(_blockingData);
-            }
-
-            if (blockingsData != "") data += ComputeHash(blockingsData);
-        }
-
-        // Get hash of Complains
-        {
-            std::string complainsData = "";
-            reindexer::QueryResults complainsRes;
-            g_pocketdb->Select(reindexer::Query("Complains").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), complainsRes);
-            for (auto& complainIt : complainsRes) {
-                std::string _complainsData = "";
-                reindexer::Item complainItm(complainIt.GetItem());
-
-                _complainsData += complainItm["txid"].As<string>();
-                _complainsData += complainItm["block"].As<string>();
-                _complainsData += complainItm["time"].As<string>();
-                _complainsData += complainItm["posttxid"].As<string>();
-                _complainsData += complainItm["address"].As<string>();
-                _complainsData += complainItm["reason"].As<string>();
-
-                complainsData += ComputeHash(_complainsData);
-            }
-
-            if (complainsData != "") data += ComputeHash(complainsData);
-        }
-
-        // Get hash of UTXO
-        {
-            std::string utxosData = "";
-            reindexer::QueryResults utxosRes;
-            g_pocketdb->Select(reindexer::Query("UTXO").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), utxosRes);
-            for (auto& utxoIt : utxosRes) {
-                std::string _utxosData = "";
-                reindexer::Item utxoItm(utxoIt.GetItem());
-
-                _utxosData += utxoItm["txid"].As<string>();
-                _utxosData += utxoItm["txout"].As<string>();
-                _utxosData += utxoItm["time"].As<string>();
-                _utxosData += utxoItm["block"].As<string>();
-                _utxosData += utxoItm["address"].As<string>();
-                _utxosData += utxoItm["amount"].As<string>();
-                _utxosData += utxoItm["spent_block"].As<string>();
-
-                utxosData += ComputeHash(_utxosData);
-            }
-
-            if (utxosData != "") data += ComputeHash(utxosData);
-        }
-
-        // Get hash of Addresses
-        {
-            std::string addressesData = "";
-            reindexer::QueryResults addressesRes;
-            g_pocketdb->Select(reindexer::Query("Addresses").Where("block", CondEq, pindexPrev->nHeight).Sort("txid", false), addressesRes);
-            for (auto& addressIt : addressesRes) {
-                std::string _addressesData = "";
-                reindexer::Item addressItm(addressIt.GetItem());
-
-                _addressesData += addressItm["txid"].As<string>();
-                _addressesData += addressItm["block"].As<string>();
-                _addressesData += addressItm["address"].As<string>();
-                _addressesData += addressItm["time"].As<string>();
-
-                addressesData += ComputeHash(_addressesData);
-            }
-
-            if (addressesData != "") data += ComputeHash(addressesData);
-        }
-
-        // Get hash of UserRatings
-        {
-            std::string userRatingsData = "";
-            reindexer::QueryResults userRatingsRes;
-            g_pocketdb->Select(reindexer::Query("UserRatings").Where("block", CondEq, pindexPrev->nHeight).Sort("address", false), userRatingsRes);
-            for (auto& userRatingIt : userRatingsRes) {
-                std::string _userRatingsData = "";
-                reindexer::Item userRatingItm(userRatingIt.GetItem());
-
-                _userRatingsData += userRatingItm["block"].As<string>();
-                _userRatingsData += userRatingItm["address"].As<string>();
-                _userRatingsData += userRatingItm["scoreSum"].As<string>();
-                _userRatingsData += userRatingItm["scoreCnt"].As<string>();
-
-                userRatingsData += ComputeHash(_userRatingsData);
-            }
-
-            if (userRatingsData != "") data += ComputeHash(userRatingsData);
-        }
-
-        // Get hash of PostRatings
-        {
-            std::string postRatingsData = "";
-            reindexer::QueryResults postRatingsRes;
-            g_pocketdb->Select(reindexer::Query("PostRatings").Where("block", CondEq, pindexPrev->nHeight).Sort("posttxid", false), postRatingsRes);
-            for (auto& postRatingIt : postRatingsRes) {
-                std::string _postRatingsData = "";
-                reindexer::Item postRatingItm(postRatingIt.GetItem());
-
-                _postRatingsData += postRatingItm["block"].As<string>();
-                _postRatingsData += postRatingItm["posttxid"].As<string>();
-                _postRatingsData += postRatingItm["scoreSum"].As<string>();
-                _postRatingsData += postRatingItm["scoreCnt"].As<string>();
-                _postRatingsData += postRatingItm["reputation"].As<string>();
-
-                postRatingsData += ComputeHash(_postRatingsData);
-            }
-
-            if (postRatingsData != "") data += ComputeHash(postRatingsData);
-        }
-    }
+    if (!g_pocketdb->GetBlockRHash(pindexPrev->nHeight, data)) return false;
 
     // Get previous block data hash
     {
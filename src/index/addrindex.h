@@ -12,6 +12,7 @@
 #include "pocketdb/pocketnet.h"
 #include "primitives/block.h"
 #include "script/standard.h"
+#include "version.h"
 #include <boost/algorithm/string.hpp>
 #include <coins.h>
 #include <consensus/merkle.h>
@@ -71,8 +72,9 @@ private:
 		Indexing block transactions.
 		OUTs to Unspent
 		INs to Spent
+		All changes of block written with one batch
 	*/
-    bool indexUTXO(const CTransactionRef& tx, CBlockIndex* pindex);
+    bool indexUTXO(const CBlock& block, CBlockIndex* pindex);
     /*
 		Indexing block transactions for collect rating of User.
 		OP_RETURN can contains `OR_SCORE` value - its Score for Post
@@ -192,11 +194,11 @@ public:
     /*
 		Get RI data for block transactions for send to another node.
 	*/
-    bool GetBlockRIData(CBlock block, std::string& data);
+    bool GetBlockRIData(CBlock block, PocketBlockData& data);
     /*
 		Write transaction for block received from another node
 	*/
-    bool SetBlockRIData(const CBlock& block, std::string& data, int height);
+    bool SetBlockRIData(const CBlock& block, const PocketBlockData& data, int height);
     /*
 		Get RI data for transaction for send to another node.
 		Check transaction is PocketNet type transaction
@@ -204,11 +206,21 @@ public:
 		* First check RIMempool
 		* Second check general tables
 	*/
-    bool GetTXRIData(CTransactionRef& tx, std::string& data);
+    bool GetTXRIData(CTransactionRef& tx, PocketTxData& data);
     /*
 		Write PocketNet data for this transaction
 	*/
-    bool SetTXRIData(const CTransactionRef& tx, std::string& data, int height);
+    bool SetTXRIData(const CTransactionRef& tx, const PocketTxData& data, int height);
+    /*
+		Legacy JSON form of PocketNet data for peers
+		without binary pocket data support:
+		tx - {"t": table, "d": base64(item)}
+		block - {txid: tx, ...}
+	*/
+    static std::string EncodeTXRIData(const PocketTxData& data);
+    static bool DecodeTXRIData(const std::string& src, PocketTxData& data);
+    static std::string EncodeBlockRIData(const PocketBlockData& data);
+    static bool DecodeBlockRIData(const std::string& src, PocketBlockData& data);
     /*
 		Write RI Mempool data to general tables
 	*/
@@ -235,6 +247,71 @@ public:
     UniValue GetUniValue(const CTransactionRef& tx, Item& item, std::string table);
 };
 //-----------------------------------------------------
+/** Pocketnet data appended to block and tx messages.
+ *  Serialized in binary form or as legacy JSON string depending on the peer version.
+ *  Stream version may carry SERIALIZE_TRANSACTION_NO_WITNESS - it is not a part of peer version. */
+template <typename T>
+class PocketDataMsg
+{
+    T& data;
+
+    static bool binary(int version)
+    {
+        return (version & ~SERIALIZE_TRANSACTION_NO_WITNESS) >= POCKET_DATA_BINARY_VERSION;
+    }
+
+    static std::string encodeLegacy(const PocketTxData& src)
+    {
+        return src.table.empty() ? "" : AddrIndex::EncodeTXRIData(src);
+    }
+    static std::string encodeLegacy(const PocketBlockData& src)
+    {
+        return AddrIndex::EncodeBlockRIData(src);
+    }
+    static bool decodeLegacy(const std::string& src, PocketTxData& dst)
+    {
+        return AddrIndex::DecodeTXRIData(src, dst);
+    }
+    static bool decodeLegacy(const std::string& src, PocketBlockData& dst)
+    {
+        return AddrIndex::DecodeBlockRIData(src, dst);
+    }
+
+public:
+    explicit PocketDataMsg(T& dataIn) : data(dataIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (binary(s.GetVersion())) {
+            s << data;
+        } else {
+            s << encodeLegacy(data);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (binary(s.GetVersion())) {
+            s >> data;
+            return;
+        }
+
+        std::string src;
+        s >> src;
+        if (!src.empty() && !decodeLegacy(src, data)) {
+            data = T();
+        }
+    }
+};
+
+template <typename T>
+static PocketDataMsg<T> WrapPocketData(T& data)
+{
+    return PocketDataMsg<T>(data);
+}
+//-----------------------------------------------------
 extern std::unique_ptr<AddrIndex> g_addrindex;
 //-----------------------------------------------------
 #endif // ADDRINDEX_H
\ No newline at end of file
@@ -29,6 +29,9 @@
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <rpc/blockchain.h>
+#include <rpc/cache.h>
+#include <rpc/hotposts.h>
+#include <rpc/ranking.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
 #include <scheduler.h>
@@ -81,6 +84,8 @@ static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 Statistic::RequestStatEngine gStatEngineInstance;
+// RPC caches following tip are registered only when init gets to the end
+static bool fRPCTipInterfacesRegistered = false;
 
 
 #ifdef WIN32
@@ -195,6 +200,11 @@ void Shutdown()
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (fRPCTipInterfacesRegistered) {
+        UnregisterValidationInterface(&g_rpc_cache);
+        UnregisterValidationInterface(&g_post_ranking);
+        UnregisterValidationInterface(&g_hot_posts);
+    }
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
 
@@ -204,6 +214,7 @@ void Shutdown()
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    StopWSNotifications();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
@@ -368,6 +379,7 @@ void SetupServerArgs()
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxpocketdata=<n>", strprintf("Keep PocketNET data received with not connected blocks below <n> megabytes (default: %u)", DEFAULT_MAX_POCKET_DATA_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)", -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
@@ -377,6 +389,7 @@ void SetupServerArgs()
 #else
     hidden_args.emplace_back("-pid");
 #endif
+    gArgs.AddArg("-pocketdataexpiry=<n>", strprintf("Do not keep PocketNET data received with not connected blocks longer than <n> hours (default: %u)", DEFAULT_POCKET_DATA_EXPIRY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
                                          "Warning: Reverting this setting requires re-downloading the entire blockchain. "
                                          "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)",
@@ -390,6 +403,8 @@ void SetupServerArgs()
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxoprune=<n>", strprintf("Move outputs spent more than <n> blocks ago from UTXO table to archive, 0 to disable (minimum: %d, default: %d)", MIN_UTXO_PRUNE, DEFAULT_UTXO_PRUNE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-ratingcheckpoint=<n>", strprintf("Compact rating history older than <n> blocks, rollback below it requires -reindex, 0 to disable (minimum: %d, default: %d)", MIN_RATING_CHECKPOINT, DEFAULT_RATING_CHECKPOINT), false, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-banscore=<n>", strprintf("Threshold for disconnecting misbehaving peers (default: %u)", DEFAULT_BANSCORE_THRESHOLD), false, OptionsCategory::CONNECTION);
@@ -513,6 +528,7 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)", false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpccachesize=<n>", strprintf("Keep results of public RPC methods for current chain tip below <n> megabytes, 0 to disable (default: %u)", DEFAULT_RPC_CACHE_SIZE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for secure JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), false, OptionsCategory::RPC);
@@ -526,6 +542,7 @@ void SetupServerArgs()
 
     gArgs.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", false, OptionsCategory::RPC);
 
+    gArgs.AddArg("-rpcworkclientqueue=<n>", strprintf("Set the percent of the work queue depth one client address can take, clients from -rpcallowip are not limited (default: %d)", DEFAULT_HTTP_CLIENT_WORKQUEUE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcworkpostqueue=<n>", strprintf("Set the depth of the work queue to service RPC (POST) calls (default: %d)", DEFAULT_HTTP_POST_WORKQUEUE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcworkpublicqueue=<n>", strprintf("Set the depth of the work queue to service RPC (PUBLIC) calls (default: %d)", DEFAULT_HTTP_PUBLIC_WORKQUEUE), false, OptionsCategory::RPC);
@@ -668,7 +685,9 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
             g_pocketdb->DropTable("PostRatings");
             g_pocketdb->DropTable("Ratings");
             g_pocketdb->DropTable("CommentRatings");
+            g_pocketdb->DropTable("RatingCheckpoints");
             g_pocketdb->DropTable("UTXO");
+            g_pocketdb->DropTable("UTXOArchive");
             LogPrintf("Rating tables cleared\n");
 
             int nFile = 0;
@@ -1065,6 +1084,22 @@ bool AppInitParameterInteraction()
     int64_t nMempoolSizeMin = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
     if (nMempoolSizeMax < 0 || nMempoolSizeMax < nMempoolSizeMin)
         return InitError(strprintf(_("-maxmempool must be at least %d MB"), std::ceil(nMempoolSizeMin / 1000000.0)));
+
+    // received PocketNET data limits
+    int64_t nPocketDataSizeMax = gArgs.GetArg("-maxpocketdata", DEFAULT_MAX_POCKET_DATA_SIZE) * 1000000;
+    int64_t nPocketDataExpiry = gArgs.GetArg("-pocketdataexpiry", DEFAULT_POCKET_DATA_EXPIRY) * 60 * 60;
+    if (nPocketDataSizeMax <= 0)
+        return InitError(_("-maxpocketdata must be greater than 0"));
+    if (nPocketDataExpiry <= 0)
+        return InitError(_("-pocketdataexpiry must be greater than 0"));
+    POCKETNET_DATA.SetLimits(nPocketDataSizeMax, nPocketDataExpiry);
+
+    // public RPC results cache limit
+    int64_t nRPCCacheSizeMax = gArgs.GetArg("-rpccachesize", DEFAULT_RPC_CACHE_SIZE) * 1000000;
+    if (nRPCCacheSizeMax < 0)
+        return InitError(_("-rpccachesize must not be negative"));
+    g_rpc_cache.SetLimit(nRPCCacheSizeMax);
+
     // incremental relay fee sets the minimum feerate increase necessary for BIP 125 replacement in the mempool
     // and the amount the mempool min fee increases above the feerate of txs evicted due to mempool limiting.
     if (gArgs.IsArgSet("-incrementalrelayfee")) {
@@ -1280,11 +1315,10 @@ static void StartWS()
 
                     if (std::find(keys.begin(), keys.end(), "nonce") != keys.end()) {
                         WSUser wsUser = {connection, _addr, block, ip, service, mainPort, wssPort};
-                        WSConnections.erase(connection->ID());
-                        WSConnections.insert_or_assign(connection->ID(), wsUser);
+                        WSConnections.Set(connection->ID(), wsUser);
                     } else if (std::find(keys.begin(), keys.end(), "msg") != keys.end()) {
                         if (val["msg"].get_str() == "unsubscribe") {
-                            WSConnections.erase(connection->ID());
+                            WSConnections.Erase(connection->ID());
                         }
                     }
                 } catch (const std::exception& e) {
@@ -1301,15 +1335,11 @@ static void StartWS()
     };
 
     ws.on_close = [](std::shared_ptr<WsServer::Connection> connection, int status, const string& /*reason*/) {
-        if (WSConnections.find(connection->ID()) != WSConnections.end()) {
-            WSConnections.erase(connection->ID());
-        }
+        WSConnections.Erase(connection->ID());
     };
 
     ws.on_error = [](std::shared_ptr<WsServer::Connection> connection, const SimpleWeb::error_code& ec) {
-        if (WSConnections.find(connection->ID()) != WSConnections.end()) {
-            WSConnections.erase(connection->ID());
-        }
+        WSConnections.Erase(connection->ID());
     };
 
     server.start();
@@ -1377,6 +1407,12 @@ bool AppInitMain()
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    // Antibot checks of block use same number of threads
+    if (nScriptCheckThreads) {
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadAntiBotCheck);
+    }
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1410,6 +1446,18 @@ bool AppInitMain()
     if (!g_pocketdb->Init()) {
         return InitError(_("Unable to start reindexer database."));
     }
+    int nUTXOPrune = gArgs.GetArg("-utxoprune", DEFAULT_UTXO_PRUNE);
+    if (nUTXOPrune != 0 && nUTXOPrune < MIN_UTXO_PRUNE)
+        return InitError(strprintf(_("-utxoprune must be 0 or at least %d"), MIN_UTXO_PRUNE));
+    g_pocketdb->SetUTXOPrune(nUTXOPrune);
+    int nRatingCheckpoint = gArgs.GetArg("-ratingcheckpoint", DEFAULT_RATING_CHECKPOINT);
+    if (nRatingCheckpoint != 0 && nRatingCheckpoint < MIN_RATING_CHECKPOINT)
+        return InitError(strprintf(_("-ratingcheckpoint must be 0 or at least %d"), MIN_RATING_CHECKPOINT));
+    g_pocketdb->SetRatingCheckpointDepth(nRatingCheckpoint);
+    uiInterface.InitMessage(_("Loading search index..."));
+    if (!g_pocketdb->LoadPrefixIndex()) {
+        return InitError(_("Unable to load search index."));
+    }
     // ********************************************************* Step 4.2: Start AddrIndex
     g_addrindex = std::unique_ptr<AddrIndex>(new AddrIndex());
     // ********************************************************* Step 4.3: Start AntiBot
@@ -1911,11 +1959,28 @@ bool AppInitMain()
 #endif
 
     // Start WebSocket server
-    if (gArgs.GetBoolArg("-wsuse", false)) InitWS();
+    if (gArgs.GetBoolArg("-wsuse", false)) {
+        InitWS();
+        StartWSNotifications();
+    }
 
     // Start statistic server
     gStatEngineInstance.Run(threadGroup);
 
+    // Results of public RPC methods cached for current tip
+    {
+        LOCK(cs_main);
+        g_rpc_cache.SetHeight(chainActive.Height());
+    }
+    RegisterValidationInterface(&g_rpc_cache);
+
+    // Ranking of hierarchical strip follows tip
+    RegisterValidationInterface(&g_post_ranking);
+
+    // Lists of hot posts follow tip
+    RegisterValidationInterface(&g_hot_posts);
+    fRPCTipInterfacesRegistered = true;
+
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading"));
 
@@ -483,6 +483,21 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     return true;
 }
 
+/** Keep PocketNET data received with block. Data of blocks in flight and not connected
+ *  blocks above the tip is needed for connect and never evicted from cache. */
+static void AddPocketData(const uint256& blockhash, const PocketBlockData& data)
+{
+    LOCK(cs_main);
+    POCKETNET_DATA.Add(blockhash, data, [&blockhash](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        // Header of just received block may be unknown yet
+        if (hash == blockhash) return true;
+        if (mapBlocksInFlight.count(hash)) return true;
+
+        auto mi = mapBlockIndex.find(hash);
+        return mi != mapBlockIndex.end() && mi->second->nHeight > chainActive.Height();
+    });
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -1022,11 +1037,12 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
                 !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
 			//-------------------------
 			// Get PocketData for transactions from this block
-			std::string pocket_data;
+			PocketBlockData pocket_data;
 			if (g_addrindex->GetBlockRIData(*most_recent_block, pocket_data)) {
                 LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                         hashBlock.ToString(), pnode->GetId());
-                connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock, pocket_data));
+                // Pocket data format depends on peer version
+                connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::CMPCTBLOCK, *pcmpctblock, WrapPocketData(pocket_data)));
                 state.pindexBestHeaderSent = pindex;
             }
         }
@@ -1282,9 +1298,9 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
 
 
 			int h = pindex->nHeight;
-			std::string pocket_data;
+			PocketBlockData pocket_data;
 			if (g_addrindex->GetBlockRIData(block, pocket_data)) {
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data), pocket_data));
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data), WrapPocketData(pocket_data)));
                 // Don't set pblock as we've sent the block
             }
         } else {
@@ -1322,13 +1338,13 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
 			else {
                 // TODO (brangr): refactor this logic
 				// Get RI data for transactions from this block
-				std::string pocket_data = "";
+				PocketBlockData pocket_data;
 				g_addrindex->GetBlockRIData(*pblock, pocket_data);
 				//-----------------------
 				if (inv.type == MSG_BLOCK)
-					connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock, pocket_data));
+					connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock, WrapPocketData(pocket_data)));
 				else if (inv.type == MSG_WITNESS_BLOCK)
-					connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock, pocket_data));
+					connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock, WrapPocketData(pocket_data)));
 				else if (inv.type == MSG_CMPCT_BLOCK)
 				{
 					// If a peer is asking for old blocks, we're almost guaranteed
@@ -1341,18 +1357,18 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
 						if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
 							//-------------------------
 							// Get PocketData for transactions from this block
-							std::string _pocket_data;
+							PocketBlockData _pocket_data;
 							g_addrindex->GetBlockRIData(*a_recent_block, _pocket_data);
 							//-------------------------
-							connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block, _pocket_data));
+							connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block, WrapPocketData(_pocket_data)));
 						}
 						else {
 							CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
-							connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock, pocket_data));
+							connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock, WrapPocketData(pocket_data)));
 						}
 					}
 					else {
-						connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock, pocket_data));
+						connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock, WrapPocketData(pocket_data)));
 					}
 				}
             }
@@ -1398,9 +1414,9 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
             if (mi != mapRelay.end()) {
 				// Join PocketNet data from ReindexerDB to transaction stream
-				std::string pocket_data;
+				PocketTxData pocket_data;
                 if (g_addrindex->GetTXRIData(mi->second, pocket_data)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second, pocket_data));
+                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second, WrapPocketData(pocket_data)));
                     push = true;
                 }
             } else if (pfrom->timeLastMempoolReq) {
@@ -1409,9 +1425,9 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 // that TX couldn't have been INVed in reply to a MEMPOOL request.
                 if (txinfo.tx && txinfo.nTime <= pfrom->timeLastMempoolReq) {
 					// Join PocketNet data from ReindexerDB to transaction stream
-					std::string pocket_data;
+					PocketTxData pocket_data;
 					if (g_addrindex->GetTXRIData(txinfo.tx, pocket_data)) {
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txinfo.tx, pocket_data));
+                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txinfo.tx, WrapPocketData(pocket_data)));
                         push = true;
                     }
                 }
@@ -1456,7 +1472,7 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
 {
     // TODO (brangr): get transactions from resp - not from block
 	// Get PocketData for transactions from this block
-	std::string pocket_data;
+	PocketBlockData pocket_data;
 	g_addrindex->GetBlockRIData(block, pocket_data);
 	//-------------------------
 	// PocketData for this transactions
@@ -1472,7 +1488,7 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     LOCK(cs_main);
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
     int nSendFlags = State(pfrom->GetId())->fWantsCmpctWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp, pocket_data));
+    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp, WrapPocketData(pocket_data)));
 }
 
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
@@ -2381,9 +2397,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         RTransaction rtx(*ptx);
 		const uint256& txhash = tx.GetHash();
 		//----------------------
-		std::string pocket_data;
+		PocketTxData pocket_data;
 		if (vRecv.size() > 0) {
-			vRecv >> pocket_data;
+			vRecv >> WrapPocketData(pocket_data);
 		}
 		//----------------------
         CInv inv(MSG_TX, txhash);
@@ -2401,17 +2417,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 		
         // Antibot checked transaction with pocketnet consensus rules
         if (g_addrindex->IsPocketnetTransaction(rtx)) {
-            if (pocket_data == "") {
+            if (pocket_data.table.empty()) {
                 LogPrintf("WARNING! NetMsgType::TX Receive transaction without pocketdata: %s\n", ptx->GetHash().GetHex());
                 state.Invalid(false, REJECT_INCOMPLETE, "Network");
             } else {
                 // Check transaction with Antibot
-                UniValue _txs_src(UniValue::VOBJ);
-                _txs_src.read(pocket_data);
-
-                rtx.pTable = _txs_src["t"].get_str();
+                rtx.pTable = pocket_data.table;
                 rtx.pTransaction = g_pocketdb->DB()->NewItem(rtx.pTable);
-                rtx.pTransaction.FromJSON(DecodeBase64(_txs_src["d"].get_str()));
+                rtx.pTransaction.FromJSON(pocket_data.data);
 
                 if (rtx.pTable == "Mempool") {
                     rtx.pTable = rtx.pTransaction["table"].As<string>();
@@ -2594,13 +2607,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         CBlockHeaderAndShortTxIDs cmpctblock;
         vRecv >> cmpctblock;
 		//------------------------------
-		std::string pocket_data;
+		PocketBlockData pocket_data;
 		if (vRecv.size() > 0) {
-			vRecv >> pocket_data;
+			vRecv >> WrapPocketData(pocket_data);
 		}
 
-		if (pocket_data != "") {
-			POCKETNET_DATA.emplace(cmpctblock.header.GetHash(), pocket_data);
+		if (!pocket_data.empty()) {
+			AddPocketData(cmpctblock.header.GetHash(), pocket_data);
 		}
 		//------------------------------
         bool received_new_header = false;
@@ -2839,9 +2852,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         BlockTransactions resp;
         vRecv >> resp;
 		//------------------------------
-		std::string pocket_data;
+		PocketBlockData pocket_data;
 		if (vRecv.size() > 0) {
-			vRecv >> pocket_data;
+			vRecv >> WrapPocketData(pocket_data);
 		}
 		//------------------------------
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
@@ -2897,8 +2910,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         } // Don't hold cs_main when we call into ProcessNewBlock
 
         if (fBlockRead) {
-			if (pocket_data != "") {
-				POCKETNET_DATA.emplace(pblock->GetHash(), pocket_data);
+			if (!pocket_data.empty()) {
+				AddPocketData(pblock->GetHash(), pocket_data);
 			}
 			//----------------------------------
             bool fNewBlock = false;
@@ -2951,17 +2964,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
 
-		std::string pocket_data;
+		PocketBlockData pocket_data;
 		if (vRecv.size() > 0) {
-			vRecv >> pocket_data;
+			vRecv >> WrapPocketData(pocket_data);
 		}
 
 		std::string new_block_hash = pblock->GetHash().ToString();
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 		//----------------------------
 		// Before `ProcessNewBlock` need pass pocket data
-		if (pocket_data != "") {
-			POCKETNET_DATA.emplace(pblock->GetHash(), pocket_data);
+		if (!pocket_data.empty()) {
+			AddPocketData(pblock->GetHash(), pocket_data);
 		}
 		//----------------------------
         bool forceProcessing = false;
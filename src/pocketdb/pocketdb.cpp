@@ -4,13 +4,134 @@
 #include "pocketdb/pocketdb.h"
 #include "html.h"
 #include "tools/logger.h"
+#include <crypto/common.h>
+#include <memusage.h>
+#include <tuple>
 
 #if defined(HAVE_CONFIG_H)
 #include <config/pocketcoin-config.h>
 #endif //HAVE_CONFIG_H
 //-----------------------------------------------------
 std::unique_ptr<PocketDB> g_pocketdb;
-std::map<uint256, std::string> POCKETNET_DATA;
+PocketDataCache POCKETNET_DATA(DEFAULT_MAX_POCKET_DATA_SIZE * 1000000, DEFAULT_POCKET_DATA_EXPIRY * 60 * 60);
+//-----------------------------------------------------
+// RHash
+//-----------------------------------------------------
+static const size_t RHASH_CACHE_BLOCKS = 10;
+// Max addresses in balance and reputation cache
+static const size_t USER_CACHE_SIZE = 500000;
+
+// Rating history namespaces compacted at checkpoints <table, key field>
+static const std::vector<std::pair<std::string, std::string>> RATING_HISTORY_TABLES = {
+    {"UserRatings", "address"},
+    {"PostRatings", "posttxid"},
+    {"CommentRatings", "commentid"},
+};
+
+struct RHashTable {
+    std::string name;
+    std::vector<std::string> key;
+    std::vector<std::string> fields;
+};
+
+// Namespaces and fields included in RHash. Order of tables is part of hash.
+static const std::vector<RHashTable> RHASH_TABLES = {
+    {"Users", {"txid"}, {"txid", "block", "time", "address", "name", "birthday", "gender", "regdate", "avatar", "about", "lang", "url", "pubkey", "donations", "referrer", "id"}},
+    {"Posts", {"txid"}, {"txid", "block", "time", "address", "lang", "caption", "message", "settings", "url", "tags", "images"}},
+    {"Scores", {"txid"}, {"txid", "block", "time", "posttxid", "address", "value"}},
+    {"Subscribes", {"txid"}, {"txid", "block", "time", "address", "address_to", "private", "unsubscribe"}},
+    {"Blocking", {"txid"}, {"txid", "block", "time", "address", "address_to", "unblocking"}},
+    {"Complains", {"txid"}, {"txid", "block", "time", "posttxid", "address", "reason"}},
+    {"UTXO", {"txid", "txout"}, {"txid", "txout", "time", "block", "address", "amount", "spent_block"}},
+    {"Addresses", {"address"}, {"txid", "block", "address", "time"}},
+    {"UserRatings", {"address"}, {"block", "address", "scoreSum", "scoreCnt"}},
+    {"PostRatings", {"posttxid"}, {"block", "posttxid", "scoreSum", "scoreCnt", "reputation"}},
+};
+
+static const RHashTable* findRHashTable(const std::string& table)
+{
+    for (const auto& rtable : RHASH_TABLES)
+        if (rtable.name == table) return &rtable;
+
+    return nullptr;
+}
+
+static std::string rhashItemKey(const RHashTable& rtable, Item& item)
+{
+    std::string key;
+    for (const auto& field : rtable.key) {
+        key += item[field].As<string>();
+        key += '\0';
+    }
+
+    return key;
+}
+
+// Fixed binary encoding of field values:
+// numbers as 8 byte little endian, strings with 4 byte length prefix
+static void rhashWriteValue(CSHA256& hasher, const Variant& value)
+{
+    unsigned char buf[8];
+
+    switch (value.Type()) {
+    case KeyValueInt:
+    case KeyValueInt64:
+    case KeyValueBool:
+        hasher.Write((const unsigned char*)"i", 1);
+        WriteLE64(buf, (uint64_t)value.As<int64_t>());
+        hasher.Write(buf, 8);
+        break;
+    case KeyValueNull:
+        hasher.Write((const unsigned char*)"n", 1);
+        break;
+    default: {
+        std::string str = value.As<string>();
+        hasher.Write((const unsigned char*)"s", 1);
+        WriteLE32(buf, (uint32_t)str.size());
+        hasher.Write(buf, 4);
+        hasher.Write((const unsigned char*)str.data(), str.size());
+    }
+    }
+}
+
+static uint256 rhashItemHash(const RHashTable& rtable, Item& item)
+{
+    CSHA256 hasher;
+    unsigned char buf[4];
+
+    for (const auto& field : rtable.fields) {
+        VariantArray values = item[field];
+        WriteLE32(buf, (uint32_t)values.size());
+        hasher.Write(buf, 4);
+        for (const auto& value : values) rhashWriteValue(hasher, value);
+    }
+
+    uint256 hash;
+    hasher.Finalize(hash.begin());
+    return hash;
+}
+
+// Items of every table hashed in key order, then hashes of tables in fixed order
+static std::string finalizeRHash(const std::map<std::string, std::map<std::string, uint256>>& items)
+{
+    CSHA256 hasher;
+
+    for (const auto& rtable : RHASH_TABLES) {
+        auto it = items.find(rtable.name);
+        if (it == items.end() || it->second.empty()) continue;
+
+        CSHA256 tableHasher;
+        for (const auto& itemHash : it->second) tableHasher.Write(itemHash.second.begin(), itemHash.second.size());
+
+        uint256 tableHash;
+        tableHasher.Finalize(tableHash.begin());
+        hasher.Write(tableHash.begin(), tableHash.size());
+    }
+
+    uint256 hash;
+    hasher.Finalize(hash.begin());
+    return hash.GetHex();
+}
 //-----------------------------------------------------
 PocketDB::PocketDB()
 {
@@ -42,9 +163,12 @@ void PocketDB::CloseNamespaces()
     db->CloseNamespace("Blocking");
     db->CloseNamespace("Reposts");
     db->CloseNamespace("UTXO");
+    db->CloseNamespace("UTXOArchive");
     db->CloseNamespace("Addresses");
     db->CloseNamespace("Comments");
     db->CloseNamespace("Comment");
+    db->CloseNamespace("KeyIds");
+    db->CloseNamespace("RatingCheckpoints");
 }
 
 // Check for update DB
@@ -56,6 +180,23 @@ bool PocketDB::UpdateDB()
     Error err = SelectOne(Query("Service").Sort("version", true), service_itm);
     if (err.ok()) db_version = service_itm["version"].As<int>();
 
+    // v3 only adds counters to Posts and Comment - fill them without resync
+    if (db_version == 2) {
+        if (!BackfillCounters()) {
+            LogPrintf("Failed to update RDB structure from v2 to v3\n");
+            return false;
+        }
+        db_version = 3;
+    }
+    // v4 only adds interned id columns to Scores
+    if (db_version == 3) {
+        if (!BackfillKeyIds()) {
+            LogPrintf("Failed to update RDB structure from v3 to v4\n");
+            return false;
+        }
+        db_version = 4;
+    }
+
     // Need to update?
     if (db_version < cur_version) {
         LogPrintf("Update RDB structure from v%s to v%s. Blockchain data will be erased and uploaded again.\n", db_version, cur_version);
@@ -75,6 +216,91 @@ bool PocketDB::UpdateDB()
     return true;
 }
 
+bool PocketDB::BackfillCounters()
+{
+    LogPrintf("Update RDB structure from v2 to v3. Counting comments and reposts of posts...\n");
+
+    // Facet of field over all items, empty namespace gives empty facet
+    auto facet = [&](Query query, const std::string& field, std::map<std::string, int>& result) {
+        AggregationResult aggRes;
+        Error err = SelectAggr(query.Aggregate(field, AggFacet), field, aggRes);
+        if (!err.ok()) return err.code() == 13;
+        for (const auto& f : aggRes.facets) result.emplace(f.value, f.count);
+        return true;
+    };
+
+    std::map<std::string, int> comments;
+    std::map<std::string, int> reposts;
+    std::map<std::string, int> children;
+    if (!facet(Query("Comment").Where("last", CondEq, true), "postid", comments)) return false;
+    if (!facet(Query("Comment").Where("last", CondEq, true).Not().Where("parentid", CondEq, ""), "parentid", children)) return false;
+    if (!facet(Query("Posts").Not().Where("txidRepost", CondEq, ""), "txidRepost", reposts)) return false;
+
+    // Pages of blocks - whole namespace not loaded in memory
+    auto backfill = [&](const std::string& table, const Query& query, const std::function<void(Item&)>& fill) {
+        Item lastItm;
+        Error err = SelectOne(Query(query).Sort("block", true), lastItm);
+        if (err.code() == 13) return true;
+        if (!err.ok()) return false;
+        int lastBlock = lastItm["block"].As<int>();
+
+        for (int block = 0; block <= lastBlock; block += 10000) {
+            QueryResults res;
+            if (!db->Select(Query(query).Where("block", CondGe, block).Where("block", CondLt, block + 10000), res).ok()) return false;
+            for (auto& it : res) {
+                Item item = it.GetItem();
+                fill(item);
+                if (!db->Upsert(table, item).ok()) return false;
+            }
+            if (!db->Commit(table).ok()) return false;
+        }
+
+        return true;
+    };
+
+    if (!backfill("Posts", Query("Posts"), [&](Item& item) {
+            std::string txid = item["txid"].As<string>();
+            item["commentsCount"] = comments.count(txid) ? comments[txid] : 0;
+            item["repostCount"] = reposts.count(txid) ? reposts[txid] : 0;
+        })) return false;
+
+    if (!backfill("Comment", Query("Comment").Where("last", CondEq, true), [&](Item& item) {
+            std::string otxid = item["otxid"].As<string>();
+            item["childrenCount"] = children.count(otxid) ? children[otxid] : 0;
+        })) return false;
+
+    return true;
+}
+
+bool PocketDB::BackfillKeyIds()
+{
+    LogPrintf("Update RDB structure from v3 to v4. Interning addresses and txids of scores...\n");
+
+    // String keys are kept only for output and RHash
+    if (!db->UpdateIndex("Scores", {"posttxid", "-", "string", IndexOpts()}).ok()) return false;
+    if (!db->UpdateIndex("Scores", {"address", "-", "string", IndexOpts()}).ok()) return false;
+
+    Item lastItm;
+    Error err = SelectOne(Query("Scores").Sort("block", true), lastItm);
+    if (err.code() == 13) return true;
+    if (!err.ok()) return false;
+    int lastBlock = lastItm["block"].As<int>();
+
+    // Pages of blocks - whole namespace not loaded in memory
+    for (int block = 0; block <= lastBlock; block += 10000) {
+        QueryResults res;
+        if (!db->Select(Query("Scores").Where("block", CondGe, block).Where("block", CondLt, block + 10000), res).ok()) return false;
+        for (auto& it : res) {
+            Item item = it.GetItem();
+            if (!Upsert("Scores", item).ok()) return false;
+        }
+        if (!db->Commit("Scores").ok()) return false;
+        if (!db->Commit("KeyIds").ok()) return false;
+    }
+
+    return true;
+}
+
 bool PocketDB::ConnectDB()
 {
     db = new Reindexer();
@@ -219,6 +445,8 @@ bool PocketDB::InitDB(std::string table)
         db->AddIndex("Posts", {"scoreSum", "-", "int", IndexOpts()});
         db->AddIndex("Posts", {"scoreCnt", "-", "int", IndexOpts()});
         db->AddIndex("Posts", {"reputation", "-", "int", IndexOpts()});
+        db->AddIndex("Posts", {"commentsCount", "-", "int", IndexOpts()});
+        db->AddIndex("Posts", {"repostCount", "-", "int", IndexOpts()});
         db->AddIndex("Posts", {"caption+message", {"caption_", "message_"}, "text", "composite", IndexOpts().SetCollateMode(CollateUTF8)});
         db->Commit("Posts");
     }
@@ -262,8 +490,10 @@ bool PocketDB::InitDB(std::string table)
         db->AddIndex("Scores", {"txid", "hash", "string", IndexOpts().PK()});
         db->AddIndex("Scores", {"block", "tree", "int", IndexOpts()});
         db->AddIndex("Scores", {"time", "tree", "int64", IndexOpts()});
-        db->AddIndex("Scores", {"posttxid", "hash", "string", IndexOpts()});
-        db->AddIndex("Scores", {"address", "hash", "string", IndexOpts()});
+        db->AddIndex("Scores", {"posttxid", "-", "string", IndexOpts()});
+        db->AddIndex("Scores", {"address", "-", "string", IndexOpts()});
+        db->AddIndex("Scores", {"posttxid_id", "hash", "int64", IndexOpts()});
+        db->AddIndex("Scores", {"address_id", "hash", "int64", IndexOpts()});
         db->AddIndex("Scores", {"value", "-", "int", IndexOpts()});
         db->Commit("Scores");
     }
@@ -344,6 +574,20 @@ bool PocketDB::InitDB(std::string table)
         db->Commit("UTXO");
     }
 
+    // Spent outputs pruned from UTXO
+    if (table == "UTXOArchive" || table == "ALL") {
+        db->OpenNamespace("UTXOArchive", StorageOpts().Enabled().CreateIfMissing());
+        db->AddIndex("UTXOArchive", {"txid", "-", "string", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"txout", "-", "int", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"time", "-", "int64", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"block", "tree", "int", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"address", "hash", "string", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"amount", "-", "int64", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"spent_block", "tree", "int", IndexOpts()});
+        db->AddIndex("UTXOArchive", {"txid+txout", {"txid", "txout"}, "hash", "composite", IndexOpts().PK()});
+        db->Commit("UTXOArchive");
+    }
+
     // Addresses
     if (table == "Addresses" || table == "ALL") {
         db->OpenNamespace("Addresses", StorageOpts().Enabled().CreateIfMissing());
@@ -354,6 +598,14 @@ bool PocketDB::InitDB(std::string table)
         db->Commit("Addresses");
     }
 
+    // Interned addresses and txids
+    if (table == "KeyIds" || table == "ALL") {
+        db->OpenNamespace("KeyIds", StorageOpts().Enabled().CreateIfMissing());
+        db->AddIndex("KeyIds", {"key", "hash", "string", IndexOpts().PK()});
+        db->AddIndex("KeyIds", {"id", "tree", "int64", IndexOpts()});
+        db->Commit("KeyIds");
+    }
+
     // Comment
     if (table == "Comment" || table == "ALL") {
         db->OpenNamespace("Comment", StorageOpts().Enabled().CreateIfMissing());
@@ -370,6 +622,7 @@ bool PocketDB::InitDB(std::string table)
         db->AddIndex("Comment", {"scoreUp", "-", "int", IndexOpts()});
         db->AddIndex("Comment", {"scoreDown", "-", "int", IndexOpts()});
         db->AddIndex("Comment", {"reputation", "-", "int", IndexOpts()});
+        db->AddIndex("Comment", {"childrenCount", "-", "int", IndexOpts()});
         db->Commit("Comment");
     }
 
@@ -397,6 +650,14 @@ bool PocketDB::InitDB(std::string table)
         db->Commit("CommentScores");
     }
 
+    // Heights of rating history checkpoints
+    if (table == "RatingCheckpoints" || table == "ALL") {
+        db->OpenNamespace("RatingCheckpoints", StorageOpts().Enabled().CreateIfMissing());
+        db->AddIndex("RatingCheckpoints", {"table", "hash", "string", IndexOpts().PK()});
+        db->AddIndex("RatingCheckpoints", {"block", "-", "int", IndexOpts()});
+        db->Commit("RatingCheckpoints");
+    }
+
     // Cumulative ratings table
     // TODO (brangr): only for for threshold user reputation & must be moved to sql
     // Type for split:
@@ -424,6 +685,48 @@ bool PocketDB::InitDB(std::string table)
 
 bool PocketDB::DropTable(std::string table)
 {
+    if (table == "UsersView" || table == "ALL") {
+        LOCK(cs_bad_reputation);
+        bad_reputation_loaded = false;
+    }
+
+    {
+        LOCK(cs_profile_cache);
+        profile_cache.clear();
+        profile_cache_lru.clear();
+        profile_cache_generation += 1;
+    }
+
+    // Dropped table is empty - index stays loaded
+    if (table == "Posts" || table == "ALL") {
+        LOCK(cs_prefix_index);
+        tag_index.Clear();
+    }
+    if (table == "UsersView" || table == "ALL") {
+        LOCK(cs_prefix_index);
+        name_index.Clear();
+        name_keys.clear();
+    }
+
+    if (table == "KeyIds" || table == "ALL") {
+        LOCK(cs_key_ids);
+        key_id_next = -1;
+        key_id_cache.clear();
+    }
+
+    // History of rating table rebuilt from scratch
+    for (const auto& rtable : RATING_HISTORY_TABLES) {
+        if (table != rtable.first && table != "RatingCheckpoints" && table != "ALL") continue;
+
+        LOCK(cs_rating_checkpoints);
+        rating_checkpoints_loaded = false;
+        if (table == rtable.first) {
+            QueryResults res;
+            db->Delete(Query("RatingCheckpoints").Where("table", CondEq, table), res);
+            db->Commit("RatingCheckpoints");
+        }
+    }
+
     Error err = db->DropNamespace(table);
     if (!err.ok()) LogPrintf("Drop namespace(%s) %s\n", table, err.what());
 
@@ -640,207 +943,800 @@ Error PocketDB::SelectAggr(Query query, std::string aggId, AggregationResult& ag
     return err;
 }
 
-Error PocketDB::Upsert(std::string table, Item& item)
+void PocketDB::BeginBlockWrite(int height, bool rhash)
 {
-    return db->Upsert(table, item);
+    LOCK(cs_block_write);
+    if (block_write_height >= 0) LogPrintf("(PocketDB::BeginBlockWrite) write of block %d not ended\n", block_write_height);
+
+    block_write_height = height;
+    block_write_rhash = rhash;
+    block_rhash_items.clear();
+
+    if (rhash) beginUserCacheBlock();
 }
 
-Error PocketDB::UpsertWithCommit(std::string table, Item& item)
+void PocketDB::EndBlockWrite()
 {
-    Error err = db->Upsert(table, item);
-    if (err.ok()) return db->Commit(table);
-    return err;
+    LOCK(cs_block_write);
+    if (block_write_rhash) {
+        block_rhash[block_write_height] = finalizeRHash(block_rhash_items);
+        while (block_rhash.size() > RHASH_CACHE_BLOCKS) block_rhash.erase(block_rhash.begin());
+        commitUserCacheBlock(block_write_height);
+    }
+
+    block_write_height = -1;
+    block_write_rhash = false;
+    block_rhash_items.clear();
 }
 
-Error PocketDB::Delete(Query query)
+void PocketDB::AbortBlockWrite()
 {
-    QueryResults res;
-    Error err = db->Delete(query, res);
+    {
+        LOCK(cs_block_write);
+        block_write_height = -1;
+        block_write_rhash = false;
+        block_rhash_items.clear();
+    }
 
-    return err;
+    ResetUserCache();
 }
 
-Error PocketDB::DeleteWithCommit(Query query)
+void PocketDB::rhashItem(const std::string& table, Item& item)
 {
-    size_t deleted = 0;
-    return DeleteWithCommit(query, deleted);
+    const RHashTable* rtable = findRHashTable(table);
+    if (!rtable) return;
+
+    LOCK(cs_block_write);
+    if (!block_write_rhash || item["block"].As<int>() != block_write_height) return;
+
+    block_rhash_items[table][rhashItemKey(*rtable, item)] = rhashItemHash(*rtable, item);
 }
 
-Error PocketDB::DeleteWithCommit(Query query, size_t& deleted)
+void PocketDB::beginUserCacheBlock()
 {
-    QueryResults res;
-    Error err = db->Delete(query, res);
-    deleted = res.Count();
+    LOCK(cs_user_cache);
+    user_cache_base = user_cache_height;
+    user_cache_height = -1;
+    user_cache_generation += 1;
+    user_cache_block = true;
+    block_balance_changes.clear();
+    block_reputation_changes.clear();
+}
 
-    if (err.ok()) {
-        deleted = res.Count();
-        return db->Commit(query._namespace);
+void PocketDB::commitUserCacheBlock(int height)
+{
+    LOCK(cs_user_cache);
+    if (!user_cache_block) return;
+
+    if (user_cache_base == height - 1) {
+        for (const auto& change : block_balance_changes) {
+            auto it = user_balance_cache.find(change.first);
+            if (it != user_balance_cache.end()) it->second += change.second;
+        }
+
+        for (const auto& change : block_reputation_changes) {
+            auto it = user_reputation_cache.find(change.first);
+            if (it != user_reputation_cache.end()) it->second = change.second;
+        }
+    } else {
+        user_balance_cache.clear();
+        user_reputation_cache.clear();
     }
 
-    return err;
+    user_cache_height = height;
+    user_cache_generation += 1;
+    user_cache_block = false;
+    block_balance_changes.clear();
+    block_reputation_changes.clear();
 }
 
-
-Error PocketDB::Update(std::string table, Item& item, bool commit)
+void PocketDB::ResetUserCache()
 {
-    Error err = db->Update(table, item);
-    if (err.ok() && commit) return db->Commit(table);
-    return err;
+    LOCK(cs_user_cache);
+    user_cache_height = -1;
+    user_cache_base = -1;
+    user_cache_generation += 1;
+    user_cache_block = false;
+    user_balance_cache.clear();
+    user_reputation_cache.clear();
+    block_balance_changes.clear();
+    block_reputation_changes.clear();
 }
 
-Error PocketDB::UpdateUsersView(std::string address, int height)
+// Collect changes of balance and reputation from written items
+void PocketDB::userCacheItem(const std::string& table, Item& item)
 {
-    Item _user_itm;
-    Error err;
-    if (height >= Params().GetConsensus().checkpoint_split_content_video)
-        err = SelectOne(Query("Users").Where("address", CondEq, address).Sort("block", true), _user_itm);
-    else
-        err = SelectOne(Query("Users").Where("address", CondEq, address).Sort("time", true), _user_itm);
-
-    if (err.code() == 13) return DeleteWithCommit(Query("UsersView").Where("address", CondEq, address));
-    if (err.ok()) {
-        Item _view_itm = db->NewItem("UsersView");
-
-        _view_itm["txid"] = _user_itm["txid"].As<string>();
-        _view_itm["block"] = _user_itm["block"].As<int>();
-        _view_itm["time"] = _user_itm["time"].As<int64_t>();
-        _view_itm["address"] = _user_itm["address"].As<string>();
-        _view_itm["name"] = _user_itm["name"].As<string>();
-        _view_itm["birthday"] = _user_itm["birthday"].As<int>();
-        _view_itm["gender"] = _user_itm["gender"].As<int>();
-        _view_itm["regdate"] = _user_itm["regdate"].As<int64_t>();
-        _view_itm["avatar"] = _user_itm["avatar"].As<string>();
-        _view_itm["about"] = _user_itm["about"].As<string>();
-        _view_itm["lang"] = _user_itm["lang"].As<string>();
-        _view_itm["url"] = _user_itm["url"].As<string>();
-        _view_itm["pubkey"] = _user_itm["pubkey"].As<string>();
-        _view_itm["donations"] = _user_itm["donations"].As<string>();
-        _view_itm["referrer"] = _user_itm["referrer"].As<string>();
-        _view_itm["id"] = _user_itm["id"].As<int>();
-        _view_itm["reputation"] = GetUserReputation(address, height);
+    if (table != "UTXO" && table != "UserRatings") return;
+
+    LOCK(cs_user_cache);
+    if (!user_cache_block) {
+        // Written not by block connect
+        user_cache_height = -1;
+        user_cache_base = -1;
+        user_cache_generation += 1;
+        user_balance_cache.clear();
+        user_reputation_cache.clear();
+        return;
+    }
 
-        return UpsertWithCommit("UsersView", _view_itm);
+    if (table == "UserRatings") {
+        block_reputation_changes[item["address"].As<string>()] = item["reputation"].As<int>();
+        return;
     }
 
-    return err;
+    // UTXO: new output or spent of old output
+    int64_t amount = item["amount"].As<int64_t>();
+    if (item["spent_block"].As<int>() == 0)
+        block_balance_changes[item["address"].As<string>()] += amount;
+    else if (item["block"].As<int>() != item["spent_block"].As<int>())
+        block_balance_changes[item["address"].As<string>()] -= amount;
 }
 
-Error PocketDB::UpdateSubscribesView(std::string address, std::string address_to, int height)
+void PocketDB::badReputationItem(const std::string& table, Item& item)
 {
-    DeleteWithCommit(Query("SubscribesView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
+    if (table != "UsersView") return;
 
-    QueryResults _res;
-    Error err;
+    LOCK(cs_bad_reputation);
+    if (!bad_reputation_loaded) return;
 
-    if (height >= Params().GetConsensus().checkpoint_split_content_video)
-        err = db->Select(Query("Subscribes", 0, 1).Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("block", true), _res);
+    std::string address = item["address"].As<string>();
+    bool changed;
+    if (item["reputation"].As<int64_t>() <= bad_reputation_limit)
+        changed = bad_reputation.insert(address).second;
     else
-        err = db->Select(Query("Subscribes", 0, 1).Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("time", true), _res);
+        changed = bad_reputation.erase(address) > 0;
 
-    if (err.ok() && _res.Count() > 0) {
-        Item _itm = _res[0].GetItem();
-        if (!_itm["unsubscribe"].As<bool>())
-            return UpsertWithCommit("SubscribesView", _itm);
-    }
-    //-----------------
-    return err;
+    if (changed) bad_reputation_version += 1;
 }
 
-Error PocketDB::UpdateBlockingView(std::string address, std::string address_to, int height)
+void PocketDB::badReputationErase(const std::string& address)
 {
-    Item _blocking_itm;
-    Error err;
-    if (height >= Params().GetConsensus().checkpoint_split_content_video)
-        err = SelectOne(Query("Blocking").Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("block", true), _blocking_itm);
-    else
-        err = SelectOne(Query("Blocking").Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("time", true), _blocking_itm);
+    LOCK(cs_bad_reputation);
+    if (bad_reputation.erase(address) > 0) bad_reputation_version += 1;
+}
 
-    if (err.code() == 13) return DeleteWithCommit(Query("BlockingView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
-    if (err.ok()) {
-        if (_blocking_itm["unblocking"].As<bool>() == true) {
-            return DeleteWithCommit(Query("BlockingView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
-        } else {
-            Item _blocking_view_itm = db->NewItem("BlockingView");
-            _blocking_view_itm["txid"] = _blocking_itm["txid"].As<string>();
-            _blocking_view_itm["block"] = _blocking_itm["block"].As<int>();
-            _blocking_view_itm["time"] = _blocking_itm["time"].As<int64_t>();
-            _blocking_view_itm["address"] = _blocking_itm["address"].As<string>();
-            _blocking_view_itm["address_to"] = _blocking_itm["address_to"].As<string>();
-            _blocking_view_itm["address_reputation"] = GetUserReputation(address, _blocking_itm["block"].As<int>());
+std::shared_ptr<const std::unordered_set<std::string>> PocketDB::GetBadReputationUsers(int64_t limit)
+{
+    LOCK(cs_bad_reputation);
 
-            return UpsertWithCommit("BlockingView", _blocking_view_itm);
+    if (!bad_reputation_loaded || bad_reputation_limit != limit) {
+        bad_reputation.clear();
+
+        QueryResults res;
+        if (db->Select(Query("UsersView").Where("reputation", CondLe, limit), res).ok()) {
+            for (auto& it : res) {
+                Item item = it.GetItem();
+                bad_reputation.insert(item["address"].As<string>());
+            }
+
+            bad_reputation_loaded = true;
+            bad_reputation_limit = limit;
         }
+
+        bad_reputation_version += 1;
     }
 
-    return err;
+    if (!bad_reputation_snapshot || bad_reputation_snapshot_version != bad_reputation_version) {
+        bad_reputation_snapshot = std::make_shared<const std::unordered_set<std::string>>(bad_reputation);
+        bad_reputation_snapshot_version = bad_reputation_version;
+    }
+
+    return bad_reputation_snapshot;
 }
 
+void PocketDB::profileCacheErase(const std::string& address)
+{
+    if (address.empty()) return;
 
-Error PocketDB::CommitPostItem(Item& itm, int height)
+    LOCK(cs_profile_cache);
+    profile_cache_generation += 1;
+
+    auto it = profile_cache.find(address);
+    if (it == profile_cache.end()) return;
+
+    profile_cache_lru.erase(it->second.lru);
+    profile_cache.erase(it);
+}
+
+void PocketDB::profileCacheItem(const std::string& table, Item& item)
 {
-    Error err;
+    if (table == "UsersView") {
+        profileCacheErase(item["address"].As<string>());
+        // Count of referrals
+        profileCacheErase(item["referrer"].As<string>());
+    } else if (table == "SubscribesView") {
+        profileCacheErase(item["address"].As<string>());
+        profileCacheErase(item["address_to"].As<string>());
+    } else if (table == "Posts" || table == "BlockingView" || table == "UserRatings") {
+        profileCacheErase(item["address"].As<string>());
+    }
+}
 
-    // Move exists Post to history table
-    if (itm["txidEdit"].As<string>() != "") {
-        Item cur_post_item;
-        if (SelectOne(Query("Posts").Where("txid", CondEq, itm["txid"].As<string>()), cur_post_item).ok()) {
-            Item hist_post_item = db->NewItem("PostsHistory");
-            hist_post_item["txid"] = cur_post_item["txid"].As<string>();
-            hist_post_item["txidEdit"] = cur_post_item["txidEdit"].As<string>();
-            hist_post_item["txidRepost"] = cur_post_item["txidRepost"].As<string>();
-            hist_post_item["block"] = cur_post_item["block"].As<int>();
-            hist_post_item["time"] = cur_post_item["time"].As<int64_t>();
-            hist_post_item["address"] = cur_post_item["address"].As<string>();
-            hist_post_item["type"] = cur_post_item["type"].As<int>();
-            hist_post_item["lang"] = cur_post_item["lang"].As<string>();
-            hist_post_item["caption"] = cur_post_item["caption"].As<string>();
-            hist_post_item["message"] = cur_post_item["message"].As<string>();
-            hist_post_item["url"] = cur_post_item["url"].As<string>();
-            hist_post_item["settings"] = cur_post_item["settings"].As<string>();
+void PocketDB::profileCacheDeleted(const std::string& table, QueryResults& res)
+{
+    if (table != "UsersView" && table != "SubscribesView" && table != "Posts" && table != "BlockingView" && table != "UserRatings") return;
 
-            VariantArray vaTags = cur_post_item["tags"];
-            hist_post_item["tags"] = vaTags;
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        profileCacheItem(table, item);
+    }
+}
 
-            VariantArray vaImages = cur_post_item["images"];
-            hist_post_item["images"] = vaImages;
+uint64_t PocketDB::GetProfiles(const std::vector<std::string>& addresses, int form, std::map<std::string, UniValue>& profiles)
+{
+    LOCK(cs_profile_cache);
 
-            err = UpsertWithCommit("PostsHistory", hist_post_item);
-            if (!err.ok()) return err;
+    for (const auto& address : addresses) {
+        auto it = profile_cache.find(address);
+        if (it == profile_cache.end() || it->second.forms[form].isNull()) continue;
 
-            err = DeleteWithCommit(Query("Posts").Where("txid", CondEq, itm["txid"].As<string>()));
-            if (!err.ok()) return err;
+        profile_cache_lru.splice(profile_cache_lru.begin(), profile_cache_lru, it->second.lru);
+        profiles.insert_or_assign(address, it->second.forms[form]);
+    }
+
+    return profile_cache_generation;
+}
+
+void PocketDB::PutProfiles(const std::map<std::string, UniValue>& profiles, int form, uint64_t generation)
+{
+    LOCK(cs_profile_cache);
+    if (generation != profile_cache_generation) return;
+
+    for (const auto& profile : profiles) {
+        auto it = profile_cache.find(profile.first);
+        if (it == profile_cache.end()) {
+            profile_cache_lru.push_front(profile.first);
+            it = profile_cache.emplace(profile.first, ProfileCacheEntry()).first;
+            it->second.lru = profile_cache_lru.begin();
+        } else {
+            profile_cache_lru.splice(profile_cache_lru.begin(), profile_cache_lru, it->second.lru);
         }
 
-        // Restore rating for Edit Post
-        int sum = 0;
-        int cnt = 0;
-        int rep = 0;
-        GetPostRating(itm["txid"].As<string>(), sum, cnt, rep, height);
-        itm["scoreSum"] = sum;
-        itm["scoreCnt"] = cnt;
-        itm["reputation"] = rep;
+        it->second.forms[form] = profile.second;
     }
 
-    // Insert new Post
-    err = UpsertWithCommit("Posts", itm);
-    return err;
+    while (profile_cache.size() > PROFILE_CACHE_SIZE) {
+        profile_cache.erase(profile_cache_lru.back());
+        profile_cache_lru.pop_back();
+    }
 }
 
-Error PocketDB::RestorePostItem(std::string posttxid, int height)
+void PocketDB::keyIdCache(const std::string& key, int64_t id)
 {
-    // Move exists Post to history table
-    Item hist_post_item;
-    Error err = SelectOne(Query("PostsHistory").Where("txid", CondEq, posttxid).Sort("block", true), hist_post_item);
-    if (err.ok()) {
-        std::string posttxid_edit = hist_post_item["txidEdit"].As<string>();
+    // Arbitrary keys evicted - hot keys are loaded again with next lookup
+    while (key_id_cache.size() >= KEY_ID_CACHE_SIZE) key_id_cache.erase(key_id_cache.begin());
+    key_id_cache.emplace(key, id);
+}
 
-        Item post_item = db->NewItem("Posts");
-        post_item["txid"] = hist_post_item["txid"].As<string>();
-        post_item["txidEdit"] = posttxid_edit;
-        post_item["txidRepost"] = hist_post_item["txidRepost"].As<string>();
-        post_item["block"] = hist_post_item["block"].As<int>();
-        post_item["time"] = hist_post_item["time"].As<int64_t>();
-        post_item["address"] = hist_post_item["address"].As<string>();
+Error PocketDB::internKey(const std::string& key, int64_t& id)
+{
+    LOCK(cs_key_ids);
+
+    auto it = key_id_cache.find(key);
+    if (it != key_id_cache.end()) {
+        id = it->second;
+        return Error();
+    }
+
+    Item keyItm;
+    Error err = SelectOne(Query("KeyIds").Where("key", CondEq, key), keyItm);
+    if (err.ok()) {
+        id = keyItm["id"].As<int64_t>();
+        keyIdCache(key, id);
+        return err;
+    }
+    if (err.code() != 13) return err;
+
+    if (key_id_next < 0) {
+        Item lastItm;
+        err = SelectOne(Query("KeyIds").Sort("id", true), lastItm);
+        if (err.ok())
+            key_id_next = lastItm["id"].As<int64_t>() + 1;
+        else if (err.code() == 13)
+            key_id_next = 0;
+        else
+            return err;
+    }
+
+    keyItm = db->NewItem("KeyIds");
+    keyItm["key"] = key;
+    keyItm["id"] = key_id_next;
+    err = db->Upsert("KeyIds", keyItm);
+    if (!err.ok()) return err;
+
+    id = key_id_next++;
+    keyIdCache(key, id);
+    return db->Commit("KeyIds");
+}
+
+Error PocketDB::internItem(const std::string& table, Item& item)
+{
+    if (table != "Scores") return Error();
+
+    int64_t id;
+    Error err = internKey(item["address"].As<string>(), id);
+    if (!err.ok()) return err;
+    item["address_id"] = id;
+
+    err = internKey(item["posttxid"].As<string>(), id);
+    if (!err.ok()) return err;
+    item["posttxid_id"] = id;
+
+    return err;
+}
+
+int64_t PocketDB::GetKeyId(const std::string& key)
+{
+    std::vector<int64_t> ids = GetKeyIds({key});
+    return ids.empty() ? -1 : ids[0];
+}
+
+std::vector<int64_t> PocketDB::GetKeyIds(const std::vector<std::string>& keys)
+{
+    std::vector<int64_t> ids;
+    std::vector<std::string> misses;
+
+    LOCK(cs_key_ids);
+    for (const auto& key : keys) {
+        auto it = key_id_cache.find(key);
+        if (it != key_id_cache.end())
+            ids.push_back(it->second);
+        else
+            misses.push_back(key);
+    }
+
+    if (misses.empty()) return ids;
+
+    QueryResults res;
+    if (db->Select(Query("KeyIds").Where("key", CondSet, misses), res).ok()) {
+        for (auto& it : res) {
+            Item keyItm = it.GetItem();
+            int64_t id = keyItm["id"].As<int64_t>();
+            ids.push_back(id);
+            keyIdCache(keyItm["key"].As<string>(), id);
+        }
+    }
+
+    return ids;
+}
+
+bool PocketDB::GetBlockRHash(int height, std::string& hash)
+{
+    {
+        LOCK(cs_block_write);
+        auto it = block_rhash.find(height);
+        if (it != block_rhash.end()) {
+            hash = it->second;
+            return true;
+        }
+    }
+
+    // Not cached (node restarted) - restore from DB
+    std::map<std::string, std::map<std::string, uint256>> items;
+    for (const auto& rtable : RHASH_TABLES) {
+        QueryResults res;
+        Error err = db->Select(Query(rtable.name).Where("block", CondEq, height), res);
+        if (!err.ok()) return false;
+
+        for (auto& it : res) {
+            Item item = it.GetItem();
+            items[rtable.name][rhashItemKey(rtable, item)] = rhashItemHash(rtable, item);
+        }
+    }
+
+    hash = finalizeRHash(items);
+    return true;
+}
+
+void PocketDB::RollbackBlockRHash(int height)
+{
+    LOCK(cs_block_write);
+    block_rhash.erase(block_rhash.upper_bound(height), block_rhash.end());
+}
+
+Error PocketDB::Upsert(std::string table, Item& item)
+{
+    Error err = internItem(table, item);
+    if (!err.ok()) return err;
+
+    err = db->Upsert(table, item);
+    if (err.ok()) {
+        rhashItem(table, item);
+        userCacheItem(table, item);
+        badReputationItem(table, item);
+        profileCacheItem(table, item);
+        prefixIndexItem(table, item);
+    }
+    return err;
+}
+
+Error PocketDB::UpsertWithCommit(std::string table, Item& item)
+{
+    Error err = Upsert(table, item);
+    if (err.ok()) return db->Commit(table);
+    return err;
+}
+
+Error PocketDB::Delete(Query query)
+{
+    QueryResults res;
+    Error err = db->Delete(query, res);
+    if (err.ok()) {
+        profileCacheDeleted(query._namespace, res);
+        prefixIndexDeleted(query._namespace, res);
+    }
+
+    return err;
+}
+
+Error PocketDB::DeleteWithCommit(Query query)
+{
+    size_t deleted = 0;
+    return DeleteWithCommit(query, deleted);
+}
+
+Error PocketDB::DeleteWithCommit(Query query, size_t& deleted)
+{
+    QueryResults res;
+    Error err = db->Delete(query, res);
+    deleted = res.Count();
+
+    if (err.ok()) {
+        deleted = res.Count();
+        profileCacheDeleted(query._namespace, res);
+        prefixIndexDeleted(query._namespace, res);
+        return db->Commit(query._namespace);
+    }
+
+    return err;
+}
+
+
+Error PocketDB::Update(std::string table, Item& item, bool commit)
+{
+    Error err = internItem(table, item);
+    if (!err.ok()) return err;
+
+    err = db->Update(table, item);
+    if (err.ok()) {
+        rhashItem(table, item);
+        userCacheItem(table, item);
+        badReputationItem(table, item);
+        profileCacheItem(table, item);
+        prefixIndexItem(table, item);
+    }
+    if (err.ok() && commit) return db->Commit(table);
+    return err;
+}
+
+Error PocketDB::WriteUTXOBatch(const UTXOBatch& batch)
+{
+    // Outputs created and spent in the same block not need lookup
+    std::set<std::pair<std::string, int>> created;
+    for (const auto& out : batch.outs) created.emplace(out.txid, out.txout);
+
+    std::set<std::pair<std::string, int>> spentInBlock;
+    std::vector<VariantArray> spentKeys;
+    for (const auto& spent : batch.spents) {
+        if (created.count(spent)) {
+            spentInBlock.insert(spent);
+            continue;
+        }
+
+        spentKeys.push_back({Variant(spent.first), Variant(spent.second)});
+    }
+
+    Error err;
+    for (const auto& out : batch.outs) {
+        Item item = db->NewItem("UTXO");
+        item["address"] = out.address;
+        item["txid"] = out.txid;
+        item["block"] = batch.height;
+        item["txout"] = out.txout;
+        item["time"] = out.time;
+        item["amount"] = out.amount;
+        item["spent_block"] = spentInBlock.count({out.txid, out.txout}) ? batch.height : 0;
+
+        err = Upsert("UTXO", item);
+        if (!err.ok()) return err;
+    }
+
+    // Mark all previous outputs as spent with single select
+    if (!spentKeys.empty()) {
+        QueryResults res;
+        err = db->Select(Query("UTXO").WhereComposite("txid+txout", CondSet, spentKeys), res);
+        if (!err.ok()) return err;
+
+        for (auto& it : res) {
+            Item item = it.GetItem();
+            item["spent_block"] = batch.height;
+
+            err = Upsert("UTXO", item);
+            if (!err.ok()) return err;
+        }
+    }
+
+    return db->Commit("UTXO");
+}
+
+void PocketDB::SetUTXOPrune(int depth)
+{
+    LOCK(cs_utxo_prune);
+    utxo_prune = depth;
+}
+
+Error PocketDB::PruneUTXO(int height)
+{
+    LOCK(cs_utxo_prune);
+    if (utxo_prune <= 0) return Error();
+    if (!utxo_prune_pending && height % UTXO_PRUNE_INTERVAL != 0) return Error();
+
+    QueryResults res;
+    Error err = db->Select(Query("UTXO").Where("spent_block", CondGt, 0).Where("spent_block", CondLe, height - utxo_prune).Limit(UTXO_PRUNE_BATCH), res);
+    if (!err.ok()) return err;
+
+    // Archive written first - output not lost if delete failed
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        Item archiveItm = db->NewItem("UTXOArchive");
+        err = archiveItm.FromJSON(item.GetJSON());
+        if (!err.ok()) return err;
+        err = db->Upsert("UTXOArchive", archiveItm);
+        if (!err.ok()) return err;
+    }
+    err = db->Commit("UTXOArchive");
+    if (!err.ok()) return err;
+
+    size_t moved = 0;
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        err = db->Delete("UTXO", item);
+        if (!err.ok()) return err;
+        moved += 1;
+    }
+    err = db->Commit("UTXO");
+    if (!err.ok()) return err;
+
+    utxo_pruned += moved;
+    utxo_prune_pending = (moved == UTXO_PRUNE_BATCH);
+    return err;
+}
+
+Error PocketDB::RollbackUTXOArchive(int height)
+{
+    QueryResults res;
+    Error err = db->Select(Query("UTXOArchive").Where("spent_block", CondGt, height), res);
+    if (!err.ok() || res.Count() == 0) return err;
+
+    for (auto& it : res) {
+        Item item = it.GetItem();
+
+        // Outputs of blocks above height dropped with UTXO rollback
+        if (item["block"].As<int>() <= height) {
+            Item utxoItm = db->NewItem("UTXO");
+            err = utxoItm.FromJSON(item.GetJSON());
+            if (!err.ok()) return err;
+            utxoItm["spent_block"] = 0;
+            err = Upsert("UTXO", utxoItm);
+            if (!err.ok()) return err;
+        }
+
+        err = db->Delete("UTXOArchive", item);
+        if (!err.ok()) return err;
+    }
+
+    err = db->Commit("UTXO");
+    if (!err.ok()) return err;
+    return db->Commit("UTXOArchive");
+}
+
+UniValue PocketDB::GetUTXOStat()
+{
+    UniValue result(UniValue::VOBJ);
+    {
+        LOCK(cs_utxo_prune);
+        result.pushKV("prune", utxo_prune);
+        result.pushKV("pruned", utxo_pruned);
+    }
+
+    // <items, bytes of data and indexes>
+    auto memStat = [&](const std::string& table) -> std::pair<int64_t, int64_t> {
+        Item statItm;
+        UniValue stat(UniValue::VOBJ);
+        if (!SelectOne(Query("#memstats").Where("name", CondEq, table), statItm).ok() || !stat.read(statItm.GetJSON().ToString())) return {0, 0};
+
+        const UniValue& items = find_value(stat, "items_count");
+        const UniValue& data = find_value(find_value(stat, "total"), "data_size");
+        const UniValue& indexes = find_value(find_value(stat, "total"), "indexes_size");
+        if (!items.isNum() || !data.isNum() || !indexes.isNum()) return {0, 0};
+
+        return {items.get_int64(), data.get_int64() + indexes.get_int64()};
+    };
+
+    auto hot = memStat("UTXO");
+    auto archive = memStat("UTXOArchive");
+
+    UniValue hotStat(UniValue::VOBJ);
+    hotStat.pushKV("items", hot.first);
+    hotStat.pushKV("size", hot.second);
+    result.pushKV("UTXO", hotStat);
+
+    UniValue archiveStat(UniValue::VOBJ);
+    archiveStat.pushKV("items", archive.first);
+    archiveStat.pushKV("size", archive.second);
+    result.pushKV("UTXOArchive", archiveStat);
+
+    // Archived outputs counted with mean size of hot output
+    result.pushKV("reclaimed", hot.first > 0 ? archive.first * hot.second / hot.first : 0);
+
+    return result;
+}
+
+Error PocketDB::UpdateUsersView(std::string address, int height)
+{
+    Item _user_itm;
+    Error err;
+    if (height >= Params().GetConsensus().checkpoint_split_content_video)
+        err = SelectOne(Query("Users").Where("address", CondEq, address).Sort("block", true), _user_itm);
+    else
+        err = SelectOne(Query("Users").Where("address", CondEq, address).Sort("time", true), _user_itm);
+
+    if (err.code() == 13) {
+        badReputationErase(address);
+        return DeleteWithCommit(Query("UsersView").Where("address", CondEq, address));
+    }
+    if (err.ok()) {
+        Item _view_itm = db->NewItem("UsersView");
+
+        _view_itm["txid"] = _user_itm["txid"].As<string>();
+        _view_itm["block"] = _user_itm["block"].As<int>();
+        _view_itm["time"] = _user_itm["time"].As<int64_t>();
+        _view_itm["address"] = _user_itm["address"].As<string>();
+        _view_itm["name"] = _user_itm["name"].As<string>();
+        _view_itm["birthday"] = _user_itm["birthday"].As<int>();
+        _view_itm["gender"] = _user_itm["gender"].As<int>();
+        _view_itm["regdate"] = _user_itm["regdate"].As<int64_t>();
+        _view_itm["avatar"] = _user_itm["avatar"].As<string>();
+        _view_itm["about"] = _user_itm["about"].As<string>();
+        _view_itm["lang"] = _user_itm["lang"].As<string>();
+        _view_itm["url"] = _user_itm["url"].As<string>();
+        _view_itm["pubkey"] = _user_itm["pubkey"].As<string>();
+        _view_itm["donations"] = _user_itm["donations"].As<string>();
+        _view_itm["referrer"] = _user_itm["referrer"].As<string>();
+        _view_itm["id"] = _user_itm["id"].As<int>();
+        _view_itm["reputation"] = GetUserReputation(address, height);
+
+        return UpsertWithCommit("UsersView", _view_itm);
+    }
+
+    return err;
+}
+
+Error PocketDB::UpdateSubscribesView(std::string address, std::string address_to, int height)
+{
+    DeleteWithCommit(Query("SubscribesView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
+
+    QueryResults _res;
+    Error err;
+
+    if (height >= Params().GetConsensus().checkpoint_split_content_video)
+        err = db->Select(Query("Subscribes", 0, 1).Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("block", true), _res);
+    else
+        err = db->Select(Query("Subscribes", 0, 1).Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("time", true), _res);
+
+    if (err.ok() && _res.Count() > 0) {
+        Item _itm = _res[0].GetItem();
+        if (!_itm["unsubscribe"].As<bool>())
+            return UpsertWithCommit("SubscribesView", _itm);
+    }
+    //-----------------
+    return err;
+}
+
+Error PocketDB::UpdateBlockingView(std::string address, std::string address_to, int height)
+{
+    Item _blocking_itm;
+    Error err;
+    if (height >= Params().GetConsensus().checkpoint_split_content_video)
+        err = SelectOne(Query("Blocking").Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("block", true), _blocking_itm);
+    else
+        err = SelectOne(Query("Blocking").Where("address", CondEq, address).Where("address_to", CondEq, address_to).Sort("time", true), _blocking_itm);
+
+    if (err.code() == 13) return DeleteWithCommit(Query("BlockingView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
+    if (err.ok()) {
+        if (_blocking_itm["unblocking"].As<bool>() == true) {
+            return DeleteWithCommit(Query("BlockingView").Where("address", CondEq, address).Where("address_to", CondEq, address_to));
+        } else {
+            Item _blocking_view_itm = db->NewItem("BlockingView");
+            _blocking_view_itm["txid"] = _blocking_itm["txid"].As<string>();
+            _blocking_view_itm["block"] = _blocking_itm["block"].As<int>();
+            _blocking_view_itm["time"] = _blocking_itm["time"].As<int64_t>();
+            _blocking_view_itm["address"] = _blocking_itm["address"].As<string>();
+            _blocking_view_itm["address_to"] = _blocking_itm["address_to"].As<string>();
+
+            // Reputation at block of blocking - rollback below rating checkpoint needs reindex
+            int rep = 0;
+            if (!GetUserReputation(address, _blocking_itm["block"].As<int>(), rep))
+                return Error(errLogic, "reputation history of blocking " + _blocking_itm["txid"].As<string>() + " compacted");
+            _blocking_view_itm["address_reputation"] = rep;
+
+            return UpsertWithCommit("BlockingView", _blocking_view_itm);
+        }
+    }
+
+    return err;
+}
+
+
+Error PocketDB::CommitPostItem(Item& itm, int height)
+{
+    Error err;
+
+    // Move exists Post to history table
+    if (itm["txidEdit"].As<string>() != "") {
+        Item cur_post_item;
+        if (SelectOne(Query("Posts").Where("txid", CondEq, itm["txid"].As<string>()), cur_post_item).ok()) {
+            Item hist_post_item = db->NewItem("PostsHistory");
+            hist_post_item["txid"] = cur_post_item["txid"].As<string>();
+            hist_post_item["txidEdit"] = cur_post_item["txidEdit"].As<string>();
+            hist_post_item["txidRepost"] = cur_post_item["txidRepost"].As<string>();
+            hist_post_item["block"] = cur_post_item["block"].As<int>();
+            hist_post_item["time"] = cur_post_item["time"].As<int64_t>();
+            hist_post_item["address"] = cur_post_item["address"].As<string>();
+            hist_post_item["type"] = cur_post_item["type"].As<int>();
+            hist_post_item["lang"] = cur_post_item["lang"].As<string>();
+            hist_post_item["caption"] = cur_post_item["caption"].As<string>();
+            hist_post_item["message"] = cur_post_item["message"].As<string>();
+            hist_post_item["url"] = cur_post_item["url"].As<string>();
+            hist_post_item["settings"] = cur_post_item["settings"].As<string>();
+
+            VariantArray vaTags = cur_post_item["tags"];
+            hist_post_item["tags"] = vaTags;
+
+            VariantArray vaImages = cur_post_item["images"];
+            hist_post_item["images"] = vaImages;
+
+            err = UpsertWithCommit("PostsHistory", hist_post_item);
+            if (!err.ok()) return err;
+
+            err = DeleteWithCommit(Query("Posts").Where("txid", CondEq, itm["txid"].As<string>()));
+            if (!err.ok()) return err;
+        }
+
+        // Restore rating for Edit Post
+        int sum = 0;
+        int cnt = 0;
+        int rep = 0;
+        GetPostRating(itm["txid"].As<string>(), sum, cnt, rep, height);
+        itm["scoreSum"] = sum;
+        itm["scoreCnt"] = cnt;
+        itm["reputation"] = rep;
+    }
+
+    // Edited Post keeps comments and reposts
+    countPostCounters(itm);
+
+    // Insert new Post
+    err = UpsertWithCommit("Posts", itm);
+    if (err.ok()) prefixIndexTags(itm, 1);
+    return err;
+}
+
+Error PocketDB::RestorePostItem(std::string posttxid, int height)
+{
+    // Move exists Post to history table
+    Item hist_post_item;
+    Error err = SelectOne(Query("PostsHistory").Where("txid", CondEq, posttxid).Sort("block", true), hist_post_item);
+    if (err.ok()) {
+        std::string posttxid_edit = hist_post_item["txidEdit"].As<string>();
+
+        Item post_item = db->NewItem("Posts");
+        post_item["txid"] = hist_post_item["txid"].As<string>();
+        post_item["txidEdit"] = posttxid_edit;
+        post_item["txidRepost"] = hist_post_item["txidRepost"].As<string>();
+        post_item["block"] = hist_post_item["block"].As<int>();
+        post_item["time"] = hist_post_item["time"].As<int64_t>();
+        post_item["address"] = hist_post_item["address"].As<string>();
         post_item["type"] = hist_post_item["type"].As<int>();
         post_item["lang"] = hist_post_item["lang"].As<string>();
         post_item["caption"] = hist_post_item["caption"].As<string>();
@@ -869,6 +1765,8 @@ Error PocketDB::RestorePostItem(std::string posttxid, int height)
         post_item["scoreCnt"] = cnt;
         post_item["reputation"] = rep;
 
+        countPostCounters(post_item);
+
         // Before restore need delete current item
         err = DeleteWithCommit(Query("Posts").Where("txid", CondEq, posttxid));
         if (!err.ok()) return err;
@@ -876,6 +1774,7 @@ Error PocketDB::RestorePostItem(std::string posttxid, int height)
         // Restore Post item
         err = UpsertWithCommit("Posts", post_item);
         if (!err.ok()) return err;
+        prefixIndexTags(post_item, 1);
 
         // Clear history
         err = DeleteWithCommit(Query("PostsHistory").Where("txid", CondEq, posttxid).Where("txidEdit", CondEq, posttxid_edit));
@@ -914,6 +1813,9 @@ Error PocketDB::CommitLastItem(std::string table, Item& itm, int height)
     itm["scoreDown"] = down;
     itm["reputation"] = rep;
 
+    // Edited comment keeps answers
+    countCommentCounters(itm);
+
     // Insert new item
     itm["last"] = true;
     err = UpsertWithCommit(table, itm);
@@ -948,6 +1850,8 @@ Error PocketDB::RestoreLastItem(std::string table, std::string txid, std::string
             last_item["scoreDown"] = down;
             last_item["reputation"] = rep;
 
+            countCommentCounters(last_item);
+
             err = UpsertWithCommit(table, last_item);
             return err;
 
@@ -959,9 +1863,63 @@ Error PocketDB::RestoreLastItem(std::string table, std::string txid, std::string
     }
 }
 
+void PocketDB::countPostCounters(Item& item)
+{
+    std::string txid = item["txid"].As<string>();
+    item["commentsCount"] = (int)SelectCount(Query("Comment").Where("postid", CondEq, txid).Where("last", CondEq, true));
+    item["repostCount"] = (int)SelectCount(Query("Posts").Where("txidRepost", CondEq, txid));
+}
+
+void PocketDB::countCommentCounters(Item& item)
+{
+    std::string otxid = item["otxid"].As<string>();
+    item["childrenCount"] = (int)SelectCount(Query("Comment").Where("parentid", CondEq, otxid).Where("last", CondEq, true));
+}
+
+Error PocketDB::UpdatePostCounters(std::string posttxid)
+{
+    Item item;
+    Error err = SelectOne(Query("Posts").Where("txid", CondEq, posttxid), item);
+    if (err.code() == 13) return Error(errOK);
+    if (!err.ok()) return err;
+
+    int comments = item["commentsCount"].As<int>();
+    int reposts = item["repostCount"].As<int>();
+    countPostCounters(item);
+    if (comments == item["commentsCount"].As<int>() && reposts == item["repostCount"].As<int>()) return Error(errOK);
+
+    return UpsertWithCommit("Posts", item);
+}
+
+Error PocketDB::UpdateCommentCounters(std::string otxid)
+{
+    Item item;
+    Error err = SelectOne(Query("Comment").Where("otxid", CondEq, otxid).Where("last", CondEq, true), item);
+    if (err.code() == 13) return Error(errOK);
+    if (!err.ok()) return err;
+
+    int children = item["childrenCount"].As<int>();
+    countCommentCounters(item);
+    if (children == item["childrenCount"].As<int>()) return Error(errOK);
+
+    return UpsertWithCommit("Comment", item);
+}
+
 
 int64_t PocketDB::GetUserBalance(std::string _address, int height)
 {
+    // Balance for next block served from cache
+    uint64_t generation;
+    {
+        LOCK(cs_user_cache);
+        generation = user_cache_generation;
+        if (user_cache_height < 0 || height != user_cache_height + 1) generation = 0;
+
+        auto it = user_balance_cache.find(_address);
+        if (generation && it != user_balance_cache.end()) return it->second;
+    }
+
+    int64_t balance = 0;
     AggregationResult aggRes;
     if (SelectAggr(
             Query("UTXO")
@@ -971,10 +1929,18 @@ int64_t PocketDB::GetUserBalance(std::string _address, int height)
                 .Aggregate("amount", AggSum),
             "amount", aggRes)
             .ok()) {
-        return (int64_t)aggRes.value;
-    } else {
-        return 0;
+        balance = (int64_t)aggRes.value;
+    }
+
+    if (generation) {
+        LOCK(cs_user_cache);
+        if (generation == user_cache_generation) {
+            if (user_balance_cache.size() >= USER_CACHE_SIZE) user_balance_cache.clear();
+            user_balance_cache.emplace(_address, balance);
+        }
     }
+
+    return balance;
 }
 
 std::tuple<int, int> PocketDB::GetUserData(std::string address)
@@ -988,8 +1954,33 @@ std::tuple<int, int> PocketDB::GetUserData(std::string address)
 
 int PocketDB::GetUserReputation(std::string _address, int height)
 {
-    // Set to default if rating for user not found
     int rep = 0;
+    if (!GetUserReputation(_address, height, rep))
+        LogPrintf("(PocketDB::GetUserReputation) history of %d below rating checkpoint\n", height);
+    return rep;
+}
+
+bool PocketDB::GetUserReputation(const std::string& _address, int height, int& rep)
+{
+    // Set to default if rating for user not found
+    rep = 0;
+
+    // Reputation for chain tip served from cache
+    uint64_t generation;
+    {
+        LOCK(cs_user_cache);
+        generation = user_cache_generation;
+        if (user_cache_height < 0 || height != user_cache_height) generation = 0;
+
+        auto it = user_reputation_cache.find(_address);
+        if (generation && it != user_reputation_cache.end()) {
+            rep = it->second;
+            return true;
+        }
+    }
+
+    // History below checkpoint compacted
+    if (height < ratingCheckpoint("UserRatings")) return false;
 
     // Sorting by block desc - last accumulating rating
     Item _itm_rating;
@@ -1003,7 +1994,15 @@ int PocketDB::GetUserReputation(std::string _address, int height)
         rep = _itm_rating["reputation"].As<int>();
     }
 
-    return rep;
+    if (generation) {
+        LOCK(cs_user_cache);
+        if (generation == user_cache_generation) {
+            if (user_reputation_cache.size() >= USER_CACHE_SIZE) user_reputation_cache.clear();
+            user_reputation_cache.emplace(_address, rep);
+        }
+    }
+
+    return true;
 }
 
 int PocketDB::GetUserLikersCount(int userId, int height)
@@ -1045,13 +2044,158 @@ bool PocketDB::UpdateUserReputation(std::string address, int height)
 }
 
 
-void PocketDB::GetPostRating(std::string posttxid, int& sum, int& cnt, int& rep, int height)
+void PocketDB::loadRatingCheckpoints()
+{
+    if (rating_checkpoints_loaded) return;
+
+    rating_checkpoints.clear();
+    QueryResults res;
+    if (!db->Select(Query("RatingCheckpoints"), res).ok()) return;
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        rating_checkpoints[item["table"].As<string>()] = item["block"].As<int>();
+    }
+    rating_checkpoints_saved = rating_checkpoints;
+
+    rating_checkpoints_loaded = true;
+}
+
+Error PocketDB::compactRatings(const std::string& table, const std::string& key, int fromBlock, int toBlock)
+{
+    QueryResults res;
+    Error err = db->Select(Query(table).Where("block", CondGt, fromBlock).Where("block", CondLe, toBlock), res);
+    if (!err.ok()) return err;
+
+    // <key, block of last row>
+    std::map<std::string, int> lastBlocks;
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        int block = item["block"].As<int>();
+        auto ins = lastBlocks.emplace(item[key].As<string>(), block);
+        if (!ins.second && ins.first->second < block) ins.first->second = block;
+    }
+
+    if (lastBlocks.empty()) return err;
+
+    for (auto& it : res) {
+        Item item = it.GetItem();
+        if (item["block"].As<int>() < lastBlocks[item[key].As<string>()]) {
+            err = db->Delete(table, item);
+            if (!err.ok()) return err;
+        }
+    }
+
+    // Only one row of key left below range after previous step
+    std::vector<std::string> keys;
+    for (const auto& lastBlock : lastBlocks) keys.push_back(lastBlock.first);
+
+    QueryResults delRes;
+    err = db->Delete(Query(table).Where(key, CondSet, keys).Where("block", CondLe, fromBlock), delRes);
+    if (!err.ok()) return err;
+
+    return db->Commit(table);
+}
+
+int PocketDB::ratingCheckpoint(const std::string& table)
+{
+    LOCK(cs_rating_checkpoints);
+    loadRatingCheckpoints();
+
+    auto it = rating_checkpoints.find(table);
+    return it != rating_checkpoints.end() ? it->second : -1;
+}
+
+void PocketDB::SetRatingCheckpointDepth(int depth)
+{
+    LOCK(cs_rating_checkpoints);
+    rating_checkpoint_depth = depth;
+}
+
+Error PocketDB::CheckpointRatings(int height)
+{
+    // <table, key, fromBlock, toBlock>
+    std::vector<std::tuple<std::string, std::string, int, int>> steps;
+
+    // Steps planned and checkpoints raised under lock - reads below them fail before compaction starts
+    {
+        LOCK(cs_rating_checkpoints);
+        if (rating_checkpoint_depth <= 0) return Error();
+
+        int checkpoint = height - rating_checkpoint_depth;
+        if (checkpoint <= 0) return Error();
+        if (!rating_checkpoints_pending && height % RATING_CHECKPOINT_INTERVAL != 0) return Error();
+        loadRatingCheckpoints();
+
+        rating_checkpoints_pending = false;
+        for (const auto& rtable : RATING_HISTORY_TABLES) {
+            auto it = rating_checkpoints_saved.find(rtable.first);
+            int fromBlock = it != rating_checkpoints_saved.end() ? it->second : -1;
+
+            // History of old DB compacted by steps
+            while (fromBlock < checkpoint && (int)steps.size() < RATING_CHECKPOINT_STEPS) {
+                int toBlock = std::min(fromBlock + RATING_CHECKPOINT_INTERVAL, checkpoint);
+                steps.emplace_back(rtable.first, rtable.second, fromBlock, toBlock);
+                fromBlock = toBlock;
+            }
+
+            if (fromBlock < checkpoint) rating_checkpoints_pending = true;
+            if (fromBlock > ratingCheckpoint(rtable.first)) rating_checkpoints[rtable.first] = fromBlock;
+        }
+    }
+
+    // Readers not blocked by compaction
+    for (const auto& step : steps) {
+        const std::string& table = std::get<0>(step);
+        int toBlock = std::get<3>(step);
+
+        Error err = compactRatings(table, std::get<1>(step), std::get<2>(step), toBlock);
+        if (!err.ok()) {
+            // Range repeated by next block, raised checkpoint kept - history of range may be half compacted
+            LOCK(cs_rating_checkpoints);
+            rating_checkpoints_pending = true;
+            return err;
+        }
+
+        // Saved with every step - interrupted compaction continues from it
+        Item checkpointItm = db->NewItem("RatingCheckpoints");
+        checkpointItm["table"] = table;
+        checkpointItm["block"] = toBlock;
+        err = db->Upsert("RatingCheckpoints", checkpointItm);
+        if (err.ok()) err = db->Commit("RatingCheckpoints");
+
+        LOCK(cs_rating_checkpoints);
+        if (!err.ok()) {
+            rating_checkpoints_pending = true;
+            return err;
+        }
+        rating_checkpoints_saved[table] = toBlock;
+    }
+
+    return Error();
+}
+
+int PocketDB::GetRatingCheckpoint()
+{
+    LOCK(cs_rating_checkpoints);
+    loadRatingCheckpoints();
+
+    int checkpoint = -1;
+    for (const auto& rating_checkpoint : rating_checkpoints)
+        checkpoint = std::max(checkpoint, rating_checkpoint.second);
+
+    return checkpoint;
+}
+
+bool PocketDB::GetPostRating(std::string posttxid, int& sum, int& cnt, int& rep, int height)
 {
     // Set to default if rating for post not found
     sum = 0;
     cnt = 0;
     rep = 0;
 
+    // History below checkpoint compacted
+    if (height < ratingCheckpoint("PostRatings")) return false;
+
     // Sorting by block desc - last accumulating rating
     Item _itm_rating_cur;
     if (SelectOne(
@@ -1065,6 +2209,8 @@ void PocketDB::GetPostRating(std::string posttxid, int& sum, int& cnt, int& rep,
         cnt = _itm_rating_cur["scoreCnt"].As<int>();
         rep = _itm_rating_cur["reputation"].As<int>();
     }
+
+    return true;
 }
 
 bool PocketDB::UpdatePostRating(std::string posttxid, int sum, int cnt, int& rep)
@@ -1093,13 +2239,16 @@ bool PocketDB::UpdatePostRating(std::string posttxid, int height)
 }
 
 
-void PocketDB::GetCommentRating(std::string commentid, int& up, int& down, int& rep, int height)
+bool PocketDB::GetCommentRating(std::string commentid, int& up, int& down, int& rep, int height)
 {
     // Set to default if rating for post not found
     up = 0;
     down = 0;
     rep = 0;
 
+    // History below checkpoint compacted
+    if (height < ratingCheckpoint("CommentRatings")) return false;
+
     // Sorting by block desc - last accumulating rating
     Item _itm_rating_cur;
     if (SelectOne(
@@ -1113,6 +2262,8 @@ void PocketDB::GetCommentRating(std::string commentid, int& up, int& down, int&
         down = _itm_rating_cur["scoreDown"].As<int>();
         rep = _itm_rating_cur["reputation"].As<int>();
     }
+
+    return true;
 }
 
 bool PocketDB::UpdateCommentRating(std::string commentid, int up, int down, int& rep)
@@ -1140,21 +2291,153 @@ bool PocketDB::UpdateCommentRating(std::string commentid, int height)
 }
 
 
-void PocketDB::SearchTags(std::string search, int count, std::map<std::string, int>& tags, int& totalCount)
+bool PocketDB::LoadPrefixIndex()
 {
-    if (search.size() < 3) return;
-    int _count = (count > 1000 ? 1000 : count);
+    {
+        LOCK(cs_prefix_index);
+        tag_index.Clear();
+        name_index.Clear();
+        name_keys.clear();
+
+        // Flag set before feeding - helpers skip not loaded index
+        prefix_index_loaded = true;
+    }
+
+    // Pages of blocks with indexed fields only - whole namespace not loaded in memory
+    auto load = [&](const std::string& table, const Query& fields, const std::function<void(Item&)>& feed) {
+        Item lastItm;
+        Error err = SelectOne(Query(table).Sort("block", true), lastItm);
+        if (err.code() == 13) return true;
+        if (!err.ok()) return false;
+        int lastBlock = lastItm["block"].As<int>();
+
+        for (int block = 0; block <= lastBlock; block += 10000) {
+            LOCK(cs_prefix_index);
+            QueryResults res;
+            if (!db->Select(Query(fields).Where("block", CondGe, block).Where("block", CondLt, block + 10000), res).ok()) return false;
+            for (auto& it : res) {
+                Item item = it.GetItem();
+                feed(item);
+            }
+        }
+
+        return true;
+    };
+
+    if (!load("Posts", Query("Posts").Select({"tags"}), [&](Item& item) { prefixIndexTags(item, 1); }) ||
+        !load("UsersView", Query("UsersView").Select({"address", "name", "reputation"}), [&](Item& item) { prefixIndexItem("UsersView", item); })) {
+        LOCK(cs_prefix_index);
+        prefix_index_loaded = false;
+        tag_index.Clear();
+        name_index.Clear();
+        name_keys.clear();
+        return false;
+    }
+
+    LOCK(cs_prefix_index);
+    LogPrintf("Loaded prefix index: %d tags, %d users\n", tag_index.Size(), name_index.Size());
+    return true;
+}
+
+void PocketDB::prefixIndexTags(Item& item, int delta)
+{
+    LOCK(cs_prefix_index);
+    if (!prefix_index_loaded) return;
+
+    // Tag repeated in post counted once
+    std::set<std::string> tags;
+    VariantArray va = item["tags"];
+    for (size_t i = 0; i < va.size(); ++i) {
+        std::string tag = lower(va[i].As<string>());
+        if (!tag.empty()) tags.insert(tag);
+    }
+
+    for (const auto& tag : tags) {
+        int64_t count = 0;
+        tag_index.Get(tag, count);
+        count += delta;
+
+        if (count > 0)
+            tag_index.Set(tag, count);
+        else
+            tag_index.Erase(tag);
+    }
+}
+
+void PocketDB::prefixIndexName(const std::string& address, const std::string& name, int64_t reputation)
+{
+    auto it = name_keys.find(address);
+    if (it != name_keys.end()) {
+        name_index.Erase(lower(it->second) + '\0' + address);
+        name_keys.erase(it);
+    }
+
+    if (name.empty()) return;
+
+    name_index.Set(lower(name) + '\0' + address, reputation);
+    name_keys.emplace(address, name);
+}
+
+void PocketDB::prefixIndexItem(const std::string& table, Item& item)
+{
+    if (table != "UsersView") return;
+
+    LOCK(cs_prefix_index);
+    if (!prefix_index_loaded) return;
+
+    prefixIndexName(item["address"].As<string>(), UrlDecode(item["name"].As<string>()), item["reputation"].As<int64_t>());
+}
+
+void PocketDB::prefixIndexDeleted(const std::string& table, QueryResults& res)
+{
+    if (table == "Posts") {
+        for (auto& it : res) {
+            Item item = it.GetItem();
+            prefixIndexTags(item, -1);
+        }
+    } else if (table == "UsersView") {
+        LOCK(cs_prefix_index);
+        if (!prefix_index_loaded) return;
 
-    reindexer::QueryResults res;
-    if (g_pocketdb->Select(reindexer::Query("Tags", 0, _count).Where("tag", CondEq, (search.size() > 0 ? search : "*")), res).ok()) {
-        totalCount = res.TotalCount();
         for (auto& it : res) {
-            Item _itm = it.GetItem();
-            tags.insert_or_assign(_itm["tag"].As<string>(), _itm["rating"].As<int>());
+            Item item = it.GetItem();
+            prefixIndexName(item["address"].As<string>(), "", 0);
         }
     }
 }
 
+void PocketDB::SearchTags(std::string search, int count, std::vector<std::pair<std::string, int>>& tags, int& totalCount)
+{
+    if (search.size() < 3) return;
+    int _count = (count > 1000 ? 1000 : count);
+    if (_count <= 0) return;
+
+    LOCK(cs_prefix_index);
+
+    size_t total = 0;
+    for (auto& tag : tag_index.Complete(lower(search), _count, total)) {
+        tags.emplace_back(tag.first, (int)tag.second);
+    }
+    totalCount = (int)total;
+}
+
+void PocketDB::SearchUserNames(std::string search, int count, std::vector<std::pair<std::string, std::string>>& users, int& totalCount)
+{
+    if (search.empty()) return;
+    int _count = (count > 1000 ? 1000 : count);
+    if (_count <= 0) return;
+
+    LOCK(cs_prefix_index);
+
+    size_t total = 0;
+    for (auto& user : name_index.Complete(lower(search), _count, total)) {
+        std::string address = user.first.substr(user.first.rfind('\0') + 1);
+        auto it = name_keys.find(address);
+        if (it != name_keys.end()) users.emplace_back(address, it->second);
+    }
+    totalCount = (int)total;
+}
+
 bool PocketDB::GetHashItem(Item& item, std::string table, bool with_referrer, std::string& out_hash)
 {
     std::string data = "";
@@ -1232,3 +2515,147 @@ bool PocketDB::GetHashItem(Item& item, std::string table, bool with_referrer, st
     out_hash = HexStr(vec);
     return true;
 }
+//-----------------------------------------------------
+// PocketDataCache
+//-----------------------------------------------------
+static size_t stringUsage(const std::string& str)
+{
+    // Short strings kept inside object
+    return str.capacity() > 15 ? memusage::MallocUsage(str.capacity() + 1) : 0;
+}
+
+static size_t pocketDataUsage(const PocketBlockData& data)
+{
+    size_t usage = memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, PocketTxData>>)) * data.size();
+    for (const auto& it : data) {
+        usage += stringUsage(it.second.table) + stringUsage(it.second.data);
+    }
+
+    return usage;
+}
+
+PocketDataCache::PocketDataCache(size_t maxUsageIn, int64_t expiryIn) : maxUsage(maxUsageIn), expiry(expiryIn)
+{
+}
+
+void PocketDataCache::SetLimits(size_t maxUsageIn, int64_t expiryIn)
+{
+    LOCK(cs);
+    maxUsage = maxUsageIn;
+    expiry = expiryIn;
+    limit([](const uint256&) { return false; });
+}
+
+void PocketDataCache::eraseEntry(std::map<uint256, Entry>::iterator it)
+{
+    usage -= it->second.usage;
+    lru.erase(it->second.lru);
+    entries.erase(it);
+}
+
+void PocketDataCache::limit(const std::function<bool(const uint256&)>& pinned)
+{
+    int64_t expired = GetTime() - expiry;
+
+    // From least recently used, pinned entries skipped
+    auto lit = lru.end();
+    while (lit != lru.begin()) {
+        auto it = entries.find(*std::prev(lit));
+        if (usage <= maxUsage && it->second.time >= expired) break;
+
+        if (pinned(it->first)) {
+            --lit;
+            continue;
+        }
+
+        LogPrint(BCLog::NET, "PocketNET data of block %s evicted\n", it->first.GetHex());
+        eraseEntry(it);
+        evicted += 1;
+    }
+}
+
+void PocketDataCache::Add(const uint256& blockhash, const PocketBlockData& data, const std::function<bool(const uint256&)>& pinned)
+{
+    LOCK(cs);
+
+    auto it = entries.find(blockhash);
+    if (it != entries.end()) {
+        it->second.time = GetTime();
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return;
+    }
+
+    lru.push_front(blockhash);
+
+    Entry& entry = entries[blockhash];
+    entry.data = data;
+    entry.usage = pocketDataUsage(entry.data) +
+                  memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, Entry>>)) +
+                  memusage::MallocUsage(sizeof(uint256) + 2 * sizeof(void*));
+    entry.time = GetTime();
+    entry.lru = lru.begin();
+    usage += entry.usage;
+
+    limit(pinned);
+}
+
+bool PocketDataCache::Get(const uint256& blockhash, PocketBlockData& data)
+{
+    LOCK(cs);
+
+    auto it = entries.find(blockhash);
+    if (it == entries.end()) return false;
+
+    it->second.time = GetTime();
+    lru.splice(lru.begin(), lru, it->second.lru);
+    data = it->second.data;
+    return true;
+}
+
+bool PocketDataCache::Exists(const uint256& blockhash) const
+{
+    LOCK(cs);
+    return entries.find(blockhash) != entries.end();
+}
+
+void PocketDataCache::Erase(const uint256& blockhash)
+{
+    LOCK(cs);
+
+    auto it = entries.find(blockhash);
+    if (it != entries.end()) eraseEntry(it);
+}
+
+void PocketDataCache::EraseIf(const std::function<bool(const uint256&)>& predicate)
+{
+    LOCK(cs);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto cur = it++;
+        if (predicate(cur->first)) eraseEntry(cur);
+    }
+}
+
+size_t PocketDataCache::Size() const
+{
+    LOCK(cs);
+    return entries.size();
+}
+
+size_t PocketDataCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return usage;
+}
+
+size_t PocketDataCache::MaxMemoryUsage() const
+{
+    LOCK(cs);
+    return maxUsage;
+}
+
+uint64_t PocketDataCache::Evicted() const
+{
+    LOCK(cs);
+    return evicted;
+}
@@ -11,10 +11,17 @@
 #include "tools/errors.h"
 #include "util.h"
 #include <crypto/sha256.h>
+#include <serialize.h>
 #include <uint256.h>
 #include <univalue.h>
 #include <utilstrencodings.h>
 #include "chainparams.h"
+#include "pocketdb/prefixindex.h"
+#include "sync.h"
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
 //-----------------------------------------------------
 using namespace reindexer;
 //-----------------------------------------------------
@@ -43,12 +50,196 @@ enum ContentType {
     ContentTranslate = 5,
 };
 
+//-----------------------------------------------------
+struct UTXOBatchOut {
+    std::string address;
+    std::string txid;
+    int txout;
+    int64_t time;
+    int64_t amount;
+};
+
+/*
+    All UTXO changes of one block.
+    Outs - new unspent outputs
+    Spents - <txid, txout> of outputs spent in this block
+*/
+struct UTXOBatch {
+    int height;
+    std::vector<UTXOBatchOut> outs;
+    std::vector<std::pair<std::string, int>> spents;
+
+    explicit UTXOBatch(int _height) : height(_height) {}
+};
+/*
+    PocketNET data of one transaction for relay between nodes.
+    Table - reindexer table of item (or Mempool)
+    Data - item JSON
+*/
+struct PocketTxData {
+    std::string table;
+    std::string data;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(table);
+        READWRITE(data);
+    }
+};
+
+// PocketNET data of block transactions <txid, data>
+typedef std::map<uint256, PocketTxData> PocketBlockData;
+
+// Maximum addresses in cache of users profiles
+static const size_t PROFILE_CACHE_SIZE = 10000;
+// Short/full profile with/without `about` in short form
+static const int PROFILE_FORMS = 4;
+// Maximum interned keys kept in memory
+static const size_t KEY_ID_CACHE_SIZE = 200000;
+
+/** Default for -utxoprune, depth of spent outputs moved from UTXO to archive, 0 - disabled */
+static const int DEFAULT_UTXO_PRUNE = 0;
+/** Minimum depth for -utxoprune */
+static const int MIN_UTXO_PRUNE = 100;
+// Blocks between runs of UTXO pruning
+static const int UTXO_PRUNE_INTERVAL = 100;
+// Maximum outputs moved to archive in one step
+static const size_t UTXO_PRUNE_BATCH = 50000;
+
+/** Default for -ratingcheckpoint, depth of rating history kept in full, 0 - history not compacted */
+static const int DEFAULT_RATING_CHECKPOINT = 0;
+/** Minimum depth for -ratingcheckpoint: ranking reads reputations of scores a month before posts, reorg horizon on top */
+static const int MIN_RATING_CHECKPOINT = 2 * 30 * 24 * 60;
+// Blocks between checkpoints of rating history
+static const int RATING_CHECKPOINT_INTERVAL = 1000;
+// Maximum compaction steps of one block, history of old DB is compacted by following blocks
+static const int RATING_CHECKPOINT_STEPS = 5;
 //-----------------------------------------------------
 class PocketDB {
 private:
     Reindexer* db;
 
-    int cur_version = 2;
+    int cur_version = 4;
+
+    // Block being connected: its items are hashed for RHash at write time
+    CCriticalSection cs_block_write;
+    int block_write_height = -1;
+    bool block_write_rhash = false;
+    // <table, <item key, item hash>>
+    std::map<std::string, std::map<std::string, uint256>> block_rhash_items;
+    // Hashes of last connected blocks <height, hash>
+    std::map<int, std::string> block_rhash;
+    void rhashItem(const std::string& table, Item& item);
+
+    // Balance and reputation of users for chain tip `user_cache_height`
+    // -1 - cache disabled (block connecting or rollback)
+    CCriticalSection cs_user_cache;
+    int user_cache_height = -1;
+    int user_cache_base = -1;
+    uint64_t user_cache_generation = 0;
+    std::unordered_map<std::string, int64_t> user_balance_cache;
+    std::unordered_map<std::string, int> user_reputation_cache;
+    // Changes of connecting block, applied to cache with block commit
+    bool user_cache_block = false;
+    std::map<std::string, int64_t> block_balance_changes;
+    std::map<std::string, int> block_reputation_changes;
+    void beginUserCacheBlock();
+    void commitUserCacheBlock(int height);
+    void userCacheItem(const std::string& table, Item& item);
+
+    // Users with reputation not above bad reputation limit
+    // Loaded from UsersView on first use and maintained with writes of UsersView
+    CCriticalSection cs_bad_reputation;
+    bool bad_reputation_loaded = false;
+    int64_t bad_reputation_limit = 0;
+    std::unordered_set<std::string> bad_reputation;
+    // Changed with every change of set, snapshot copied again only after change
+    uint64_t bad_reputation_version = 0;
+    uint64_t bad_reputation_snapshot_version = 0;
+    std::shared_ptr<const std::unordered_set<std::string>> bad_reputation_snapshot;
+    void badReputationItem(const std::string& table, Item& item);
+    void badReputationErase(const std::string& address);
+
+    // Profiles of users built for RPC <address, forms>
+    // Address dropped with every write of UsersView, Posts, SubscribesView, BlockingView
+    // or UserRatings that touches it. Bounded with least recently used eviction.
+    struct ProfileCacheEntry {
+        UniValue forms[PROFILE_FORMS];
+        std::list<std::string>::iterator lru;
+    };
+    CCriticalSection cs_profile_cache;
+    std::unordered_map<std::string, ProfileCacheEntry> profile_cache;
+    // Front - most recently used
+    std::list<std::string> profile_cache_lru;
+    // Changed with every drop - profiles built before are not stored
+    uint64_t profile_cache_generation = 0;
+    void profileCacheItem(const std::string& table, Item& item);
+    void profileCacheDeleted(const std::string& table, QueryResults& res);
+    void profileCacheErase(const std::string& address);
+
+    // Interned ids of addresses and txids <key, id>
+    // Ids assigned once in KeyIds and never reused, survive rollback of referencing items
+    CCriticalSection cs_key_ids;
+    int64_t key_id_next = -1;
+    std::unordered_map<std::string, int64_t> key_id_cache;
+    void keyIdCache(const std::string& key, int64_t id);
+    Error internKey(const std::string& key, int64_t& id);
+    // Fill id columns of item from string keys
+    Error internItem(const std::string& table, Item& item);
+
+    // Outputs spent deeper than utxo_prune blocks moved from UTXO to UTXOArchive
+    // Rollback below horizon returns them back
+    CCriticalSection cs_utxo_prune;
+    int utxo_prune = 0;
+    // Moved since start
+    uint64_t utxo_pruned = 0;
+    // Last run moved full batch - next blocks continue without waiting for interval
+    bool utxo_prune_pending = false;
+
+    // History of UserRatings, PostRatings and CommentRatings compacted at checkpoints:
+    // at and below checkpoint only last row of every key kept, rows above are deltas.
+    // Reads of last row at or below height stay correct for heights at or above checkpoint,
+    // reads below it fail. Checkpoint is raised before compaction of range starts.
+    // <table, checkpoint height>
+    CCriticalSection cs_rating_checkpoints;
+    bool rating_checkpoints_loaded = false;
+    std::map<std::string, int> rating_checkpoints;
+    // Checkpoints saved in RatingCheckpoints - compaction of failed step repeated from them
+    std::map<std::string, int> rating_checkpoints_saved;
+    // Depth of history kept in full, 0 disables compaction
+    int rating_checkpoint_depth = 0;
+    // Last run stopped by RATING_CHECKPOINT_STEPS - next blocks continue without waiting for interval
+    bool rating_checkpoints_pending = false;
+    void loadRatingCheckpoints();
+    // Checkpoint of table, -1 - history not compacted
+    int ratingCheckpoint(const std::string& table);
+    // Drop rows of range (fromBlock, toBlock] and below it replaced by last row of key in range
+    Error compactRatings(const std::string& table, const std::string& key, int fromBlock, int toBlock);
+
+    // Completions of tags of Posts <lower tag, count of posts> and names of UsersView
+    // <lower name \0 address, reputation>. Loaded at startup before blocks are connected,
+    // so writes do not race with load, and maintained with writes.
+    CCriticalSection cs_prefix_index;
+    bool prefix_index_loaded = false;
+    PrefixIndex tag_index;
+    PrefixIndex name_index;
+    // <address, name> of indexed users
+    std::unordered_map<std::string, std::string> name_keys;
+    void prefixIndexTags(Item& item, int delta);
+    void prefixIndexName(const std::string& address, const std::string& name, int64_t reputation);
+    void prefixIndexItem(const std::string& table, Item& item);
+    void prefixIndexDeleted(const std::string& table, QueryResults& res);
+
+    // Counters of comments, reposts and children counted from DB to item
+    void countPostCounters(Item& item);
+    void countCommentCounters(Item& item);
+    // Fill counters for all items of DB v2
+    bool BackfillCounters();
+    // Fill id columns for all items of DB v3
+    bool BackfillKeyIds();
 
     void CloseNamespaces();
     bool UpdateDB();
@@ -79,6 +270,14 @@ public:
     Error SelectAggr(Query query, QueryResults& aggRes);
     Error SelectAggr(Query query, std::string aggId, AggregationResult& aggRes);
 
+    // Start writing data of connected block. With rhash all items of block height
+    // written until EndBlockWrite are hashed for RHash. Writes are not deferred.
+    void BeginBlockWrite(int height, bool rhash = false);
+    // Store RHash of block and move user cache to it
+    void EndBlockWrite();
+    // Forget block hashes and user cache. Caller must rollback data of block.
+    void AbortBlockWrite();
+
     Error Upsert(std::string table, Item& item);
     Error UpsertWithCommit(std::string table, Item& item);
 
@@ -90,6 +289,19 @@ public:
 
     Error Update(std::string table, Item& item, bool commit = true);
 
+    // Write all UTXO changes of block with one lookup for spents
+    Error WriteUTXOBatch(const UTXOBatch& batch);
+
+    // Depth of spent outputs kept in UTXO, 0 disables pruning
+    void SetUTXOPrune(int depth);
+    // Move outputs spent deeper than prune depth to archive, runs every UTXO_PRUNE_INTERVAL blocks.
+    // One run moves at most UTXO_PRUNE_BATCH outputs, rest is moved by following blocks
+    Error PruneUTXO(int height);
+    // Return archived outputs spent above height to UTXO
+    Error RollbackUTXOArchive(int height);
+    // Items and memory of UTXO and archive
+    UniValue GetUTXOStat();
+
     // Get last item and write to UsersView
     Error UpdateUsersView(std::string address, int height);
     // Get last item and write to SubscribesView
@@ -97,6 +309,11 @@ public:
     // Get last item and write to BlockingView
     Error UpdateBlockingView(std::string address, std::string address_to, int height);
 
+    // Hash of RIDB data written in block. Restored from DB if not cached.
+    bool GetBlockRHash(int height, std::string& hash);
+    // Forget hashes of blocks above height
+    void RollbackBlockRHash(int height);
+
     // Return hash by values for compare with OP_RETURN
     bool GetHashItem(Item& item, std::string table, bool with_referrer, std::string& out_hash);
 
@@ -104,26 +321,56 @@ public:
     // User
     bool SetUserReputation(std::string address, int rep);
     bool UpdateUserReputation(std::string address, int height);
+    // Ratings below checkpoint are compacted - reads for lower height return 0, logged
     int GetUserReputation(std::string _address, int height);
+    // False if history of height compacted - reputation unavailable
+    bool GetUserReputation(const std::string& address, int height, int& rep);
     int GetUserLikersCount(int userId, int height);
     bool ExistsUserLiker(int userId, int likerId);
 
     // Post
     bool UpdatePostRating(std::string posttxid, int sum, int cnt, int& rep);
     bool UpdatePostRating(std::string posttxid, int height);
-    void GetPostRating(std::string posttxid, int& sum, int& cnt, int& rep, int height);
+    // False if history of height compacted - rating unavailable
+    bool GetPostRating(std::string posttxid, int& sum, int& cnt, int& rep, int height);
 
     // Comment
     bool UpdateCommentRating(std::string commentid, int up, int down, int& rep);
     bool UpdateCommentRating(std::string commentid, int height);
-    void GetCommentRating(std::string commentid, int& up, int& down, int& rep, int height);
+    // False if history of height compacted - rating unavailable
+    bool GetCommentRating(std::string commentid, int& up, int& down, int& rep, int height);
 
     // Returns sum of all unspent transactions for address
     int64_t GetUserBalance(std::string _address, int height);
+    // Drop cached balances and reputations - data of blocks changed not by block connect
+    void ResetUserCache();
     std::tuple<int, int> GetUserData(std::string address);
+    // Addresses of users with reputation <= limit for current chain state
+    std::shared_ptr<const std::unordered_set<std::string>> GetBadReputationUsers(int64_t limit);
 
-    // Search tags in DB
-    void SearchTags(std::string search, int count, std::map<std::string, int>& tags, int& totalCount);
+    // Cached profiles of addresses in form, returns generation for PutProfiles
+    uint64_t GetProfiles(const std::vector<std::string>& addresses, int form, std::map<std::string, UniValue>& profiles);
+    void PutProfiles(const std::map<std::string, UniValue>& profiles, int form, uint64_t generation);
+
+    // Interned id of address or txid, -1 for unknown key
+    int64_t GetKeyId(const std::string& key);
+    // Ids of known keys, unknown keys skipped
+    std::vector<int64_t> GetKeyIds(const std::vector<std::string>& keys);
+
+    // Depth of rating history kept in full, 0 disables compaction
+    void SetRatingCheckpointDepth(int depth);
+    // Compact rating history below depth, runs every RATING_CHECKPOINT_INTERVAL blocks
+    // with at most RATING_CHECKPOINT_STEPS steps. Database is written without lock of readers.
+    Error CheckpointRatings(int height);
+    // Lowest height ratings can be read at and rolled back to, -1 - history not compacted
+    int GetRatingCheckpoint();
+
+    // Fill indexes of SearchTags and SearchUserNames, called at startup before blocks are connected
+    bool LoadPrefixIndex();
+    // Tags starting with search sorted by count of posts descending
+    void SearchTags(std::string search, int count, std::vector<std::pair<std::string, int>>& tags, int& totalCount);
+    // Users with name starting with search sorted by reputation descending <address, name>
+    void SearchUserNames(std::string search, int count, std::vector<std::pair<std::string, std::string>>& users, int& totalCount);
 
     // Add new Post with move old version to history table
     Error CommitPostItem(Item& itm, int height);
@@ -133,15 +380,75 @@ public:
 
     Error CommitLastItem(std::string table, Item& itm, int height);
     Error RestoreLastItem(std::string table, std::string txid, std::string otxid, int height);
+
+    // Denormalized counters `commentsCount`, `repostCount` of Post and `childrenCount` of Comment
+    // Recounted for items touched by connected or disconnected transactions
+    Error UpdatePostCounters(std::string posttxid);
+    Error UpdateCommentCounters(std::string otxid);
 };
 //-----------------------------------------------------
 extern std::unique_ptr<PocketDB> g_pocketdb;
 
+/** Default for -maxpocketdata, maximum megabytes of received PocketNET data of not connected blocks */
+static const unsigned int DEFAULT_MAX_POCKET_DATA_SIZE = 100;
+/** Default for -pocketdataexpiry, expiration time for received PocketNET data in hours */
+static const unsigned int DEFAULT_POCKET_DATA_EXPIRY = 1;
+/** PocketNET data of side chain blocks this deep below the tip is dropped */
+static const int POCKET_DATA_FORK_DEPTH = 100;
+
+/*
+    Temp storage for PocketNET data, received by another nodes
+    with blocks and waiting for the block connect.
+    Bounded by memory usage and expiration time, least recently used
+    entries are evicted first. Entries matched by pinned predicate
+    (blocks still waiting for connect) are never expired or evicted. Thread safe.
+*/
+class PocketDataCache {
+private:
+    struct Entry {
+        PocketBlockData data;
+        size_t usage;
+        int64_t time;
+        std::list<uint256>::iterator lru;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<uint256, Entry> entries;
+    // Front - most recently used
+    std::list<uint256> lru;
+    size_t usage = 0;
+    size_t maxUsage;
+    int64_t expiry;
+    uint64_t evicted = 0;
+
+    void eraseEntry(std::map<uint256, Entry>::iterator it);
+    void limit(const std::function<bool(const uint256&)>& pinned);
+
+public:
+    PocketDataCache(size_t maxUsageIn, int64_t expiryIn);
+    // Max memory usage in bytes and expiration time in seconds
+    void SetLimits(size_t maxUsageIn, int64_t expiryIn);
+
+    // Keep data of block, existing data not replaced.
+    // Limits applied to blocks not matched by pinned
+    void Add(const uint256& blockhash, const PocketBlockData& data, const std::function<bool(const uint256&)>& pinned);
+    bool Get(const uint256& blockhash, PocketBlockData& data);
+    bool Exists(const uint256& blockhash) const;
+    void Erase(const uint256& blockhash);
+    // Erase all blocks matched by predicate - used for drop data of invalid and stale blocks
+    void EraseIf(const std::function<bool(const uint256&)>& predicate);
+
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+    size_t MaxMemoryUsage() const;
+    uint64_t Evicted() const;
+};
+
 /*
     Temp dictionary for PocketNET data, received by another nodes
     Key - block hash
-    Value - JSON string (UniValue)
+    Value - data of block transactions
 */
-extern std::map<uint256, std::string> POCKETNET_DATA;
+extern PocketDataCache POCKETNET_DATA;
 //-----------------------------------------------------
 #endif // POCKETDB_H
\ No newline at end of file
@@ -0,0 +1,248 @@
+// Copyright (c) 2018 PocketNet developers
+// Ranked prefix index of strings
+//-----------------------------------------------------
+#include "pocketdb/prefixindex.h"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+//-----------------------------------------------------
+static const int64_t NO_WEIGHT = std::numeric_limits<int64_t>::min();
+
+static size_t commonPrefix(const std::string& label, const std::string& key, size_t pos)
+{
+    size_t len = 0;
+    while (len < label.size() && pos + len < key.size() && label[len] == key[pos + len])
+        len++;
+    return len;
+}
+
+PrefixIndex::PrefixIndex()
+{
+    Clear();
+}
+
+uint32_t PrefixIndex::newNode()
+{
+    if (!free_nodes.empty()) {
+        uint32_t node = free_nodes.back();
+        free_nodes.pop_back();
+        return node;
+    }
+
+    nodes.emplace_back();
+    return (uint32_t)(nodes.size() - 1);
+}
+
+void PrefixIndex::freeNode(uint32_t node)
+{
+    nodes[node] = Node();
+    free_nodes.push_back(node);
+}
+
+size_t PrefixIndex::findChild(uint32_t node, unsigned char c) const
+{
+    const auto& children = nodes[node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), c, [&](uint32_t child, unsigned char value) {
+        return (unsigned char)nodes[child].label[0] < value;
+    });
+
+    if (it != children.end() && (unsigned char)nodes[*it].label[0] == c) return it - children.begin();
+    return children.size();
+}
+
+void PrefixIndex::addChild(uint32_t node, uint32_t child)
+{
+    unsigned char c = nodes[child].label[0];
+    auto& children = nodes[node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), c, [&](uint32_t other, unsigned char value) {
+        return (unsigned char)nodes[other].label[0] < value;
+    });
+    children.insert(it, child);
+}
+
+void PrefixIndex::recount(uint32_t node)
+{
+    Node& n = nodes[node];
+    n.best = n.terminal ? n.weight : NO_WEIGHT;
+    n.keys = n.terminal ? 1 : 0;
+    for (uint32_t child : n.children) {
+        n.best = std::max(n.best, nodes[child].best);
+        n.keys += nodes[child].keys;
+    }
+}
+
+std::vector<uint32_t> PrefixIndex::findPath(const std::string& key) const
+{
+    std::vector<uint32_t> path{0};
+    size_t pos = 0;
+    while (pos < key.size()) {
+        uint32_t cur = path.back();
+        size_t idx = findChild(cur, key[pos]);
+        if (idx == nodes[cur].children.size()) return {};
+
+        uint32_t child = nodes[cur].children[idx];
+        const std::string& label = nodes[child].label;
+        if (commonPrefix(label, key, pos) < label.size()) return {};
+
+        pos += label.size();
+        path.push_back(child);
+    }
+
+    if (!nodes[path.back()].terminal) return {};
+    return path;
+}
+
+void PrefixIndex::Set(const std::string& key, int64_t weight)
+{
+    std::vector<uint32_t> path{0};
+    size_t pos = 0;
+    while (pos < key.size()) {
+        uint32_t cur = path.back();
+        size_t idx = findChild(cur, key[pos]);
+        if (idx == nodes[cur].children.size()) {
+            uint32_t leaf = newNode();
+            nodes[leaf].label = key.substr(pos);
+            addChild(cur, leaf);
+            path.push_back(leaf);
+            break;
+        }
+
+        uint32_t child = nodes[cur].children[idx];
+        size_t common = commonPrefix(nodes[child].label, key, pos);
+        if (common < nodes[child].label.size()) {
+            // Split edge at end of common part
+            uint32_t mid = newNode();
+            nodes[mid].label = nodes[child].label.substr(0, common);
+            nodes[child].label.erase(0, common);
+            nodes[mid].children.push_back(child);
+            recount(mid);
+            nodes[cur].children[idx] = mid;
+            child = mid;
+        }
+
+        pos += common;
+        path.push_back(child);
+    }
+
+    Node& node = nodes[path.back()];
+    node.terminal = true;
+    node.weight = weight;
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        recount(*it);
+}
+
+bool PrefixIndex::Erase(const std::string& key)
+{
+    std::vector<uint32_t> path = findPath(key);
+    if (path.empty()) return false;
+
+    uint32_t node = path.back();
+    nodes[node].terminal = false;
+    nodes[node].weight = 0;
+
+    // Drop empty leaf and merge nodes left with one child into it
+    if (path.size() > 1 && nodes[node].children.empty()) {
+        uint32_t parent = path[path.size() - 2];
+        auto& children = nodes[parent].children;
+        children.erase(children.begin() + findChild(parent, nodes[node].label[0]));
+        freeNode(node);
+        path.pop_back();
+        node = parent;
+    }
+
+    if (path.size() > 1 && !nodes[node].terminal && nodes[node].children.size() == 1) {
+        uint32_t child = nodes[node].children[0];
+        nodes[node].label += nodes[child].label;
+        nodes[node].children = std::move(nodes[child].children);
+        nodes[node].terminal = nodes[child].terminal;
+        nodes[node].weight = nodes[child].weight;
+        freeNode(child);
+    }
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        recount(*it);
+
+    return true;
+}
+
+bool PrefixIndex::Get(const std::string& key, int64_t& weight) const
+{
+    std::vector<uint32_t> path = findPath(key);
+    if (path.empty()) return false;
+
+    weight = nodes[path.back()].weight;
+    return true;
+}
+
+void PrefixIndex::Clear()
+{
+    nodes.clear();
+    free_nodes.clear();
+    nodes.emplace_back();
+    recount(0);
+}
+
+size_t PrefixIndex::Size() const
+{
+    return nodes[0].keys;
+}
+
+std::vector<std::pair<std::string, int64_t>> PrefixIndex::Complete(const std::string& prefix, size_t count, size_t& total) const
+{
+    std::vector<std::pair<std::string, int64_t>> result;
+    total = 0;
+
+    // Node of subtree with all keys of prefix
+    uint32_t cur = 0;
+    std::string path;
+    size_t pos = 0;
+    while (pos < prefix.size()) {
+        size_t idx = findChild(cur, prefix[pos]);
+        if (idx == nodes[cur].children.size()) return result;
+
+        uint32_t child = nodes[cur].children[idx];
+        const std::string& label = nodes[child].label;
+        size_t common = commonPrefix(label, prefix, pos);
+        if (common < label.size() && pos + common < prefix.size()) return result;
+
+        path += label;
+        pos += common;
+        cur = child;
+    }
+
+    total = nodes[cur].keys;
+    if (total == 0 || count == 0) return result;
+
+    // Best first: key is taken when its weight is above best of all subtrees left
+    struct Candidate {
+        int64_t weight;
+        bool key;
+        uint32_t node;
+        std::string path;
+    };
+    auto cmp = [](const Candidate& a, const Candidate& b) {
+        if (a.weight != b.weight) return a.weight < b.weight;
+        return a.path > b.path;
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(cmp)> queue(cmp);
+    queue.push({nodes[cur].best, false, cur, path});
+
+    while (!queue.empty() && result.size() < count) {
+        Candidate candidate = queue.top();
+        queue.pop();
+
+        if (candidate.key) {
+            result.emplace_back(std::move(candidate.path), candidate.weight);
+            continue;
+        }
+
+        const Node& node = nodes[candidate.node];
+        if (node.terminal) queue.push({node.weight, true, candidate.node, candidate.path});
+        for (uint32_t child : node.children)
+            queue.push({nodes[child].best, false, child, candidate.path + nodes[child].label});
+    }
+
+    return result;
+}
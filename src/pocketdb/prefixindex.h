@@ -0,0 +1,61 @@
+// Copyright (c) 2018 PocketNet developers
+// Ranked prefix index of strings
+//-----------------------------------------------------
+#ifndef POCKETDB_PREFIXINDEX_H
+#define POCKETDB_PREFIXINDEX_H
+//-----------------------------------------------------
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+//-----------------------------------------------------
+/*
+	Radix tree of keys with weights.
+	Every node keeps best weight and count of keys below it, so completions of
+	prefix are taken best first without visiting all keys of prefix.
+	Not thread safe - owner locks.
+*/
+class PrefixIndex {
+private:
+    struct Node {
+        // Part of key on edge from parent
+        std::string label;
+        // Sorted by first byte of label
+        std::vector<uint32_t> children;
+        bool terminal = false;
+        int64_t weight = 0;
+        // Maximum weight of keys in subtree
+        int64_t best = 0;
+        // Count of keys in subtree
+        size_t keys = 0;
+    };
+
+    // 0 - root
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_nodes;
+
+    uint32_t newNode();
+    void freeNode(uint32_t node);
+    // Position of child starting with byte in children of node, or children.size()
+    size_t findChild(uint32_t node, unsigned char c) const;
+    void addChild(uint32_t node, uint32_t child);
+    void recount(uint32_t node);
+    // Path from root to node of key, empty if key not found
+    std::vector<uint32_t> findPath(const std::string& key) const;
+
+public:
+    PrefixIndex();
+
+    // Insert key or replace its weight
+    void Set(const std::string& key, int64_t weight);
+    // False if key not found
+    bool Erase(const std::string& key);
+    bool Get(const std::string& key, int64_t& weight) const;
+    void Clear();
+    size_t Size() const;
+
+    // Keys starting with prefix sorted by weight descending, total - count of all keys with prefix
+    std::vector<std::pair<std::string, int64_t>> Complete(const std::string& prefix, size_t count, size_t& total) const;
+};
+//-----------------------------------------------------
+#endif // POCKETDB_PREFIXINDEX_H
@@ -996,8 +996,13 @@ static UniValue getaddressinfo(const JSONRPCRequest& request) {
 	UniValue txs(UniValue::VARR);
     std::unordered_set<std::string> s_txs;
 
-	reindexer::QueryResults utxo;
-	if (g_pocketdb->Select(reindexer::Query("UTXO").Where("address", CondEq, address).Sort("time", true), utxo).ok()) {
+	// Outputs spent long ago pruned to archive - rows of both tables sorted together
+	// <time, txid>
+	std::vector<std::pair<int64_t, std::string>> outs;
+	for (const std::string table : {"UTXO", "UTXOArchive"}) {
+		reindexer::QueryResults utxo;
+		if (!g_pocketdb->Select(reindexer::Query(table).Where("address", CondEq, address), utxo).ok()) continue;
+
 		for (auto& u : utxo) {
 			reindexer::Item it = u.GetItem();
 
@@ -1005,10 +1010,16 @@ static UniValue getaddressinfo(const JSONRPCRequest& request) {
 			if (it["spent_block"].As<int>() == 0) unspent += amount;
 			else spent += amount;
 
-            std::string txid = it["txid"].As<string>();
-            if (s_txs.emplace(txid).second) {
-                txs.push_back(txid);
-            }
+			outs.emplace_back(it["time"].As<int64_t>(), it["txid"].As<string>());
+		}
+	}
+
+	std::stable_sort(outs.begin(), outs.end(), [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+		return a.first > b.first;
+	});
+	for (const auto& out : outs) {
+		if (s_txs.emplace(out.second).second) {
+			txs.push_back(out.second);
 		}
 	}
 	//-----------------------------------------
@@ -1060,7 +1071,8 @@ static UniValue txToUniValue(const CTransaction& tx, const uint256& hashBlock)
 			}
 
 			reindexer::Item utxo;
-			if (g_pocketdb->SelectOne(reindexer::Query("UTXO").Where("txid", CondEq, txin.prevout.hash.GetHex()).Where("txout", CondEq, (int)txin.prevout.n), utxo).ok()) {
+			if (g_pocketdb->SelectOne(reindexer::Query("UTXO").Where("txid", CondEq, txin.prevout.hash.GetHex()).Where("txout", CondEq, (int)txin.prevout.n), utxo).ok() ||
+				g_pocketdb->SelectOne(reindexer::Query("UTXOArchive").Where("txid", CondEq, txin.prevout.hash.GetHex()).Where("txout", CondEq, (int)txin.prevout.n), utxo).ok()) {
 				CAmount value = utxo["amount"].As<int64_t>();
 				in.pushKV("address", utxo["address"].As<string>());
 				in.pushKV("value", value);
@@ -1196,6 +1208,24 @@ static UniValue checkstringtype(const JSONRPCRequest& request) {
 }
 
 static std::map<std::string, UniValue> g_statistic_cache;
+static UniValue getutxostatistic(const JSONRPCRequest& request) {
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getutxostatistic\n"
+            "\nGet size of UTXO table and archive of pruned spent outputs.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"prune\": n,              (numeric) Depth of spent outputs kept in UTXO, 0 - pruning disabled\n"
+            "  \"pruned\": n,             (numeric) Outputs moved to archive since start\n"
+            "  \"UTXO\": {...},           (object) Items and memory size in bytes of UTXO table\n"
+            "  \"UTXOArchive\": {...},    (object) Items and memory size in bytes of archive\n"
+            "  \"reclaimed\": n           (numeric) Estimated bytes of archived outputs not kept in UTXO\n"
+            "}\n"
+        );
+
+    return g_pocketdb->GetUTXOStat();
+}
+
 static UniValue getstatistic(const JSONRPCRequest& request) {
     if (request.fHelp)
         throw std::runtime_error(
@@ -1839,6 +1869,10 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("maxmempool", (int64_t) maxmempool);
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    ret.pushKV("pocketdatasize", (int64_t) POCKETNET_DATA.Size());
+    ret.pushKV("pocketdatausage", (int64_t) POCKETNET_DATA.DynamicMemoryUsage());
+    ret.pushKV("maxpocketdata", (int64_t) POCKETNET_DATA.MaxMemoryUsage());
+    ret.pushKV("pocketdataevicted", (int64_t) POCKETNET_DATA.Evicted());
 
     return ret;
 }
@@ -1856,7 +1890,11 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
-            "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"minrelaytxfee\": xxxxx,      (numeric) Current minimum relay fee for transactions\n"
+            "  \"pocketdatasize\": xxxxx,     (numeric) Count of blocks with received PocketNET data waiting for connect\n"
+            "  \"pocketdatausage\": xxxxx,    (numeric) Total memory usage for received PocketNET data\n"
+            "  \"maxpocketdata\": xxxxx,      (numeric) Maximum memory usage for received PocketNET data\n"
+            "  \"pocketdataevicted\": xxxxx   (numeric) Count of blocks with PocketNET data evicted by size or expiration limits\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -2639,6 +2677,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
 
 	{ "blockchain",         "getaddressinfo",         &getaddressinfo,         {"address"}, false },
+	{ "blockchain",         "getutxostatistic",       &getutxostatistic,       {}, false },
 	{ "blockchain",         "gettransactions",        &gettransactions,        {"transactions"}, false },
 	{ "blockchain",         "getlastblocks",          &getlastblocks,          {"count","last_height","verbose"}, false },
 	{ "blockchain",         "checkstringtype",        &checkstringtype,        {"value"}, false },
@@ -0,0 +1,128 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/cache.h>
+
+#include <chain.h>
+#include <memusage.h>
+
+#include <set>
+
+RPCResultCache g_rpc_cache;
+
+// Public feeds and statistics - same params on same tip give same result.
+// Feeds filtered by time <= GetAdjustedTime() (gethotposts, gethistoricalstrip,
+// gethierarchicalstrip) change without new tip and are not cached
+static const std::set<std::string> CACHEABLE_METHODS = {
+    "getcontents",
+    "gettags",
+    "getcontentsstatistic",
+};
+
+static size_t stringUsage(const std::string& str)
+{
+    // Short strings kept inside object
+    return str.capacity() > 15 ? memusage::MallocUsage(str.capacity() + 1) : 0;
+}
+
+void RPCResultCache::eraseEntry(std::unordered_map<std::string, Entry>::iterator it)
+{
+    usage -= it->second.usage;
+    lru.erase(it->second.lru);
+    entries.erase(it);
+}
+
+void RPCResultCache::limit()
+{
+    while (!lru.empty() && usage > maxUsage) {
+        eraseEntry(entries.find(lru.back()));
+        evicted += 1;
+    }
+}
+
+void RPCResultCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    SetHeight(pindexNew->nHeight);
+}
+
+void RPCResultCache::SetLimit(size_t maxUsageIn)
+{
+    LOCK(cs);
+    maxUsage = maxUsageIn;
+    limit();
+}
+
+void RPCResultCache::SetHeight(int heightIn)
+{
+    LOCK(cs);
+    height = heightIn;
+    generation += 1;
+    entries.clear();
+    lru.clear();
+    usage = 0;
+}
+
+bool RPCResultCache::IsCacheable(const std::string& method)
+{
+    return CACHEABLE_METHODS.count(method) > 0;
+}
+
+std::string RPCResultCache::MakeKey(const std::string& method, const UniValue& params)
+{
+    // Explicit null params kept - methods may fail on them unlike on shorter call
+    return method + '\0' + params.write();
+}
+
+bool RPCResultCache::Get(const std::string& key, std::shared_ptr<const std::string>& result, uint64_t& generationOut)
+{
+    LOCK(cs);
+    generationOut = generation;
+
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        misses += 1;
+        return false;
+    }
+
+    hits += 1;
+    lru.splice(lru.begin(), lru, it->second.lru);
+    result = it->second.result;
+    return true;
+}
+
+void RPCResultCache::Put(const std::string& key, const std::shared_ptr<const std::string>& result, uint64_t generationIn)
+{
+    LOCK(cs);
+    if (generationIn != generation || maxUsage == 0) return;
+
+    auto it = entries.find(key);
+    if (it != entries.end()) eraseEntry(it);
+
+    lru.push_front(key);
+
+    Entry& entry = entries[key];
+    entry.result = result;
+    entry.usage = stringUsage(*result) + 2 * stringUsage(key) +
+                  memusage::MallocUsage(sizeof(std::pair<const std::string, Entry>) + sizeof(void*)) +
+                  memusage::MallocUsage(sizeof(std::string) + 2 * sizeof(void*));
+    entry.lru = lru.begin();
+    usage += entry.usage;
+
+    limit();
+}
+
+UniValue RPCResultCache::GetStat() const
+{
+    LOCK(cs);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("height", height);
+    result.pushKV("size", (uint64_t)entries.size());
+    result.pushKV("usage", (uint64_t)usage);
+    result.pushKV("maxusage", (uint64_t)maxUsage);
+    result.pushKV("hits", hits);
+    result.pushKV("misses", misses);
+    result.pushKV("evicted", evicted);
+    return result;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef POCKETCOIN_RPC_CACHE_H
+#define POCKETCOIN_RPC_CACHE_H
+
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <univalue.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/** Default for -rpccachesize, maximum megabytes of cached RPC results */
+static const unsigned int DEFAULT_RPC_CACHE_SIZE = 32;
+
+/*
+	Results of public RPC methods that depend only on params and chain tip.
+	Results are kept serialized and keyed by method and params. Whole cache
+	is dropped with every new tip, size is bounded by least recently used eviction.
+	Thread safe.
+*/
+class RPCResultCache final : public CValidationInterface
+{
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> result;
+        size_t usage;
+        std::list<std::string>::iterator lru;
+    };
+
+    mutable CCriticalSection cs;
+    std::unordered_map<std::string, Entry> entries;
+    // Front - most recently used
+    std::list<std::string> lru;
+    size_t usage = 0;
+    size_t maxUsage = 0;
+    // Changed with every tip - results of requests started before are not stored
+    uint64_t generation = 0;
+    int height = -1;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evicted = 0;
+
+    void eraseEntry(std::unordered_map<std::string, Entry>::iterator it);
+    void limit();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+public:
+    // Zero size disables cache
+    void SetLimit(size_t maxUsageIn);
+    void SetHeight(int heightIn);
+
+    static bool IsCacheable(const std::string& method);
+    // Method with exact params
+    static std::string MakeKey(const std::string& method, const UniValue& params);
+
+    // Miss returns generation for Put
+    bool Get(const std::string& key, std::shared_ptr<const std::string>& result, uint64_t& generationOut);
+    void Put(const std::string& key, const std::shared_ptr<const std::string>& result, uint64_t generationIn);
+
+    UniValue GetStat() const;
+};
+
+extern RPCResultCache g_rpc_cache;
+
+#endif // POCKETCOIN_RPC_CACHE_H
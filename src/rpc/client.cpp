@@ -221,6 +221,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"searchlinks",                    3, "count"},
 
         {"getemission",                   0, "height"},
+        {"getrpcstatistic",               0, "depth"},
     };
 // clang-format on
 
@@ -0,0 +1,250 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/hotposts.h>
+
+#include <chain.h>
+#include <pocketdb/pocketdb.h>
+
+#include <algorithm>
+
+HotPosts g_hot_posts;
+
+// Order of database query: reputation desc, scoreSum desc
+static bool rankAbove(int reputation, int scoreSum, int floorReputation, int floorScoreSum)
+{
+    return reputation > floorReputation || (reputation == floorReputation && scoreSum > floorScoreSum);
+}
+
+static bool rankBetter(const HotPost& a, const HotPost& b)
+{
+    if (a.reputation != b.reputation) return a.reputation > b.reputation;
+    if (a.scoreSum != b.scoreSum) return a.scoreSum > b.scoreSum;
+    return a.txid < b.txid;
+}
+
+static HotPost readPost(reindexer::Item& itm)
+{
+    HotPost post;
+    post.txid = itm["txid"].As<string>();
+    post.address = itm["address"].As<string>();
+    post.lang = itm["lang"].As<string>();
+    post.type = itm["type"].As<int>();
+    post.block = itm["block"].As<int>();
+    post.time = itm["time"].As<int64_t>();
+    post.reputation = itm["reputation"].As<int>();
+    post.scoreSum = itm["scoreSum"].As<int>();
+    return post;
+}
+
+void HotPosts::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    int newHeight = pindexNew->nHeight;
+    int forkHeight = pindexFork ? pindexFork->nHeight : -1;
+
+    LOCK(cs);
+    generation++;
+    if (fInitialDownload || height < 0 || forkHeight < height || newHeight <= height) {
+        clear();
+        height = fInitialDownload ? -1 : newHeight;
+        return;
+    }
+
+    if (views.empty()) {
+        height = newHeight;
+        return;
+    }
+
+    // Posts written or rated in new blocks
+    std::set<std::string> touched;
+
+    reindexer::QueryResults postsRes;
+    reindexer::QueryResults ratingsRes;
+    if (!g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("block", CondGt, height).Where("block", CondLe, newHeight), postsRes).ok() ||
+        !g_pocketdb->DB()->Select(reindexer::Query("PostRatings").Where("block", CondGt, height).Where("block", CondLe, newHeight), ratingsRes).ok()) {
+        clear();
+        height = newHeight;
+        return;
+    }
+
+    std::map<std::string, HotPost> changed;
+    for (auto& it : postsRes) {
+        reindexer::Item itm = it.GetItem();
+        HotPost post = readPost(itm);
+        touched.insert(post.txid);
+        changed[post.txid] = std::move(post);
+    }
+
+    std::vector<std::string> rated;
+    for (auto& it : ratingsRes) {
+        std::string posttxid = it.GetItem()["posttxid"].As<string>();
+        if (touched.insert(posttxid).second) rated.push_back(posttxid);
+    }
+
+    if (!rated.empty()) {
+        reindexer::QueryResults ratedRes;
+        if (!g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("txid", CondSet, rated), ratedRes).ok()) {
+            clear();
+            height = newHeight;
+            return;
+        }
+
+        for (auto& it : ratedRes) {
+            reindexer::Item itm = it.GetItem();
+            HotPost post = readPost(itm);
+            changed[post.txid] = std::move(post);
+        }
+    }
+
+    height = newHeight;
+    for (auto& view : views) {
+        updateView(view.second, changed, touched);
+    }
+}
+
+void HotPosts::clear()
+{
+    views.clear();
+    lru.clear();
+}
+
+bool HotPosts::loadView(View& view, int atHeight)
+{
+    reindexer::Query query = reindexer::Query("Posts", 0, HOT_POSTS_SIZE + 1);
+    query = query.Where("block", CondLe, atHeight);
+    query = query.Where("block", CondGt, atHeight - view.depth);
+    query = query.Where("reputation", CondGt, 0);
+    if (!view.lang.empty()) {
+        query = query.Where("lang", CondEq, view.lang);
+    }
+    if (!view.contentTypes.empty()) {
+        query = query.Where("type", CondSet, view.contentTypes);
+    }
+
+    query = query.Sort("reputation", true);
+    query = query.Sort("scoreSum", true);
+
+    reindexer::QueryResults postsRes;
+    if (!g_pocketdb->DB()->Select(query, postsRes).ok()) return false;
+
+    view.posts.clear();
+    for (auto& it : postsRes) {
+        reindexer::Item itm = it.GetItem();
+        view.posts.push_back(readPost(itm));
+    }
+
+    // Best post not loaded ranks not above last loaded
+    view.cut = view.posts.size() > HOT_POSTS_SIZE;
+    if (view.cut) {
+        view.floorReputation = view.posts.back().reputation;
+        view.floorScoreSum = view.posts.back().scoreSum;
+        view.posts.pop_back();
+    }
+
+    std::sort(view.posts.begin(), view.posts.end(), rankBetter);
+    return true;
+}
+
+void HotPosts::updateView(View& view, const std::map<std::string, HotPost>& changed, const std::set<std::string>& touched)
+{
+    int minBlock = height - view.depth;
+
+    // Drop expired and touched posts, touched are reinserted with actual rank
+    view.posts.erase(std::remove_if(view.posts.begin(), view.posts.end(), [&](const HotPost& post) {
+        return post.block <= minBlock || touched.count(post.txid) > 0;
+    }), view.posts.end());
+
+    for (const auto& it : changed) {
+        const HotPost& post = it.second;
+        if (post.block <= minBlock || post.block > height || post.reputation <= 0) continue;
+        if (!view.lang.empty() && post.lang != view.lang) continue;
+        if (!view.contentTypes.empty() && std::find(view.contentTypes.begin(), view.contentTypes.end(), post.type) == view.contentTypes.end()) continue;
+
+        // Posts not above floor may be missed among not loaded - keep them out
+        if (view.cut && !rankAbove(post.reputation, post.scoreSum, view.floorReputation, view.floorScoreSum)) continue;
+
+        view.posts.push_back(post);
+    }
+
+    std::sort(view.posts.begin(), view.posts.end(), rankBetter);
+
+    if (view.posts.size() > 2 * HOT_POSTS_SIZE) {
+        const HotPost& dropped = view.posts[HOT_POSTS_SIZE];
+        if (!view.cut || rankAbove(dropped.reputation, dropped.scoreSum, view.floorReputation, view.floorScoreSum)) {
+            view.floorReputation = dropped.reputation;
+            view.floorScoreSum = dropped.scoreSum;
+        }
+        view.cut = true;
+        view.posts.resize(HOT_POSTS_SIZE);
+    }
+}
+
+bool HotPosts::Get(int heightIn, int depth, const std::string& lang, const std::vector<int>& contentTypes, size_t count,
+    const std::unordered_set<std::string>& badReputation, int64_t time, std::vector<std::string>& txids)
+{
+    if (count == 0 || count > HOT_POSTS_SIZE || depth <= 0) return false;
+
+    std::vector<int> types = contentTypes;
+    std::sort(types.begin(), types.end());
+    types.erase(std::unique(types.begin(), types.end()), types.end());
+
+    std::string key = std::to_string(depth) + '\0' + lang + '\0';
+    for (int type : types) {
+        key += std::to_string(type) + ',';
+    }
+
+    uint64_t loadGeneration;
+    {
+        LOCK(cs);
+        if (height < 0 || heightIn != height) return false;
+        loadGeneration = generation;
+
+        auto it = views.find(key);
+        if (it != views.end()) {
+            lru.splice(lru.begin(), lru, it->second.lru);
+            if (fillView(it->second, count, badReputation, time, txids)) return true;
+        }
+    }
+
+    // New list or list shrank by updates or filters - load from database without blocking tip updates
+    View view;
+    view.depth = depth;
+    view.lang = lang;
+    view.contentTypes = types;
+    if (!loadView(view, heightIn)) return false;
+
+    LOCK(cs);
+    if (generation != loadGeneration) return false;
+
+    auto it = views.find(key);
+    if (it != views.end()) {
+        lru.erase(it->second.lru);
+        views.erase(it);
+    }
+
+    lru.push_front(key);
+    view.lru = lru.begin();
+    it = views.emplace(key, std::move(view)).first;
+
+    while (views.size() > HOT_POSTS_MAX_VIEWS) {
+        views.erase(lru.back());
+        lru.pop_back();
+    }
+
+    return fillView(it->second, count, badReputation, time, txids);
+}
+
+bool HotPosts::fillView(const View& view, size_t count, const std::unordered_set<std::string>& badReputation, int64_t time, std::vector<std::string>& txids)
+{
+    txids.clear();
+    for (const auto& post : view.posts) {
+        if (txids.size() == count) break;
+        // Order below floor is unknown
+        if (view.cut && !rankAbove(post.reputation, post.scoreSum, view.floorReputation, view.floorScoreSum)) break;
+        if (post.time > time || badReputation.count(post.address) > 0) continue;
+        txids.push_back(post.txid);
+    }
+
+    return txids.size() == count || !view.cut;
+}
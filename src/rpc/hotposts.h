@@ -0,0 +1,84 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef POCKETCOIN_RPC_HOTPOSTS_H
+#define POCKETCOIN_RPC_HOTPOSTS_H
+
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/** Posts loaded in one list of hot posts, maximum count served from memory */
+static const size_t HOT_POSTS_SIZE = 200;
+/** Maximum lists of hot posts maintained for tip */
+static const size_t HOT_POSTS_MAX_VIEWS = 64;
+
+struct HotPost {
+    std::string txid;
+    std::string address;
+    std::string lang;
+    int type;
+    int block;
+    int64_t time;
+    int reputation;
+    int scoreSum;
+};
+
+/*
+	Materialized lists of hot posts for current tip.
+	List for depth, language and content types is loaded from database on first
+	request and updated with every tip by posts rated or written in new blocks.
+	Posts missing in cut list rank not above `floor` - best post dropped with cut.
+	Reorganization drops all lists, least recently used lists are evicted.
+	Lists are loaded without lock and dropped if tip changed meanwhile.
+	Thread safe.
+*/
+class HotPosts final : public CValidationInterface
+{
+private:
+    struct View {
+        int depth;
+        std::string lang;
+        std::vector<int> contentTypes;
+        // Sorted by rank descending
+        std::vector<HotPost> posts;
+        bool cut = false;
+        int floorReputation = 0;
+        int floorScoreSum = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    mutable CCriticalSection cs;
+    int height = -1;
+    // Changed with every tip - list loaded without lock is valid only for same generation
+    uint64_t generation = 0;
+    std::map<std::string, View> views;
+    // Front - most recently used
+    std::list<std::string> lru;
+
+    void clear();
+    // Reads database only, called without lock
+    static bool loadView(View& view, int atHeight);
+    // Txids of view for request, false if cut list is short for count
+    static bool fillView(const View& view, size_t count, const std::unordered_set<std::string>& badReputation, int64_t time, std::vector<std::string>& txids);
+    void updateView(View& view, const std::map<std::string, HotPost>& changed, const std::set<std::string>& touched);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+public:
+    // Txids of top posts by reputation and score sum for tip, false if not served from memory
+    bool Get(int heightIn, int depth, const std::string& lang, const std::vector<int>& contentTypes, size_t count,
+        const std::unordered_set<std::string>& badReputation, int64_t time, std::vector<std::string>& txids);
+};
+
+extern HotPosts g_hot_posts;
+
+#endif // POCKETCOIN_RPC_HOTPOSTS_H
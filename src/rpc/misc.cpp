@@ -9,12 +9,14 @@
 #include <core_io.h>
 #include <crypto/ripemd160.h>
 #include <httpserver.h>
+#include <init.h>
 #include <key_io.h>
 #include <net.h>
 #include <netbase.h>
 #include <outputtype.h>
 #include <pos.h>
 #include <rpc/blockchain.h>
+#include <rpc/cache.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <timedata.h>
@@ -490,18 +492,18 @@ static UniValue getnodeinfo(const JSONRPCRequest& request)
     oblock.pushKV("ntx", (int)pindex->nTx);
     entry.pushKV("lastblock", oblock);
 
-    if (!WSConnections.empty()) {
+    if (!WSConnections.Empty()) {
         UniValue proxies(UniValue::VARR);
-        for (auto& it : WSConnections) {
-            if (it.second.Service) {
+        WSConnections.ForEach([&proxies](const std::string& id, WSUser& user) {
+            if (user.Service) {
                 UniValue proxy(UniValue::VOBJ);
-                proxy.pushKV("address", it.second.Address);
-                proxy.pushKV("ip", it.second.Ip);
-                proxy.pushKV("port", it.second.MainPort);
-                proxy.pushKV("portWss", it.second.WssPort);
+                proxy.pushKV("address", user.Address);
+                proxy.pushKV("ip", user.Ip);
+                proxy.pushKV("port", user.MainPort);
+                proxy.pushKV("portWss", user.WssPort);
                 proxies.push_back(proxy);
             }
-        }
+        });
         entry.pushKV("proxies", proxies);
     }
 
@@ -518,6 +520,36 @@ static UniValue getristat(const JSONRPCRequest& request)
     return ri_stat;
 }
 
+static UniValue getrpcstatistic(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getrpcstatistic ( depth )\n"
+            "\nReturns latency percentiles of RPC requests, total and for every method, usage of RPC results cache\n"
+            "and wait times of HTTP work queues by cost class (milliseconds since start).\n"
+            "\nArguments:\n"
+            "1. depth    (numeric, optional, default=-statdepth) Statistic for last depth seconds, history is kept for " + std::to_string(Statistic::STAT_WINDOWS * Statistic::STAT_WINDOW_SECONDS) + " seconds\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcstatistic", "3600") + HelpExampleRpc("getrpcstatistic", "3600"));
+
+    int64_t depth = gArgs.GetArg("-statdepth", 60);
+    if (!request.params[0].isNull()) depth = request.params[0].get_int64();
+    if (depth <= 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid depth");
+
+    auto since = gStatEngineInstance.GetCurrentSystemTime() - std::chrono::seconds(depth);
+
+    UniValue result = gStatEngineInstance.CompileStatsAsJsonSince(since);
+    result.pushKV("Methods", gStatEngineInstance.CompileMethodsStatsAsJsonSince(since));
+    result.pushKV("Cache", g_rpc_cache.GetStat());
+
+    UniValue queues(UniValue::VOBJ);
+    if (g_socket) queues.pushKV("main", g_socket->GetQueueStat());
+    if (g_pubSocket) queues.pushKV("public", g_pubSocket->GetQueueStat());
+    result.pushKV("Queues", queues);
+
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
@@ -536,6 +568,7 @@ static const CRPCCommand commands[] =
 
     { "util",               "getnodeinfo",            &getnodeinfo,            {}, false},
     { "util",               "getemission",            &getemission,            {"height"}, false},
+    { "hidden",             "getrpcstatistic",        &getrpcstatistic,        {"depth"}},
 
     /* For ReindexerDB */
     { "hidden",             "getristat",              &getristat,              {"table"}},
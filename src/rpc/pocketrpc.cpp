@@ -1,6 +1,9 @@
 // Copyright (c) 2019-2021 The Pocketcoin Core developers
 
 #include <rpc/pocketrpc.h>
+#include <rpc/hotposts.h>
+#include <rpc/ranking.h>
+#include <rpc/stream.h>
 
 #include <pos.h>
 #include <validation.h>
@@ -101,6 +104,16 @@ std::map<std::string, UniValue> getUsersProfiles(std::vector<std::string> addres
 {
     std::map<std::string, UniValue> result;
 
+    // Cached profiles, build only missed
+    int form = (shortForm ? 0 : 2) + (option == 1 ? 1 : 0);
+    uint64_t generation = g_pocketdb->GetProfiles(addresses, form, result);
+    if (!result.empty()) {
+        addresses.erase(std::remove_if(addresses.begin(), addresses.end(), [&](const std::string& address) { return result.count(address) > 0; }), addresses.end());
+    }
+    if (addresses.empty()) return result;
+
+    std::map<std::string, UniValue> built;
+
     // Get users
     reindexer::QueryResults _users_res;
     g_pocketdb->DB()->Select(reindexer::Query("UsersView").Where("address", CondSet, addresses), _users_res);
@@ -114,6 +127,14 @@ std::map<std::string, UniValue> getUsersProfiles(std::vector<std::string> addres
         }
     }
 
+    // Count of referrals by addresses
+    std::map<std::string, int> _referrals_cnt;
+    if (g_pocketdb->SelectAggr(reindexer::Query("UsersView").Where("referrer", CondSet, addresses).Aggregate("referrer", AggFacet), "referrer", aggRes).ok()) {
+        for (const auto& f : aggRes.facets) {
+            _referrals_cnt.insert_or_assign(f.value, f.count);
+        }
+    }
+
     // Build return object array
     for (auto& it : _users_res) {
         UniValue entry(UniValue::VOBJ);
@@ -134,8 +155,7 @@ std::map<std::string, UniValue> getUsersProfiles(std::vector<std::string> addres
         }
 
         // Count of referrals
-        size_t _referrals_count = g_pocketdb->SelectCount(reindexer::Query("UsersView").Where("referrer", CondEq, _address));
-        entry.pushKV("rc", (int)_referrals_count);
+        entry.pushKV("rc", _referrals_cnt.find(_address) != _referrals_cnt.end() ? _referrals_cnt[_address] : 0);
 
         if (option == 1)
             entry.pushKV("a", itm["about"].As<string>());
@@ -217,13 +237,192 @@ std::map<std::string, UniValue> getUsersProfiles(std::vector<std::string> addres
             */
         }
 
-        result.insert_or_assign(_address, entry);
+        built.insert_or_assign(_address, entry);
     }
 
+    g_pocketdb->PutProfiles(built, form, generation);
+    result.insert(built.begin(), built.end());
+
     return result;
 }
 //----------------------------------------------------------
-UniValue getPostData(reindexer::Item& itm, std::string address)
+// Donations of comments - sum of outputs of first version to addresses other than author,
+// outputs of all comments selected with one query per UTXO table
+// <otxid, author address>
+static std::map<std::string, int64_t> getCommentsDonations(const std::map<std::string, std::string>& authors)
+{
+    std::map<std::string, int64_t> donations;
+    if (authors.empty()) return donations;
+
+    std::vector<std::string> otxids;
+    for (const auto& author : authors)
+        otxids.push_back(author.first);
+
+    // Outputs selected by blocks of first versions, txid not indexed
+    std::set<int> blocksSet;
+    reindexer::QueryResults origRes;
+    if (!g_pocketdb->Select(Query("Comment").Where("txid", CondSet, otxids).Select({"block"}), origRes).ok()) return donations;
+    for (auto& it : origRes) {
+        blocksSet.insert(it.GetItem()["block"].As<int>());
+    }
+    if (blocksSet.empty()) return donations;
+    std::vector<int> blocks(blocksSet.begin(), blocksSet.end());
+
+    for (const std::string& table : {"UTXO", "UTXOArchive"}) {
+        reindexer::QueryResults outRes;
+        if (!g_pocketdb->Select(Query(table).Where("block", CondSet, blocks).Where("txid", CondSet, otxids), outRes).ok()) continue;
+
+        for (auto& it : outRes) {
+            reindexer::Item outItm = it.GetItem();
+            auto author = authors.find(outItm["txid"].As<string>());
+            if (author == authors.end() || outItm["address"].As<string>() == author->second) continue;
+
+            donations[author->first] += outItm["amount"].As<int64_t>();
+        }
+    }
+
+    return donations;
+}
+
+static void pushDonation(UniValue& oCmnt, const std::map<std::string, int64_t>& donations, const std::string& otxid)
+{
+    auto it = donations.find(otxid);
+    if (it != donations.end() && it->second > 0) {
+        oCmnt.pushKV("donation", "true");
+        oCmnt.pushKV("amount", i64tostr(it->second));
+    }
+}
+//----------------------------------------------------------
+// Facets of posts page resolved with one query per facet
+struct PostsFacets {
+    std::map<std::string, std::string> myVal;
+    std::map<std::string, UniValue> lastComment;
+    std::map<std::string, UniValue> profiles;
+};
+
+static void getPostsFacets(const std::vector<std::string>& txids, const std::vector<int>& commentsCount, const std::vector<std::string>& authors, const std::string& address, PostsFacets& facets)
+{
+    if (txids.empty()) return;
+
+    // My scores for posts
+    if (address != "") {
+        reindexer::QueryResults scoresRes;
+        if (g_pocketdb->Select(
+                reindexer::Query("Scores").Where("address_id", CondEq, g_pocketdb->GetKeyId(address)).Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(txids)),
+                scoresRes).ok()) {
+            for (auto& it : scoresRes) {
+                reindexer::Item scoreMyItm = it.GetItem();
+                facets.myVal.insert_or_assign(scoreMyItm["posttxid"].As<string>(), scoreMyItm["value"].As<string>());
+            }
+        }
+    }
+
+    // Last root comment of every commented post - keys of root comments of all posts
+    // selected with one query, newest per post loaded with second one.
+    // First versions, my scores and donations of found comments resolved in batch
+    std::vector<std::string> commentedTxids;
+    for (size_t i = 0; i < txids.size(); i++) {
+        if (commentsCount[i] > 0) commentedTxids.push_back(txids[i]);
+    }
+
+    std::vector<reindexer::Item> lastCmnts;
+    std::vector<std::string> lastOtxids;
+    std::map<std::string, std::string> lastAuthors;
+    if (!commentedTxids.empty()) {
+        // <postid, <time, txid>>
+        std::map<std::string, std::pair<int64_t, std::string>> newest;
+        reindexer::QueryResults keysRes;
+        if (g_pocketdb->Select(
+                Query("Comment")
+                    .Where("postid", CondSet, commentedTxids)
+                    .Where("parentid", CondEq, "")
+                    .Where("last", CondEq, true)
+                    .Select({"postid", "txid", "time"}),
+                keysRes).ok()) {
+            for (auto& it : keysRes) {
+                reindexer::Item keyItm = it.GetItem();
+                int64_t time = keyItm["time"].As<int64_t>();
+                auto ins = newest.emplace(keyItm["postid"].As<string>(), std::make_pair(time, keyItm["txid"].As<string>()));
+                if (!ins.second && ins.first->second.first < time) ins.first->second = {time, keyItm["txid"].As<string>()};
+            }
+        }
+
+        std::vector<std::string> lastTxids;
+        for (const auto& it : newest)
+            lastTxids.push_back(it.second.second);
+
+        reindexer::QueryResults lastRes;
+        if (!lastTxids.empty() && g_pocketdb->Select(Query("Comment").Where("txid", CondSet, lastTxids), lastRes).ok()) {
+            for (auto& it : lastRes) {
+                reindexer::Item cmntItm = it.GetItem();
+                lastOtxids.push_back(cmntItm["otxid"].As<string>());
+                lastAuthors.emplace(cmntItm["otxid"].As<string>(), cmntItm["address"].As<string>());
+                lastCmnts.push_back(std::move(cmntItm));
+            }
+        }
+    }
+
+    if (!lastCmnts.empty()) {
+        std::map<std::string, std::string> origTime;
+        reindexer::QueryResults origRes;
+        if (g_pocketdb->Select(Query("Comment").Where("txid", CondSet, lastOtxids), origRes).ok()) {
+            for (auto& it : origRes) {
+                reindexer::Item origItm = it.GetItem();
+                origTime.emplace(origItm["txid"].As<string>(), origItm["time"].As<string>());
+            }
+        }
+
+        std::map<std::string, int> myScores;
+        if (address != "") {
+            reindexer::QueryResults myScoresRes;
+            if (g_pocketdb->Select(Query("CommentScores").Where("address", CondEq, address).Where("commentid", CondSet, lastOtxids), myScoresRes).ok()) {
+                for (auto& it : myScoresRes) {
+                    reindexer::Item scoreItm = it.GetItem();
+                    myScores.emplace(scoreItm["commentid"].As<string>(), scoreItm["value"].As<int>());
+                }
+            }
+        }
+
+        std::map<std::string, int64_t> donations = getCommentsDonations(lastAuthors);
+
+        for (auto& cmntItm : lastCmnts) {
+            std::string otxid = cmntItm["otxid"].As<string>();
+
+            // Comment without first version skipped as with inner join
+            auto origIt = origTime.find(otxid);
+            if (origIt == origTime.end()) continue;
+
+            auto scoreIt = myScores.find(otxid);
+            int myScore = scoreIt != myScores.end() ? scoreIt->second : 0;
+
+            UniValue oCmnt(UniValue::VOBJ);
+            oCmnt.pushKV("id", otxid);
+            oCmnt.pushKV("postid", cmntItm["postid"].As<string>());
+            oCmnt.pushKV("address", cmntItm["address"].As<string>());
+            oCmnt.pushKV("time", origIt->second);
+            oCmnt.pushKV("timeUpd", cmntItm["time"].As<string>());
+            oCmnt.pushKV("block", cmntItm["block"].As<string>());
+            oCmnt.pushKV("msg", cmntItm["msg"].As<string>());
+            oCmnt.pushKV("parentid", cmntItm["parentid"].As<string>());
+            oCmnt.pushKV("answerid", cmntItm["answerid"].As<string>());
+            oCmnt.pushKV("scoreUp", cmntItm["scoreUp"].As<string>());
+            oCmnt.pushKV("scoreDown", cmntItm["scoreDown"].As<string>());
+            oCmnt.pushKV("reputation", cmntItm["reputation"].As<string>());
+            oCmnt.pushKV("edit", otxid != cmntItm["txid"].As<string>());
+            oCmnt.pushKV("deleted", cmntItm["msg"].As<string>() == "");
+            oCmnt.pushKV("myScore", myScore);
+            oCmnt.pushKV("children", cmntItm["childrenCount"].As<string>());
+            pushDonation(oCmnt, donations, otxid);
+
+            facets.lastComment.insert_or_assign(cmntItm["postid"].As<string>(), oCmnt);
+        }
+    }
+
+    // Authors profiles
+    facets.profiles = getUsersProfiles(authors, true);
+}
+
+static UniValue getPostData(reindexer::Item& itm, std::string address, PostsFacets& facets)
 {
     UniValue entry(UniValue::VOBJ);
 
@@ -265,77 +464,58 @@ UniValue getPostData(reindexer::Item& itm, std::string address)
     ss.read(itm["settings"].As<string>());
     entry.pushKV("s", ss);
 
-    if (address != "") {
-        reindexer::Item scoreMyItm;
-        reindexer::Error errS = g_pocketdb->SelectOne(
-            reindexer::Query("Scores").Where("address", CondEq, address).Where("posttxid", CondEq, itm["txid"].As<string>()),
-            scoreMyItm);
+    std::string txid = itm["txid"].As<string>();
 
-        entry.pushKV("myVal", errS.ok() ? scoreMyItm["value"].As<string>() : "0");
+    if (address != "") {
+        entry.pushKV("myVal", facets.myVal.find(txid) != facets.myVal.end() ? facets.myVal[txid] : "0");
     }
 
-    int totalComments = g_pocketdb->SelectCount(Query("Comment").Where("postid", CondEq, itm["txid"].As<string>()).Where("last", CondEq, true));
+    int totalComments = itm["commentsCount"].As<int>();
     entry.pushKV("comments", totalComments);
 
-    reindexer::QueryResults cmntRes;
-    g_pocketdb->Select(
-        Query("Comment", 0, 1)
-            .Where("postid", CondEq, itm["txid"].As<string>())
-            .Where("parentid", CondEq, "")
-            .Where("last", CondEq, true)
-            .Sort("time", true)
-            .InnerJoin("otxid", "txid", CondEq, Query("Comment").Limit(1))
-            .LeftJoin("otxid", "commentid", CondEq, Query("CommentScores").Where("address", CondSet, address).Limit(1)),
-        cmntRes);
-
-    if (totalComments > 0 && cmntRes.Count() > 0) {
-        UniValue oCmnt(UniValue::VOBJ);
+    if (totalComments > 0 && facets.lastComment.find(txid) != facets.lastComment.end()) {
+        entry.pushKV("lastComment", facets.lastComment[txid]);
+    }
 
-        reindexer::Item cmntItm = cmntRes[0].GetItem();
-        reindexer::Item ocmntItm = cmntRes[0].GetJoined()[0][0].GetItem();
+    int totalReposted = itm["repostCount"].As<int>();
+    if (totalReposted > 0)
+        entry.pushKV("reposted", totalReposted);
 
-        int myScore = 0;
-        if (cmntRes[0].GetJoined().size() > 1 && cmntRes[0].GetJoined()[1].Count() > 0) {
-           reindexer::Item ocmntScoreItm = cmntRes[0].GetJoined()[1][0].GetItem();
-           myScore = ocmntScoreItm["value"].As<int>();
-        }
+    std::string author = itm["address"].As<string>();
+    if (facets.profiles.find(author) != facets.profiles.end())
+        entry.pushKV("userprofile", facets.profiles[author]);
 
-        oCmnt.pushKV("id", cmntItm["otxid"].As<string>());
-        oCmnt.pushKV("postid", cmntItm["postid"].As<string>());
-        oCmnt.pushKV("address", cmntItm["address"].As<string>());
-        oCmnt.pushKV("time", ocmntItm["time"].As<string>());
-        oCmnt.pushKV("timeUpd", cmntItm["time"].As<string>());
-        oCmnt.pushKV("block", cmntItm["block"].As<string>());
-        oCmnt.pushKV("msg", cmntItm["msg"].As<string>());
-        oCmnt.pushKV("parentid", cmntItm["parentid"].As<string>());
-        oCmnt.pushKV("answerid", cmntItm["answerid"].As<string>());
-        oCmnt.pushKV("scoreUp", cmntItm["scoreUp"].As<string>());
-        oCmnt.pushKV("scoreDown", cmntItm["scoreDown"].As<string>());
-        oCmnt.pushKV("reputation", cmntItm["reputation"].As<string>());
-        oCmnt.pushKV("edit", cmntItm["otxid"].As<string>() != cmntItm["txid"].As<string>());
-        oCmnt.pushKV("deleted", cmntItm["msg"].As<string>() == "");
-        oCmnt.pushKV("myScore", myScore);
-        oCmnt.pushKV("children", std::to_string(g_pocketdb->SelectCount(Query("Comment").Where("parentid", CondEq, cmntItm["otxid"].As<string>()).Where("last", CondEq, true))));
+    return entry;
+}
 
-        int64_t donation = getdonationamount(cmntItm["otxid"].As<string>());
-        if (donation > 0) {
-            oCmnt.pushKV("donation", "true");
-            oCmnt.pushKV("amount", i64tostr(donation));
-        }
+UniValue getPostData(reindexer::Item& itm, std::string address)
+{
+    PostsFacets facets;
+    getPostsFacets({itm["txid"].As<string>()}, {itm["commentsCount"].As<int>()}, {itm["address"].As<string>()}, address, facets);
+    return getPostData(itm, address, facets);
+}
 
-        entry.pushKV("lastComment", oCmnt);
+// Data for page of posts - facets of all posts selected together
+UniValue getPostsData(std::vector<reindexer::Item>& items, std::string address)
+{
+    std::vector<std::string> txids;
+    std::vector<int> commentsCount;
+    std::vector<std::string> authors;
+    for (auto& itm : items) {
+        txids.push_back(itm["txid"].As<string>());
+        commentsCount.push_back(itm["commentsCount"].As<int>());
+        authors.push_back(itm["address"].As<string>());
     }
 
-    int totalReposted = g_pocketdb->SelectCount(Query("Posts").Where("txidRepost", CondEq, itm["txid"].As<string>()));
-    if (totalReposted > 0)
-        entry.pushKV("reposted", totalReposted);
-
-    std::map<std::string, UniValue> profile = getUsersProfiles(std::vector<std::string>{itm["address"].As<string>()}, true);
-    if (profile.size() > 0)
-        entry.pushKV("userprofile", profile.begin()->second);
+    PostsFacets facets;
+    getPostsFacets(txids, commentsCount, authors, address, facets);
 
+    UniValue result(UniValue::VARR);
+    for (auto& itm : items) {
+        result.push_back(getPostData(itm, address, facets));
+    }
 
-    return entry;
+    return result;
 }
 //----------------------------------------------------------
 void getFastSearchString(std::string search, std::string str, std::map<std::string, int>& mFastSearch)
@@ -883,15 +1063,9 @@ UniValue getrawtransactionwithmessage(const JSONRPCRequest& request)
     }
 
     // Do not show posts from users with reputation < Limit::bad_reputation
+    std::shared_ptr<const std::unordered_set<std::string>> badReputation;
     if (address_to == "") {
-        int64_t _bad_reputation_limit = GetActualLimit(Limit::bad_reputation, chainActive.Height());
-        reindexer::QueryResults queryResBadReputation;
-        err = g_pocketdb->DB()->Select(reindexer::Query("UsersView").Where("reputation", CondLe, _bad_reputation_limit), queryResBadReputation);
-
-        for (auto it : queryResBadReputation) {
-            reindexer::Item itm(it.GetItem());
-            addrsblock.push_back(itm["address"].As<string>());
-        }
+        badReputation = g_pocketdb->GetBadReputationUsers(GetActualLimit(Limit::bad_reputation, chainActive.Height()));
     }
 
     vector<string> addrs;
@@ -949,24 +1123,32 @@ UniValue getrawtransactionwithmessage(const JSONRPCRequest& request)
     }
     err = g_pocketdb->DB()->Select(query, queryRes);
 
+    std::vector<reindexer::Item> items;
     int iQuery = 0;
     reindexer::QueryResults::Iterator it = queryRes.begin();
     while (resultCount > 0 && it != queryRes.end()) {
         reindexer::Item itm(it.GetItem());
 
+        if (badReputation && badReputation->count(itm["address"].As<string>()) > 0) {
+            iQuery += 1;
+            it = queryRes[iQuery];
+            continue;
+        }
+
         reindexer::QueryResults queryResComp;
         err = g_pocketdb->DB()->Select(reindexer::Query("Complains").Where("posttxid", CondEq, itm["txid"].As<string>()), queryResComp);
         reindexer::QueryResults queryResUpv;
-        err = g_pocketdb->DB()->Select(reindexer::Query("Scores").Where("posttxid", CondEq, itm["txid"].As<string>()).Where("value", CondGt, 3), queryResUpv);
+        err = g_pocketdb->DB()->Select(reindexer::Query("Scores").Where("posttxid_id", CondEq, g_pocketdb->GetKeyId(itm["txid"].As<string>())).Where("value", CondGt, 3), queryResUpv);
 
         if (queryResComp.Count() <= 7 || queryResComp.Count() / (queryResUpv.Count() == 0 ? 1 : queryResUpv.Count() == 0 ? 1 : queryResUpv.Count()) <= 0.1) {
-            a.push_back(getPostData(itm, address_from));
+            items.push_back(std::move(itm));
             resultCount -= 1;
         }
         iQuery += 1;
         it = queryRes[iQuery];
     }
 
+    a = getPostsData(items, address_from);
     return a;
 }
 UniValue getrawtransactionwithmessage2(const JSONRPCRequest& request) { return getrawtransactionwithmessage(request); }
@@ -1009,10 +1191,12 @@ UniValue getrawtransactionwithmessagebyid(const JSONRPCRequest& request)
         reindexer::Query("Posts").Where("txid", CondSet, TxIds).Sort("time", true),
         queryRes);
 
+    std::vector<reindexer::Item> items;
     for (auto it : queryRes) {
-        reindexer::Item itm(it.GetItem());
-        a.push_back(getPostData(itm, address));
+        items.push_back(it.GetItem());
     }
+
+    a = getPostsData(items, address);
     return a;
 }
 UniValue getrawtransactionwithmessagebyid2(const JSONRPCRequest& request) { return getrawtransactionwithmessagebyid(request); }
@@ -1089,7 +1273,8 @@ UniValue getmissedinfo(const JSONRPCRequest& request)
         cntResult = request.params[2].isNum() ? request.params[2].get_int() : std::stoi(request.params[2].get_str());
     }
 
-    UniValue a(UniValue::VARR);
+    // Elements streamed to client
+    RPCArrayResult a(request);
 
     reindexer::QueryResults posts;
     g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("block", CondGt, blockNumber), posts);
@@ -1200,8 +1385,18 @@ UniValue getmissedinfo(const JSONRPCRequest& request)
         }
     }
 
+    // Scores are filtered by interned ids of posts - join by string posttxid is not indexed
+    std::vector<std::string> addressPosts;
+    reindexer::QueryResults addressPostsRes;
+    g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("address", CondEq, address), addressPostsRes);
+    for (auto it : addressPostsRes) {
+        reindexer::Item itm(it.GetItem());
+        addressPosts.push_back(itm["txid"].As<string>());
+    }
+
     reindexer::QueryResults scores;
-    g_pocketdb->DB()->Select(reindexer::Query("Scores").Where("block", CondGt, blockNumber).InnerJoin("posttxid", "txid", CondEq, reindexer::Query("Posts").Where("address", CondEq, address)).Sort("time", true).Limit(cntResult), scores);
+    if (!addressPosts.empty())
+        g_pocketdb->DB()->Select(reindexer::Query("Scores").Where("block", CondGt, blockNumber).Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(addressPosts)).Sort("time", true).Limit(cntResult), scores);
     for (auto it : scores) {
         reindexer::Item itm(it.GetItem());
         UniValue msg(UniValue::VOBJ);
@@ -1369,7 +1564,7 @@ UniValue getmissedinfo(const JSONRPCRequest& request)
     reindexer::QueryResults likedPosts;
     g_pocketdb->DB()->Select(reindexer::Query("Post"), likedPosts);
 
-    return a;
+    return a.get();
 }
 UniValue getmissedinfo2(const JSONRPCRequest& request) { return getmissedinfo(request); }
 //----------------------------------------------------------
@@ -1488,7 +1683,8 @@ UniValue txunspent(const JSONRPCRequest& request)
     }
     // TODO: check txindex and sync
 
-    UniValue results(UniValue::VARR);
+    // Elements streamed to client
+    RPCArrayResult results(request);
 
     // Get transaction ids from UTXO index
     std::vector<AddressUnspentTransactionItem> unspentTransactions;
@@ -1558,7 +1754,7 @@ UniValue txunspent(const JSONRPCRequest& request)
         results.push_back(entry);
     }
 
-    return results;
+    return results.get();
 }
 //----------------------------------------------------------
 UniValue getaddressregistration(const JSONRPCRequest& request)
@@ -1777,7 +1973,7 @@ UniValue searchtags(const JSONRPCRequest& request)
     if (request.fHelp || request.params.size() < 1) {
         throw std::runtime_error(
             "searchtags search_string count\n"
-            "\nReturns array of found tags.\n"
+            "\nReturns tags starting with search string, most used first.\n"
             "\nArguments:\n"
             "1. search_string      (string) Symbols for search (minimum 3 symbols)\n"
             "2. count              (int) Max count results\n"
@@ -1799,7 +1995,7 @@ UniValue searchtags(const JSONRPCRequest& request)
     }
 
     int totalCount = 0;
-    std::map<std::string, int> foundTags;
+    std::vector<std::pair<std::string, int>> foundTags;
     g_pocketdb->SearchTags(search_string, count, foundTags, totalCount);
 
     UniValue a(UniValue::VOBJ);
@@ -1896,12 +2092,45 @@ UniValue search(const JSONRPCRequest& request)
     std::map<std::string, std::set<std::string>> mTagsUsers;
     std::map<std::string, int> mFastSearch;
 
-    if(type == "tags"){
+    if (type == "tags" && !search_string.empty()) {
+        std::vector<std::pair<std::string, int>> tagsRatings;
+        g_pocketdb->SearchTags(search_string.at(0) == '#' ? search_string.substr(1) : search_string, resultStart + resulCount, tagsRatings, totalCount);
+
+        UniValue aTags(UniValue::VARR);
+        for (size_t i = resultStart; i < tagsRatings.size(); i++) {
+            UniValue oTag(UniValue::VOBJ);
+            oTag.pushKV("tag", tagsRatings[i].first);
+            oTag.pushKV("count", tagsRatings[i].second);
+            aTags.push_back(oTag);
+        }
 
+        UniValue oTags(UniValue::VOBJ);
+        oTags.pushKV("count", totalCount);
+        oTags.pushKV("data", aTags);
+        result.pushKV("tags", oTags);
+    }
+
+    // --- Completions of tags and user names from prefix index - tails after search string
+    std::vector<std::string> vIndexedSearch;
+    if (fs && !search_string.empty()) {
+        int indexedTotal = 0;
+        if (search_string.at(0) == '#') {
+            std::vector<std::pair<std::string, int>> tagsRatings;
+            g_pocketdb->SearchTags(search_string.substr(1), fsresultCount, tagsRatings, indexedTotal);
+            for (const auto& t : tagsRatings) {
+                if (t.first.size() + 1 > search_string.size()) vIndexedSearch.push_back(t.first.substr(search_string.size() - 1));
+            }
+        } else {
+            std::vector<std::pair<std::string, std::string>> users;
+            g_pocketdb->SearchUserNames(search_string, fsresultCount, users, indexedTotal);
+            for (const auto& u : users) {
+                if (u.second.size() > search_string.size()) vIndexedSearch.push_back(u.second.substr(search_string.size()));
+            }
+        }
     }
 
     // --- Search posts by Search String -----------------------------------------------
-    if (fs || all || type == "posts") {
+    if ((fs && (int)vIndexedSearch.size() < fsresultCount) || all || type == "posts") {
         //LogPrintf("--- Search: %s\n", fulltext_search_string);
         reindexer::QueryResults resPostsBySearchString;
         if (g_pocketdb->Select(
@@ -1913,7 +2142,7 @@ UniValue search(const JSONRPCRequest& request)
                 .ReqTotal(),
                 resPostsBySearchString)
                 .ok()) {
-            UniValue aPosts(UniValue::VARR);
+            std::vector<Item> postItems;
 
             for (auto& it : resPostsBySearchString) {
                 Item _itm = it.GetItem();
@@ -1924,9 +2153,11 @@ UniValue search(const JSONRPCRequest& request)
                 if (fs) getFastSearchString(search_string, _caption, mFastSearch);
                 if (fs) getFastSearchString(search_string, _message, mFastSearch);
 
-                if (all || type == "posts") aPosts.push_back(getPostData(_itm, ""));
+                if (all || type == "posts") postItems.push_back(std::move(_itm));
             }
 
+            UniValue aPosts = getPostsData(postItems, "");
+
             if (all || type == "posts") {
                 UniValue oPosts(UniValue::VOBJ);
                 oPosts.pushKV("count", resPostsBySearchString.totalCount);
@@ -1948,15 +2179,13 @@ UniValue search(const JSONRPCRequest& request)
                 .ReqTotal(),
                 resVideoLinksBySearchString)
                 .ok()) {
-            UniValue aPosts(UniValue::VARR);
-
+            std::vector<Item> postItems;
             for (auto& it : resVideoLinksBySearchString) {
-                Item _itm = it.GetItem();
-                std::string _txid = _itm["txid"].As<string>();
-
-                aPosts.push_back(getPostData(_itm, ""));
+                postItems.push_back(it.GetItem());
             }
 
+            UniValue aPosts = getPostsData(postItems, "");
+
             UniValue oPosts(UniValue::VOBJ);
             oPosts.pushKV("count", resVideoLinksBySearchString.totalCount);
             oPosts.pushKV("data", aPosts);
@@ -2020,10 +2249,18 @@ UniValue search(const JSONRPCRequest& request)
 
         std::sort(vFastSearch.begin(), vFastSearch.end(), IntCmp());
         int _count = fsresultCount;
+        std::set<std::string> added;
+        for (auto& t : vIndexedSearch) {
+            if (_count <= 0) break;
+            if (!added.insert(t).second) continue;
+            fastsearch.push_back(t);
+            _count -= 1;
+        }
         for (auto& t : vFastSearch) {
+            if (_count <= 0) break;
+            if (!added.insert(t.first).second) continue;
             fastsearch.push_back(t.first);
             _count -= 1;
-            if (_count <= 0) break;
         }
         result.pushKV("fastsearch", fastsearch);
     }
@@ -2112,15 +2349,33 @@ UniValue gethotposts(const JSONRPCRequest& request)
     vector<string> addrsblock;
 
     // Do not show posts from users with reputation < Limit::bad_reputation
-    int64_t _bad_reputation_limit = GetActualLimit(Limit::bad_reputation, chainActive.Height());
-    reindexer::QueryResults queryResBadReputation;
-    g_pocketdb->DB()->Select(reindexer::Query("UsersView").Where("reputation", CondLe, _bad_reputation_limit), queryResBadReputation);
+    // Filter stays in query - result is limited by count
+    auto badReputation = g_pocketdb->GetBadReputationUsers(GetActualLimit(Limit::bad_reputation, chainActive.Height()));
+
+    // Top of tip served from materialized lists
+    std::vector<std::string> hotTxids;
+    if (count > 0 && g_hot_posts.Get(nHeightOffset, depthBlocks, lang, contentTypes, (size_t)count, *badReputation, GetAdjustedTime(), hotTxids)) {
+        reindexer::QueryResults hotRes;
+        g_pocketdb->Select(reindexer::Query("Posts").Where("txid", CondSet, hotTxids), hotRes);
+
+        std::map<std::string, reindexer::Item> hotItems;
+        for (auto& p : hotRes) {
+            reindexer::Item postItm = p.GetItem();
+            std::string txid = postItm["txid"].As<string>();
+            hotItems.emplace(txid, std::move(postItm));
+        }
 
-    for (auto it : queryResBadReputation) {
-        reindexer::Item itm(it.GetItem());
-        addrsblock.push_back(itm["address"].As<string>());
+        std::vector<reindexer::Item> postItems;
+        for (const auto& txid : hotTxids) {
+            auto it = hotItems.find(txid);
+            if (it != hotItems.end()) postItems.push_back(std::move(it->second));
+        }
+
+        return getPostsData(postItems, "");
     }
 
+    addrsblock.assign(badReputation->begin(), badReputation->end());
+
     reindexer::QueryResults postsRes;
     reindexer::Query query;
 
@@ -2141,16 +2396,16 @@ UniValue gethotposts(const JSONRPCRequest& request)
 
     g_pocketdb->Select(query, postsRes);
 
-    UniValue result(UniValue::VARR);
+    std::vector<reindexer::Item> postItems;
     for (auto& p : postsRes) {
         reindexer::Item postItm = p.GetItem();
 
         if (postItm["reputation"].As<int>() > 0) {
-            result.push_back(getPostData(postItm, ""));
+            postItems.push_back(std::move(postItm));
         }
     }
 
-    return result;
+    return getPostsData(postItems, "");
 }
 UniValue gethotposts2(const JSONRPCRequest& request) { return gethotposts(request); }
 //----------------------------------------------------------
@@ -2386,6 +2641,13 @@ UniValue getcomments(const JSONRPCRequest& request)
                 .LeftJoin("otxid", "commentid", CondEq, Query("CommentScores").Where("address", CondEq, address).Limit(1)),
             commRes);
 
+    std::map<std::string, std::string> authors;
+    for (auto& it : commRes) {
+        reindexer::Item cmntItm = it.GetItem();
+        authors.emplace(cmntItm["otxid"].As<string>(), cmntItm["address"].As<string>());
+    }
+    std::map<std::string, int64_t> donations = getCommentsDonations(authors);
+
     UniValue aResult(UniValue::VARR);
     for (auto& it : commRes) {
         reindexer::Item cmntItm = it.GetItem();
@@ -2413,13 +2675,8 @@ UniValue getcomments(const JSONRPCRequest& request)
         oCmnt.pushKV("edit", cmntItm["otxid"].As<string>() != cmntItm["txid"].As<string>());
         oCmnt.pushKV("deleted", cmntItm["msg"].As<string>() == "");
         oCmnt.pushKV("myScore", myScore);
-        oCmnt.pushKV("children", std::to_string(g_pocketdb->SelectCount(Query("Comment").Where("parentid", CondEq, cmntItm["otxid"].As<string>()).Where("last", CondEq, true))));
-
-        int64_t donation = getdonationamount(cmntItm["otxid"].As<string>());
-        if (donation > 0) {
-            oCmnt.pushKV("donation", "true");
-            oCmnt.pushKV("amount", i64tostr(donation));
-        }
+        oCmnt.pushKV("children", cmntItm["childrenCount"].As<string>());
+        pushDonation(oCmnt, donations, cmntItm["otxid"].As<string>());
 
         aResult.push_back(oCmnt);
     }
@@ -2466,7 +2723,9 @@ UniValue getlastcomments(const JSONRPCRequest& request)
 
     g_pocketdb->Select(query, queryResults);
 
-    UniValue aResult(UniValue::VARR);
+    // Donations of selected comments resolved in batch
+    std::vector<UniValue> cmnts;
+    std::map<std::string, std::string> authors;
     for (auto& it : queryResults) {
         reindexer::Item cmntItm = it.GetItem();
 
@@ -2489,19 +2748,22 @@ UniValue getlastcomments(const JSONRPCRequest& request)
             oCmnt.pushKV("edit", cmntItm["otxid"].As<string>() != cmntItm["txid"].As<string>());
             oCmnt.pushKV("deleted", cmntItm["msg"].As<string>() == "");
 
-            int64_t donation = getdonationamount(cmntItm["otxid"].As<string>());
-            if (donation > 0) {
-                oCmnt.pushKV("donation", "true");
-                oCmnt.pushKV("amount", i64tostr(donation));
-            }
-
-            aResult.push_back(oCmnt);
+            authors.emplace(cmntItm["otxid"].As<string>(), cmntItm["address"].As<string>());
+            cmnts.push_back(oCmnt);
         }
-        if (aResult.size() >= resultCount) {
+        if (cmnts.size() >= resultCount) {
             break;
         }
     }
 
+    std::map<std::string, int64_t> donations = getCommentsDonations(authors);
+
+    UniValue aResult(UniValue::VARR);
+    for (auto& oCmnt : cmnts) {
+        pushDonation(oCmnt, donations, oCmnt["id"].get_str());
+        aResult.push_back(oCmnt);
+    }
+
     return aResult;
 }
 //----------------------------------------------------------
@@ -2542,15 +2804,16 @@ UniValue getaddressscores(const JSONRPCRequest& request)
     reindexer::QueryResults queryRes;
     if (TxIds.empty()) {
         g_pocketdb->DB()->Select(
-            reindexer::Query("Scores").Where("address", CondEq, address).InnerJoin("address", "address", CondEq, Query("UsersView").Where("address", CondEq, address)).Sort("time", true),
+            reindexer::Query("Scores").Where("address_id", CondEq, g_pocketdb->GetKeyId(address)).InnerJoin("address", "address", CondEq, Query("UsersView").Where("address", CondEq, address)).Sort("time", true),
             queryRes);
     } else {
         g_pocketdb->DB()->Select(
-            reindexer::Query("Scores").Where("address", CondEq, address).Where("posttxid", CondSet, TxIds).InnerJoin("address", "address", CondEq, Query("UsersView").Where("address", CondEq, address)).Sort("time", true),
+            reindexer::Query("Scores").Where("address_id", CondEq, g_pocketdb->GetKeyId(address)).Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(TxIds)).InnerJoin("address", "address", CondEq, Query("UsersView").Where("address", CondEq, address)).Sort("time", true),
             queryRes);
     }
 
-    UniValue result(UniValue::VARR);
+    // Elements streamed to client
+    RPCArrayResult result(request);
     for (auto it : queryRes) {
         reindexer::Item itm(it.GetItem());
         reindexer::Item itmj(it.GetJoined()[0][0].GetItem());
@@ -2564,7 +2827,7 @@ UniValue getaddressscores(const JSONRPCRequest& request)
         postscore.pushKV("value", itm["value"].As<string>());
         result.push_back(postscore);
     }
-    return result;
+    return result.get();
 }
 //----------------------------------------------------------
 UniValue getpostscores(const JSONRPCRequest& request)
@@ -2605,7 +2868,7 @@ UniValue getpostscores(const JSONRPCRequest& request)
 
     reindexer::QueryResults queryRes1;
     g_pocketdb->DB()->Select(
-        reindexer::Query("Scores").Where("posttxid", CondSet, TxIds)
+        reindexer::Query("Scores").Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(TxIds))
             .InnerJoin("address", "address_to", CondEq, Query("SubscribesView").Where("address", CondEq, address))
             .InnerJoin("address", "address", CondEq, Query("UsersView").Where("address", CondEq, address))
         //.Sort("txid", true).Sort("private", true).Sort("reputation", true)
@@ -2632,7 +2895,7 @@ UniValue getpostscores(const JSONRPCRequest& request)
 
     reindexer::QueryResults queryRes2;
     g_pocketdb->DB()->Select(
-        reindexer::Query("Scores").Where("posttxid", CondSet, TxIds).Not().Where("address", CondSet, subscribeadrs).InnerJoin("address", "address", CondEq, Query("UsersView").Not().Where("address", CondSet, subscribeadrs))
+        reindexer::Query("Scores").Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(TxIds)).Not().Where("address_id", CondSet, g_pocketdb->GetKeyIds(subscribeadrs)).InnerJoin("address", "address", CondEq, Query("UsersView").Not().Where("address", CondSet, subscribeadrs))
         //.Sort("txid", true).Sort("reputation", true)
         ,
         queryRes2);
@@ -2707,18 +2970,25 @@ UniValue getpagescores(const JSONRPCRequest& request)
 
 /*
     reindexer::QueryResults queryRes;
+    g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("txid", CondSet, TxIds), queryRes);
+
+    std::map<std::string, std::string> myScores;
+    reindexer::QueryResults queryResMy;
     g_pocketdb->DB()->Select(
-        reindexer::Query("Posts").Where("txid", CondSet, TxIds).LeftJoin("txid", "posttxid", CondEq, Query("Scores").Where("address", CondEq, address).Where("value", CondGt, 3)), queryRes);
+        reindexer::Query("Scores").Where("address_id", CondEq, g_pocketdb->GetKeyId(address)).Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(TxIds)).Where("value", CondGt, 3), queryResMy);
+    for (auto it : queryResMy) {
+        reindexer::Item itm(it.GetItem());
+        myScores[itm["posttxid"].As<string>()] = itm["value"].As<string>();
+    }
 
     for (auto it : queryRes) {
         reindexer::Item itm(it.GetItem());
-        reindexer::Item itmj;
 
         //1. Add postlikers from private subscribes
         reindexer::QueryResults queryResLikers1;
         g_pocketdb->DB()->Select(
             reindexer::Query("UsersView")
-                .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid", CondEq, itm["txid"].As<string>()).Where("value", CondGt, 3))
+                .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid_id", CondEq, g_pocketdb->GetKeyId(itm["txid"].As<string>())).Where("value", CondGt, 3))
                 .InnerJoin("address", "address_to", CondEq, Query("SubscribesView").Where("address", CondEq, address).Where("private", CondEq, true))
                 .Sort("reputation", true)
                 .Limit(3),
@@ -2742,7 +3012,7 @@ UniValue getpagescores(const JSONRPCRequest& request)
             reindexer::QueryResults queryResLikers2;
             g_pocketdb->DB()->Select(
                 reindexer::Query("UsersView")
-                    .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid", CondEq, itm["txid"].As<string>()).Where("value", CondGt, 3))
+                    .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid_id", CondEq, g_pocketdb->GetKeyId(itm["txid"].As<string>())).Where("value", CondGt, 3))
                     .InnerJoin("address", "address_to", CondEq, Query("SubscribesView").Where("address", CondEq, address).Where("private", CondEq, false))
                     .Sort("reputation", true)
                     .Limit(3 - postlikers.size()),
@@ -2766,7 +3036,7 @@ UniValue getpagescores(const JSONRPCRequest& request)
             reindexer::QueryResults queryResLikers3;
             g_pocketdb->DB()->Select(
                 reindexer::Query("UsersView")
-                    .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid", CondEq, itm["txid"].As<string>()).Where("value", CondGt, 3).Not().Where("address", CondSet, postlikersadrs))
+                    .InnerJoin("address", "address", CondEq, Query("Scores").Where("posttxid_id", CondEq, g_pocketdb->GetKeyId(itm["txid"].As<string>())).Where("value", CondGt, 3).Not().Where("address_id", CondSet, g_pocketdb->GetKeyIds(postlikersadrs)))
                     .Sort("reputation", true)
                     .Limit(3 - postlikers.size()),
                 queryResLikers3);
@@ -2784,7 +3054,7 @@ UniValue getpagescores(const JSONRPCRequest& request)
 
         UniValue postscore(UniValue::VOBJ);
         postscore.pushKV("posttxid", itm["txid"].As<string>());
-        if (it.GetJoined().size() > 0) postscore.pushKV("value", it.GetJoined()[0][0].GetItem()["value"].As<string>());
+        if (myScores.count(itm["txid"].As<string>())) postscore.pushKV("value", myScores[itm["txid"].As<string>()]);
         postscore.pushKV("postlikers", postlikers);
         result.push_back(postscore);
     }
@@ -3050,24 +3320,22 @@ UniValue getquerycontentsforstrips(std::map<std::string, int> qcondints,
 
     error = g_pocketdb->DB()->Select(query, queryResults);
 
-    UniValue contents(UniValue::VARR);
+    std::vector<reindexer::Item> contentItems;
     if (error.ok()) {
         bool onOutput = startTxid.empty();
         for (auto it : queryResults) {
             reindexer::Item contentItm(it.GetItem());
 
             if (onOutput) {
-                UniValue entry(UniValue::VOBJ);
-                entry = getPostData(contentItm, "");
-                contents.push_back(entry);
-            }
-
-            if (!startTxid.empty()) {
-                onOutput = onOutput || startTxid == contentItm["txid"].As<string>();
+                contentItems.push_back(std::move(contentItm));
+            } else if (!startTxid.empty()) {
+                onOutput = startTxid == contentItm["txid"].As<string>();
             }
         }
     }
 
+    UniValue contents = getPostsData(contentItems, "");
+
     UniValue result(UniValue::VOBJ);
     result.pushKV("height", nHeightFrom);
     result.pushKV("contents", contents);
@@ -3277,24 +3545,22 @@ UniValue gethistoricalstrip(const JSONRPCRequest& request)
 
     err = g_pocketdb->DB()->Select(query, queryResults);
 
-    UniValue contents(UniValue::VARR);
+    std::vector<reindexer::Item> postItems;
     if (err.ok()) {
         bool onOutput = start_txid.empty();
         for (auto it : queryResults) {
             reindexer::Item postItm(it.GetItem());
 
             if (onOutput) {
-                UniValue entry(UniValue::VOBJ);
-                entry = getPostData(postItm, "");
-                contents.push_back(entry);
-            }
-
-            if (!start_txid.empty()) {
-                onOutput = onOutput || start_txid == postItm["txid"].As<string>();
+                postItems.push_back(std::move(postItm));
+            } else if (!start_txid.empty()) {
+                onOutput = start_txid == postItm["txid"].As<string>();
             }
         }
     }
 
+    UniValue contents = getPostsData(postItems, "");
+
     UniValue result(UniValue::VOBJ);
     result.pushKV("height", nHeight);
     result.pushKV("contents", contents);
@@ -3462,274 +3728,73 @@ UniValue gethierarchicalstrip(const JSONRPCRequest& request)
     }
 
     // Do not show posts from users with reputation < Limit::bad_reputation
-    {
-        int64_t _bad_reputation_limit = GetActualLimit(Limit::bad_reputation, chainActive.Height());
-        reindexer::QueryResults queryResultsBadReputation;
-        reindexer::Error errorBadReputation = g_pocketdb->DB()->Select(reindexer::Query("UsersView").Where("reputation", CondLe, _bad_reputation_limit), queryResultsBadReputation);
-
-        for (auto it : queryResultsBadReputation) {
-            reindexer::Item itm(it.GetItem());
-            adrsExcluded.push_back(itm["address"].As<string>());
-            uvAdrsExcluded.push_back(itm["address"].As<string>());
-        }
-    }
+    auto badReputation = g_pocketdb->GetBadReputationUsers(GetActualLimit(Limit::bad_reputation, chainActive.Height()));
 
-    enum PostRanks {LAST5, LAST5R, BOOST, UREP, UREPR, DREP, PREP, PREPR, DPOST, POSTRF};
-    int cntBlocksForResult = 300;
-    int cntPrevPosts = 5;
-    int durationBlocksForPrevPosts = 30 * 24 * 60; // about 1 month
-    double dekayRep = 0.82;//0.7;
-    double dekayPost = 0.96;
-    if (contentTypes.size() == 1 && contentTypes[0] == getcontenttype("video"))
-        dekayPost = 0.99;
+    RankingFilter filter;
+    filter.lang = lang;
+    filter.tags = tags;
+    filter.contentTypes = contentTypes;
+    filter.txidsExcluded = txidsExcluded;
+    filter.adrsExcluded = adrsExcluded;
+    filter.tagsExcluded = tagsExcluded;
 
-    std::vector<std::string> txidsOut;
-    std::vector<std::string> txidsHierarchical;
-
-    std::map<std::string, std::map<PostRanks, double>> postsRanks;
-    /*
-    enum scoreDetail {ADDRESS, VALUE, TXID}; // DEBUGINFO
-    std::map<std::string, std::vector<std::map<scoreDetail, std::string>>> postScoresDetails; // DEBUGINFO
-    std::map<std::string, std::vector<std::map<scoreDetail, std::string>>> postPrevScoresDetails; // DEBUGINFO
-     */
-
-    reindexer::Error err;
-    reindexer::Query query;
-    reindexer::QueryResults queryResults;
-
-    query = reindexer::Query("Posts");
-    query = query.Where("block", CondLe, nHeight);
-    query = query.Where("block", CondGt, nHeight - cntBlocksForResult);
-    query = query.Where("time", CondLe, GetAdjustedTime());
-    query = query.Where("txidRepost", CondEq, "");
-    if (!lang.empty()) {
-        query = query.Where("lang", CondEq, lang);
-    }
-    if (!tags.empty()) {
-        query = query.Where("tags", CondSet, tags);
-    }
-    if (!contentTypes.empty()) {
-        query = query.Where("type", CondSet, contentTypes);
-    }
-    if (!txidsExcluded.empty()) {
-        query = query.Not().Where("txid", CondSet, txidsExcluded);
-    }
-    if (!adrsExcluded.empty()) {
-        query = query.Not().Where("address", CondSet, adrsExcluded);
-    }
-    if (!tagsExcluded.empty()) {
-        query = query.Not().Where("tags", CondSet, tagsExcluded);
-    }
-    query = query.LeftJoin("txid", "posttxid", CondEq, reindexer::Query("PostRatings").Where("block", CondLe, nHeight).Sort("block", true).Limit(1));
-    query = query.LeftJoin("address", "address", CondEq, reindexer::Query("UserRatings").Where("block", CondLe, nHeight).Sort("block", true).Limit(1));
-    query = query.LeftJoin("txid", "txid", CondEq, reindexer::Query("PostsHistory").Where("block", CondLe, nHeight).Sort("block", false).Limit(1));
-    query = query.Sort("block", true).Sort("time", true);
-
-    err = g_pocketdb->DB()->Select(query, queryResults);
-    if (err.ok()) {
-        for (auto it : queryResults) {
-            reindexer::Item itm(it.GetItem());
-            double postRep = 0.0;
-            double userRep = 0.0;
-            if (it.GetJoined().size() > 0 && it.GetJoined()[0].Count() > 0) {
-                postRep = it.GetJoined()[0][0].GetItem()["reputation"].As<int>();
-            }
-            if (it.GetJoined().size() > 1 && it.GetJoined()[1].Count() > 0) {
-                userRep = it.GetJoined()[1][0].GetItem()["reputation"].As<int>() / 10.0;
-            }
-
-            reindexer::Query queryPrevsPosts;
-            reindexer::QueryResults queryPrevsPostsResult;
-
-            int cntPositiveScores = 0;
-            std::string posttxid = itm["txid"].As<string>();
-            std::string postaddress = itm["address"].As<string>();
-            int postblock = itm["block"].As<int>();
-            int postblockOrig = postblock;
-            if (it.GetJoined().size() > 2 && it.GetJoined()[2].Count() > 0) {
-                postblockOrig = it.GetJoined()[2][0].GetItem()["block"].As<int>();
-            }
-            uvTxidsExcluded.push_back(posttxid);
-
-            /*
-            // DEBUGINFO
-            if (postRep != 0) {
-                reindexer::QueryResults postRepQueryResult;
-                if (g_pocketdb->DB()->Select(reindexer::Query("Scores").Where("posttxid", CondEq, posttxid).Where("block", CondLe, nHeight), postRepQueryResult).ok()) {
-                    for (auto itPostRep : postRepQueryResult) {
-                        reindexer::Item itmPR(itPostRep.GetItem());
-                        if (g_antibot->AllowModifyReputationOverPost(itmPR["address"].As<string>(), postaddress, itmPR["block"].As<int>(), itmPR["time"].As<int64_t>(), posttxid, false)) {
-                            std::map<scoreDetail, std::string> postScoresDetail;           // DEBUGINFO
-                            postScoresDetail[ADDRESS] = itmPR["address"].As<string>(); // DEBUGINFO
-                            postScoresDetail[VALUE] = itmPR["value"].As<string>();     // DEBUGINFO
-                            postScoresDetails[posttxid].push_back(postScoresDetail);       // DEBUGINFO
-                        }
-                    }
-                }
-            }
-             */
-
-            queryPrevsPosts = reindexer::Query("Posts", 0, cntPrevPosts)
-                                     .Where("address", CondEq, postaddress)
-                                     .Where("block", CondLt, postblockOrig)
-                                     .Where("block", CondGe, postblockOrig - durationBlocksForPrevPosts);
-            err = g_pocketdb->DB()->Select(queryPrevsPosts, queryPrevsPostsResult);
-            if (err.ok()) {
-                std::vector<std::string> prevPostsIds;
-                for (auto itPrevPost : queryPrevsPostsResult) {
-                    reindexer::Item itmPP(itPrevPost.GetItem());
-                    prevPostsIds.push_back(itmPP["txid"].As<string>());
-                }
-                std::vector<int> scores = {1, 5};
-                reindexer::Query queryScores;
-                reindexer::QueryResults queryScoresResult;
-                queryScores = reindexer::Query("Scores");
-                queryScores = queryScores.Where("posttxid", CondSet, prevPostsIds);
-                queryScores = queryScores.Where("block", CondLe, postblock);
-                queryScores = queryScores.Where("value", CondSet, scores);
-                reindexer::Error errSc = g_pocketdb->DB()->Select(queryScores, queryScoresResult);
-                if (errSc.ok()) {
-                    std::vector<string> addressesRated;
-                    for (auto itScore : queryScoresResult) {
-                        reindexer::Item itmScore(itScore.GetItem());
-                        if (g_antibot->AllowModifyReputationOverPost(itmScore["address"].As<string>(), postaddress, itmScore["block"].As<int>(), itmScore["time"].As<int64_t>(), itmScore["txid"].As<string>(), false)) {
-                            if(std::find(addressesRated.begin(), addressesRated.end(), itmScore["address"].As<string>()) == addressesRated.end()) {
-                                addressesRated.push_back(itmScore["address"].As<string>());
-                                cntPositiveScores += itmScore["value"].As<int>() == 5 ? 1 : -1;
-                                /*
-                                std::map<scoreDetail, std::string> postPrevScoresDetail; // DEBUGINFO
-                                postPrevScoresDetail[ADDRESS] = itmScore["address"].As<string>(); // DEBUGINFO
-                                postPrevScoresDetail[VALUE] = itmScore["value"].As<string>(); // DEBUGINFO
-                                postPrevScoresDetail[TXID] = itmScore["posttxid"].As<string>(); // DEBUGINFO
-                                postPrevScoresDetails[posttxid].push_back(postPrevScoresDetail); // DEBUGINFO
-                                 */
-                            }
-                        }
-                    }
-                }
-            }
-            postsRanks[posttxid][LAST5] = 1.0 * cntPositiveScores;
-            postsRanks[posttxid][UREP] = userRep;
-            postsRanks[posttxid][PREP] = postRep;
-            postsRanks[posttxid][DREP] = pow(dekayRep, (nHeight - postblockOrig));
-            postsRanks[posttxid][DPOST] = pow(dekayPost, (nHeight - postblockOrig));
-        }
-
-        std::map<PostRanks, int> count;
-        int nElements = postsRanks.size();
-        for (auto iPostRank : postsRanks) {
-            count[LAST5R] = 0;
-            count[UREPR] = 0;
-            count[PREPR] = 0;
-            double boost = 0;
-            if (nElements > 1) {
-                for (auto jPostRank : postsRanks) {
-                    if (iPostRank.second[LAST5] > jPostRank.second[LAST5]) {
-                        count[LAST5R] += 1;
-                    }
-                    if (iPostRank.second[UREP] > jPostRank.second[UREP]) {
-                        count[UREPR] += 1;
-                    }
-                    if (iPostRank.second[PREP] > jPostRank.second[PREP]) {
-                        count[PREPR] += 1;
-                    }
-                }
-                postsRanks[iPostRank.first][LAST5R] = 1.0 * (count[LAST5R] * 100) / (nElements - 1);
-                postsRanks[iPostRank.first][UREPR] = std::min(postsRanks[iPostRank.first][UREP], 1.0 * (count[UREPR] * 100) / (nElements - 1)) * (postsRanks[iPostRank.first][UREP] < 0 ? 2.0 : 1.0);
-                postsRanks[iPostRank.first][PREPR] = std::min(postsRanks[iPostRank.first][PREP], 1.0 * (count[PREPR] * 100) / (nElements - 1)) * (postsRanks[iPostRank.first][PREP] < 0 ? 2.0 : 1.0);
-            }
-            else {
-                postsRanks[iPostRank.first][LAST5R] = 100;
-                postsRanks[iPostRank.first][UREPR] = 100;
-                postsRanks[iPostRank.first][PREPR] = 100;
-            }
-            postsRanks[iPostRank.first][POSTRF] = 0.4 *
-                                                      (0.75 *
-                                                              (postsRanks[iPostRank.first][LAST5R] + boost) +
-                                                          0.25 * postsRanks[iPostRank.first][UREPR]) *
-                                                      postsRanks[iPostRank.first][DREP] +
-                                                  0.6 * postsRanks[iPostRank.first][PREPR] * postsRanks[iPostRank.first][DPOST];
-        }
-
-        std::vector<std::pair<double, string>> postsRaited;
-
-        UniValue oPost(UniValue::VOBJ);
-        for (auto iPostRank : postsRanks) {
-            postsRaited.push_back(std::make_pair(iPostRank.second[POSTRF], iPostRank.first));
-        }
-
-        std::sort(postsRaited.begin(), postsRaited.end(), std::greater{});
-
-        for (auto v : postsRaited) {
-            txidsHierarchical.push_back(v.second);
-        }
-    }
+    // Sorted from memory for current tip
+    auto rankedTxids = g_post_ranking.GetRanking(nHeight, filter, *badReputation);
+    const std::vector<std::string>& txidsHierarchical = *rankedTxids;
 
     UniValue contents(UniValue::VARR);
 
     if(!txidsHierarchical.empty())
     {
-        std::vector<std::string>::iterator itVec;
+        auto itVec = txidsHierarchical.begin();
         if (!start_txid.empty()) {
             if ((itVec = std::find(txidsHierarchical.begin(), txidsHierarchical.end(), start_txid)) != txidsHierarchical.end()) {
                 ++itVec;
                 start_txid.clear();
             }
         }
-        else {
-            itVec = txidsHierarchical.begin();
-        }
 
+        std::vector<std::string> pageTxids;
         for(; itVec != txidsHierarchical.end() && countOut > 0; ++itVec, countOut--) {
-            reindexer::Item postItm;
-            reindexer::Error errS = g_pocketdb->SelectOne(reindexer::Query("Posts").Where("txid", CondEq, *itVec), postItm);
-            UniValue entry(UniValue::VOBJ);
-            entry = getPostData(postItm, "");
-            /*
-            if(postsRanks.find(*itVec) != postsRanks.end()) {
-                UniValue entryRanks(UniValue::VOBJ); // DEBUGINFO
-                entryRanks.pushKV("LAST5", postsRanks[*itVec][LAST5]); // DEBUGINFO
-                entryRanks.pushKV("LAST5R", postsRanks[*itVec][LAST5R]); // DEBUGINFO
-
-                UniValue entrtyPrevScoresAdrs(UniValue::VARR); // DEBUGINFO
-                for(auto pPrevScoreDetail : postPrevScoresDetails[*itVec]) // DEBUGINFO
-                {
-                    UniValue entryScoreAdr(UniValue::VOBJ); // DEBUGINFO
-                    entryScoreAdr.pushKV("address", pPrevScoreDetail[ADDRESS]); // DEBUGINFO
-                    entryScoreAdr.pushKV("value", pPrevScoreDetail[VALUE]); // DEBUGINFO
-                    entryScoreAdr.pushKV("posttxid", pPrevScoreDetail[TXID]); // DEBUGINFO
-                    entrtyPrevScoresAdrs.push_back(entryScoreAdr); // DEBUGINFO
-                }
-                entryRanks.pushKV("LAST5RADRS", entrtyPrevScoresAdrs); // DEBUGINFO
-
-                entryRanks.pushKV("BOOST", postsRanks[*itVec][BOOST]); // DEBUGINFO
-                entryRanks.pushKV("UREP", postsRanks[*itVec][UREP]); // DEBUGINFO
-                entryRanks.pushKV("UREPR", postsRanks[*itVec][UREPR]); // DEBUGINFO
-                entryRanks.pushKV("DREP", postsRanks[*itVec][DREP]); // DEBUGINFO
-                entryRanks.pushKV("PREP", postsRanks[*itVec][PREP]); // DEBUGINFO
-
-                UniValue entrtyScoresAdrs(UniValue::VARR); // DEBUGINFO
-                for(auto pScoreDetail : postScoresDetails[*itVec]) // DEBUGINFO
-                {
-                    UniValue entryScoreAdr(UniValue::VOBJ); // DEBUGINFO
-                    entryScoreAdr.pushKV("address", pScoreDetail[ADDRESS]); // DEBUGINFO
-                    entryScoreAdr.pushKV("value", pScoreDetail[VALUE]); // DEBUGINFO
-                    entrtyScoresAdrs.push_back(entryScoreAdr); // DEBUGINFO
-                }
-                entryRanks.pushKV("PREPRADRS", entrtyScoresAdrs); // DEBUGINFO
+            pageTxids.push_back(*itVec);
+        }
 
-                entryRanks.pushKV("PREPR", postsRanks[*itVec][PREPR]); // DEBUGINFO
-                entryRanks.pushKV("DPOST", postsRanks[*itVec][DPOST]); // DEBUGINFO
-                entryRanks.pushKV("POSTRF", postsRanks[*itVec][POSTRF]); // DEBUGINFO
-                entry.pushKV("ranks", entryRanks); // DEBUGINFO
+        // Posts of page selected together
+        std::map<std::string, reindexer::Item> pagePosts;
+        reindexer::QueryResults pageRes;
+        if (g_pocketdb->DB()->Select(reindexer::Query("Posts").Where("txid", CondSet, pageTxids), pageRes).ok()) {
+            for (auto& it : pageRes) {
+                reindexer::Item postItm = it.GetItem();
+                std::string txid = postItm["txid"].As<string>();
+                pagePosts.emplace(txid, std::move(postItm));
             }
-             */
-            contents.push_back(entry);
-            uvTxidsExcluded.push_back(*itVec);
+        }
+
+        std::vector<reindexer::Item> postItems;
+        for (const auto& txid : pageTxids) {
+            auto itPost = pagePosts.find(txid);
+            if (itPost != pagePosts.end()) {
+                postItems.push_back(std::move(itPost->second));
+            }
+        }
+
+        UniValue entries = getPostsData(postItems, "");
+        for (size_t i = 0; i < entries.size(); i++) {
+            contents.push_back(entries[i]);
         }
     }
 
     if (txidsHierarchical.empty() || countOut > 0) {
+        // Ranked posts are not repeated in historical strip
+        for (const auto& txid : txidsHierarchical) {
+            uvTxidsExcluded.push_back(txid);
+        }
+
+        // Historical strip not filters users with bad reputation itself
+        for (const auto& adr : *badReputation) {
+            uvAdrsExcluded.push_back(adr);
+        }
+
         JSONRPCRequest new_request;
         new_request = request;
         UniValue new_params(UniValue::VARR);
@@ -4018,14 +4083,15 @@ UniValue searchlinks(const JSONRPCRequest& request)
 
     err = g_pocketdb->DB()->Select(query, queryResults);
 
-    UniValue contents(UniValue::VARR);
+    std::vector<Item> contentItems;
     if(err.ok()){
         for (auto& it : queryResults) {
-            Item _itm = it.GetItem();
-            contents.push_back(getPostData(_itm, ""));
+            contentItems.push_back(it.GetItem());
         }
     }
 
+    UniValue contents = getPostsData(contentItems, "");
+
     UniValue result(UniValue::VOBJ);
     result.pushKV("height", nHeight);
     result.pushKV("contents", contents);
@@ -4099,44 +4165,6 @@ UniValue getcontentsstatistic(const JSONRPCRequest& request)
         }
     }
 
-    reindexer::Error err;
-    reindexer::Query queryPosts;
-    reindexer::Query queryScores;
-    reindexer::QueryResults queryResults;
-    reindexer::AggregationResult aggregationResult;
-
-    int nHeight = chainActive.Height();
-
-    /*queryPosts = reindexer::Query("Posts");
-    queryPosts = queryPosts.Where("time", CondLe, GetAdjustedTime());
-    queryPosts = queryPosts.Where("block", CondLe, nHeight);
-    queryPosts = queryPosts.Where("address", CondSet, addresses);
-    if (!contentTypes.empty()) {
-        queryPosts = queryPosts.Where("type", CondSet, contentTypes);
-    }
-    //queryPosts = queryPosts.InnerJoin("txid", "posttxid", CondEq, queryScores);
-    //queryPosts = queryPosts.Distinct()
-    //queryPosts = queryScores.Aggregate("address", );
-
-    std::vector<std::string> posttxid;
-    queryScores = reindexer::Query("Scores");
-    queryScores = queryPosts.Where("time", CondLe, GetAdjustedTime());
-    queryScores = queryPosts.Where("block", CondLe, nHeight);
-    queryScores = queryScores.Where("posttxid", CondSet, posttxid);
-
-    //err = g_pocketdb->SelectAggr(queryPosts, queryResults);
-    err = g_pocketdb->DB()->Select(queryPosts, queryResults);
-
-    if (err.ok()) {
-        std::string author = "";
-        for (auto& item : queryResults) {
-            Item _itm = item.GetItem();
-        }
-//        for (const auto &item : aggregationResult.facets) {
-//            //item.
-//        }
-    }*/
-
     UniValue result(UniValue::VOBJ);
     return result;
 }
@@ -44,10 +44,27 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
     return reply;
 }
 
+// Same as JSONRPCReplyObj(...).write() without copy of result into reply object
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id)
 {
-    UniValue reply = JSONRPCReplyObj(result, error, id);
-    return reply.write() + "\n";
+    if (error.isNull()) return JSONRPCResultReply(result.write(), id);
+
+    std::string reply = "{\"result\":null,\"error\":";
+    reply += error.write();
+    reply += ",\"id\":";
+    reply += id.write();
+    reply += "}\n";
+    return reply;
+}
+
+std::string JSONRPCResultReply(const std::string& result, const UniValue& id)
+{
+    std::string reply = "{\"result\":";
+    reply += result;
+    reply += ",\"error\":null,\"id\":";
+    reply += id.write();
+    reply += "}\n";
+    return reply;
 }
 
 UniValue JSONRPCError(int code, const std::string& message)
@@ -0,0 +1,394 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/ranking.h>
+
+#include <antibot/antibot.h>
+#include <chain.h>
+#include <pocketdb/pocketdb.h>
+#include <pocketdb/pocketnet.h>
+#include <timedata.h>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+PostRanking g_post_ranking;
+
+static const int RANKING_PREV_POSTS = 5;
+static const int RANKING_PREV_POSTS_BLOCKS = 30 * 24 * 60; // about 1 month
+static const double RANKING_DEKAY_REP = 0.82;
+static const double RANKING_DEKAY_POST = 0.96;
+static const double RANKING_DEKAY_VIDEO = 0.99;
+
+void PostRanking::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) return;
+
+    int newHeight = pindexNew->nHeight;
+    int forkHeight = pindexFork ? pindexFork->nHeight : -1;
+
+    LOCK(cs_update);
+    if (height < 0 || forkHeight < height || newHeight - height > RANKING_DEPTH_BLOCKS) {
+        rebuild(newHeight, forkHeight);
+    } else {
+        connect(newHeight);
+    }
+
+    publish();
+}
+
+void PostRanking::rebuild(int heightIn, int forkHeight)
+{
+    std::vector<RankingPost> loaded;
+    if (!loadPosts(heightIn, heightIn - RANKING_DEPTH_BLOCKS, heightIn, nullptr, loaded, &posts, forkHeight)) {
+        posts.clear();
+        height = -1;
+        return;
+    }
+
+    posts.clear();
+    for (auto& post : loaded) {
+        posts[post.txid] = std::move(post);
+    }
+
+    height = heightIn;
+}
+
+void PostRanking::connect(int heightIn)
+{
+    std::vector<RankingPost> loaded;
+    if (!loadPosts(heightIn, height, heightIn, nullptr, loaded)) {
+        // Keep consistent - reload all with next tip
+        height = -1;
+        return;
+    }
+
+    // Edited posts are replaced with new version
+    for (auto& post : loaded) {
+        posts[post.txid] = std::move(post);
+    }
+
+    for (auto it = posts.begin(); it != posts.end();) {
+        if (it->second.block <= heightIn - RANKING_DEPTH_BLOCKS) {
+            it = posts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    refreshRatings(height, heightIn);
+    height = heightIn;
+}
+
+void PostRanking::refreshRatings(int fromBlock, int toBlock)
+{
+    std::set<std::string> addresses;
+    reindexer::QueryResults userRes;
+    if (g_pocketdb->DB()->Select(reindexer::Query("UserRatings").Where("block", CondGt, fromBlock).Where("block", CondLe, toBlock), userRes).ok()) {
+        for (auto& it : userRes) {
+            addresses.insert(it.GetItem()["address"].As<string>());
+        }
+    }
+
+    std::set<std::string> posttxids;
+    reindexer::QueryResults postRes;
+    if (g_pocketdb->DB()->Select(reindexer::Query("PostRatings").Where("block", CondGt, fromBlock).Where("block", CondLe, toBlock), postRes).ok()) {
+        for (auto& it : postRes) {
+            posttxids.insert(it.GetItem()["posttxid"].As<string>());
+        }
+    }
+
+    std::map<std::string, double> userReps;
+    for (auto& it : posts) {
+        RankingPost& post = it.second;
+
+        if (addresses.count(post.address) > 0) {
+            auto itRep = userReps.find(post.address);
+            if (itRep == userReps.end()) {
+                double userRep = 0.0;
+                reindexer::Item userItm;
+                if (g_pocketdb->SelectOne(reindexer::Query("UserRatings").Where("address", CondEq, post.address).Where("block", CondLe, toBlock).Sort("block", true), userItm).ok()) {
+                    userRep = userItm["reputation"].As<int>() / 10.0;
+                }
+                itRep = userReps.emplace(post.address, userRep).first;
+            }
+            post.userRep = itRep->second;
+        }
+
+        if (posttxids.count(post.txid) > 0) {
+            reindexer::Item postItm;
+            if (g_pocketdb->SelectOne(reindexer::Query("PostRatings").Where("posttxid", CondEq, post.txid).Where("block", CondLe, toBlock).Sort("block", true), postItm).ok()) {
+                post.postRep = postItm["reputation"].As<int>();
+            }
+        }
+    }
+}
+
+void PostRanking::publish()
+{
+    auto next = std::make_shared<Snapshot>();
+    next->height = height;
+    if (height >= 0) {
+        next->posts.reserve(posts.size());
+        for (const auto& it : posts) {
+            next->posts.push_back(it.second);
+        }
+    }
+
+    LOCK(cs);
+    snapshot = next;
+}
+
+bool PostRanking::loadPosts(int heightIn, int fromBlock, int toBlock, const RankingFilter* filter, std::vector<RankingPost>& out,
+    const std::map<std::string, RankingPost>* known, int knownMaxBlock)
+{
+    reindexer::Query query("Posts");
+    query = query.Where("block", CondLe, toBlock);
+    query = query.Where("block", CondGt, fromBlock);
+    query = query.Where("txidRepost", CondEq, "");
+    if (filter) {
+        query = query.Where("time", CondLe, GetAdjustedTime());
+        if (!filter->lang.empty()) {
+            query = query.Where("lang", CondEq, filter->lang);
+        }
+        if (!filter->tags.empty()) {
+            query = query.Where("tags", CondSet, filter->tags);
+        }
+        if (!filter->contentTypes.empty()) {
+            query = query.Where("type", CondSet, filter->contentTypes);
+        }
+        if (!filter->txidsExcluded.empty()) {
+            query = query.Not().Where("txid", CondSet, filter->txidsExcluded);
+        }
+        if (!filter->adrsExcluded.empty()) {
+            query = query.Not().Where("address", CondSet, filter->adrsExcluded);
+        }
+        if (!filter->tagsExcluded.empty()) {
+            query = query.Not().Where("tags", CondSet, filter->tagsExcluded);
+        }
+    }
+    query = query.LeftJoin("txid", "posttxid", CondEq, reindexer::Query("PostRatings").Where("block", CondLe, heightIn).Sort("block", true).Limit(1));
+    query = query.LeftJoin("address", "address", CondEq, reindexer::Query("UserRatings").Where("block", CondLe, heightIn).Sort("block", true).Limit(1));
+    query = query.LeftJoin("txid", "txid", CondEq, reindexer::Query("PostsHistory").Where("block", CondLe, heightIn).Sort("block", false).Limit(1));
+
+    reindexer::QueryResults queryResults;
+    if (!g_pocketdb->DB()->Select(query, queryResults).ok()) return false;
+
+    for (auto& it : queryResults) {
+        reindexer::Item itm(it.GetItem());
+
+        RankingPost post;
+        post.txid = itm["txid"].As<string>();
+        post.address = itm["address"].As<string>();
+        post.lang = itm["lang"].As<string>();
+        post.type = itm["type"].As<int>();
+        post.block = itm["block"].As<int>();
+        post.blockOrig = post.block;
+        post.time = itm["time"].As<int64_t>();
+        post.userRep = 0.0;
+        post.postRep = 0.0;
+
+        if (it.GetJoined().size() > 0 && it.GetJoined()[0].Count() > 0) {
+            post.postRep = it.GetJoined()[0][0].GetItem()["reputation"].As<int>();
+        }
+        if (it.GetJoined().size() > 1 && it.GetJoined()[1].Count() > 0) {
+            post.userRep = it.GetJoined()[1][0].GetItem()["reputation"].As<int>() / 10.0;
+        }
+        if (it.GetJoined().size() > 2 && it.GetJoined()[2].Count() > 0) {
+            post.blockOrig = it.GetJoined()[2][0].GetItem()["block"].As<int>();
+        }
+
+        // Scores before post block are not changed while post is in chain
+        auto itKnown = known ? known->find(post.txid) : std::map<std::string, RankingPost>::const_iterator();
+        if (known && itKnown != known->end() && itKnown->second.block == post.block && post.block <= knownMaxBlock) {
+            post.last5 = itKnown->second.last5;
+        } else {
+            post.last5 = GetPrevPostsScore(post.address, post.block, post.blockOrig);
+        }
+
+        out.push_back(std::move(post));
+    }
+
+    return true;
+}
+
+void PostRanking::selectTagged(int heightIn, const std::vector<std::string>& tags, std::unordered_set<std::string>& txids)
+{
+    // Tags compared with collation of database
+    reindexer::QueryResults res;
+    if (g_pocketdb->DB()->Select(reindexer::Query("Posts")
+                                     .Where("block", CondLe, heightIn)
+                                     .Where("block", CondGt, heightIn - RANKING_DEPTH_BLOCKS)
+                                     .Where("tags", CondSet, tags),
+            res).ok()) {
+        for (auto& it : res) {
+            txids.insert(it.GetItem()["txid"].As<string>());
+        }
+    }
+}
+
+double PostRanking::GetPrevPostsScore(const std::string& address, int block, int blockOrig)
+{
+    int cntPositiveScores = 0;
+
+    reindexer::QueryResults prevPostsRes;
+    reindexer::Query queryPrevPosts = reindexer::Query("Posts", 0, RANKING_PREV_POSTS)
+                                          .Where("address", CondEq, address)
+                                          .Where("block", CondLt, blockOrig)
+                                          .Where("block", CondGe, blockOrig - RANKING_PREV_POSTS_BLOCKS);
+    if (!g_pocketdb->DB()->Select(queryPrevPosts, prevPostsRes).ok()) return 0.0;
+
+    std::vector<std::string> prevPostsIds;
+    for (auto& it : prevPostsRes) {
+        prevPostsIds.push_back(it.GetItem()["txid"].As<string>());
+    }
+
+    std::vector<int> scores = {1, 5};
+    reindexer::QueryResults scoresRes;
+    reindexer::Query queryScores = reindexer::Query("Scores")
+                                       .Where("posttxid_id", CondSet, g_pocketdb->GetKeyIds(prevPostsIds))
+                                       .Where("block", CondLe, block)
+                                       .Where("block", CondGe, g_pocketdb->GetRatingCheckpoint())
+                                       .Where("value", CondSet, scores);
+    if (!g_pocketdb->DB()->Select(queryScores, scoresRes).ok()) return 0.0;
+
+    std::vector<std::string> addressesRated;
+    for (auto& it : scoresRes) {
+        reindexer::Item itmScore(it.GetItem());
+        std::string scoreAddress = itmScore["address"].As<string>();
+        if (g_antibot->AllowModifyReputationOverPost(scoreAddress, address, itmScore["block"].As<int>(), itmScore["time"].As<int64_t>(), itmScore["txid"].As<string>(), false)) {
+            if (std::find(addressesRated.begin(), addressesRated.end(), scoreAddress) == addressesRated.end()) {
+                addressesRated.push_back(scoreAddress);
+                cntPositiveScores += itmScore["value"].As<int>() == 5 ? 1 : -1;
+            }
+        }
+    }
+
+    return 1.0 * cntPositiveScores;
+}
+
+std::vector<std::string> PostRanking::rank(const std::vector<const RankingPost*>& candidates, int heightIn, double dekayPost)
+{
+    // Rank of value is count of candidates with lower value
+    std::vector<double> last5s, userReps, postReps;
+    for (const auto* post : candidates) {
+        last5s.push_back(post->last5);
+        userReps.push_back(post->userRep);
+        postReps.push_back(post->postRep);
+    }
+    std::sort(last5s.begin(), last5s.end());
+    std::sort(userReps.begin(), userReps.end());
+    std::sort(postReps.begin(), postReps.end());
+
+    auto lower = [](const std::vector<double>& sorted, double value) {
+        return (int)(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin());
+    };
+
+    int nElements = candidates.size();
+    std::vector<std::pair<double, std::string>> postsRaited;
+    postsRaited.reserve(nElements);
+    for (const auto* post : candidates) {
+        double last5R = 100;
+        double urepR = 100;
+        double prepR = 100;
+        double boost = 0;
+        if (nElements > 1) {
+            last5R = 1.0 * (lower(last5s, post->last5) * 100) / (nElements - 1);
+            urepR = std::min(post->userRep, 1.0 * (lower(userReps, post->userRep) * 100) / (nElements - 1)) * (post->userRep < 0 ? 2.0 : 1.0);
+            prepR = std::min(post->postRep, 1.0 * (lower(postReps, post->postRep) * 100) / (nElements - 1)) * (post->postRep < 0 ? 2.0 : 1.0);
+        }
+
+        double drep = pow(RANKING_DEKAY_REP, (heightIn - post->blockOrig));
+        double dpost = pow(dekayPost, (heightIn - post->blockOrig));
+        double postrf = 0.4 * (0.75 * (last5R + boost) + 0.25 * urepR) * drep + 0.6 * prepR * dpost;
+        postsRaited.emplace_back(postrf, post->txid);
+    }
+
+    std::sort(postsRaited.begin(), postsRaited.end(), std::greater{});
+
+    std::vector<std::string> txids;
+    txids.reserve(postsRaited.size());
+    for (auto& v : postsRaited) {
+        txids.push_back(std::move(v.second));
+    }
+
+    return txids;
+}
+
+std::shared_ptr<const std::vector<std::string>> PostRanking::GetRanking(int heightIn, const RankingFilter& filter,
+    const std::unordered_set<std::string>& badReputation)
+{
+    double dekayPost = RANKING_DEKAY_POST;
+    if (filter.contentTypes.size() == 1 && filter.contentTypes[0] == getcontenttype("video"))
+        dekayPost = RANKING_DEKAY_VIDEO;
+
+    std::shared_ptr<const Snapshot> current;
+    {
+        LOCK(cs);
+        current = snapshot;
+    }
+
+    if (!current || current->height != heightIn) {
+        std::vector<RankingPost> loaded;
+        loadPosts(heightIn, heightIn - RANKING_DEPTH_BLOCKS, heightIn, &filter, loaded);
+
+        std::vector<const RankingPost*> candidates;
+        for (const auto& post : loaded) {
+            if (badReputation.count(post.address) == 0) candidates.push_back(&post);
+        }
+
+        return std::make_shared<const std::vector<std::string>>(rank(candidates, heightIn, dekayPost));
+    }
+
+    // Ranking of language and content types shared by requests of tip
+    bool partition = filter.tags.empty() && filter.txidsExcluded.empty() && filter.adrsExcluded.empty() && filter.tagsExcluded.empty();
+    std::set<int> types(filter.contentTypes.begin(), filter.contentTypes.end());
+    std::string key = filter.lang;
+    for (int type : types) {
+        key += '\0' + std::to_string(type);
+    }
+
+    if (partition) {
+        LOCK(current->cs);
+        auto it = current->partitions.find(key);
+        if (it != current->partitions.end()) return it->second;
+    }
+
+    std::unordered_set<std::string> tagged;
+    if (!filter.tags.empty()) selectTagged(heightIn, filter.tags, tagged);
+    std::unordered_set<std::string> taggedExcluded;
+    if (!filter.tagsExcluded.empty()) selectTagged(heightIn, filter.tagsExcluded, taggedExcluded);
+    std::unordered_set<std::string> txidsExcluded(filter.txidsExcluded.begin(), filter.txidsExcluded.end());
+    std::unordered_set<std::string> adrsExcluded(filter.adrsExcluded.begin(), filter.adrsExcluded.end());
+
+    int64_t adjustedTime = GetAdjustedTime();
+    bool future = false;
+
+    std::vector<const RankingPost*> candidates;
+    for (const auto& post : current->posts) {
+        if (!filter.lang.empty() && post.lang != filter.lang) continue;
+        if (!types.empty() && types.count(post.type) == 0) continue;
+        if (post.time > adjustedTime) {
+            future = true;
+            continue;
+        }
+        if (badReputation.count(post.address) > 0) continue;
+        if (!filter.tags.empty() && tagged.count(post.txid) == 0) continue;
+        if (taggedExcluded.count(post.txid) > 0) continue;
+        if (txidsExcluded.count(post.txid) > 0) continue;
+        if (adrsExcluded.count(post.address) > 0) continue;
+        candidates.push_back(&post);
+    }
+
+    auto result = std::make_shared<const std::vector<std::string>>(rank(candidates, heightIn, dekayPost));
+
+    // Posts from future will be candidates later
+    if (partition && !future) {
+        LOCK(current->cs);
+        if (current->partitions.size() < RANKING_MAX_PARTITIONS) current->partitions.emplace(key, result);
+    }
+
+    return result;
+}
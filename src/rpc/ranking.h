@@ -0,0 +1,100 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef POCKETCOIN_RPC_RANKING_H
+#define POCKETCOIN_RPC_RANKING_H
+
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/** Posts of last blocks ranked in hierarchical strip */
+static const int RANKING_DEPTH_BLOCKS = 300;
+/** Maximum sorted rankings kept for one tip */
+static const size_t RANKING_MAX_PARTITIONS = 64;
+
+struct RankingPost {
+    std::string txid;
+    std::string address;
+    std::string lang;
+    int type;
+    int block;
+    // Block of first version for edited post
+    int blockOrig;
+    int64_t time;
+    // Positive minus negative scores over previous posts of author
+    double last5;
+    double userRep;
+    double postRep;
+};
+
+struct RankingFilter {
+    std::string lang;
+    std::vector<std::string> tags;
+    std::vector<int> contentTypes;
+    std::vector<std::string> txidsExcluded;
+    std::vector<std::string> adrsExcluded;
+    std::vector<std::string> tagsExcluded;
+};
+
+/*
+	Ranking of posts for hierarchical strip.
+	Rank components of posts from last blocks are kept in memory and updated with
+	every tip: posts of connected blocks are added, expired are dropped, reputations
+	are reread only for posts and authors rated in new blocks. Reorganization reloads
+	window but keeps components of posts below fork.
+	Ranking for language and content types is sorted once per tip, other filters
+	are ranked from memory. Other heights are ranked from database.
+	Thread safe.
+*/
+class PostRanking final : public CValidationInterface
+{
+private:
+    struct Snapshot {
+        int height;
+        std::vector<RankingPost> posts;
+        mutable CCriticalSection cs;
+        mutable std::map<std::string, std::shared_ptr<const std::vector<std::string>>> partitions;
+    };
+
+    // Serializes updates
+    CCriticalSection cs_update;
+    std::map<std::string, RankingPost> posts;
+    int height = -1;
+
+    mutable CCriticalSection cs;
+    std::shared_ptr<const Snapshot> snapshot;
+
+    void rebuild(int heightIn, int forkHeight);
+    void connect(int heightIn);
+    void refreshRatings(int fromBlock, int toBlock);
+    void publish();
+
+    // Posts with fromBlock < block <= toBlock, reputations at heightIn.
+    // Scores of known posts with block <= knownMaxBlock are not recounted.
+    static bool loadPosts(int heightIn, int fromBlock, int toBlock, const RankingFilter* filter, std::vector<RankingPost>& out,
+        const std::map<std::string, RankingPost>* known = nullptr, int knownMaxBlock = -1);
+    static void selectTagged(int heightIn, const std::vector<std::string>& tags, std::unordered_set<std::string>& txids);
+    static std::vector<std::string> rank(const std::vector<const RankingPost*>& candidates, int heightIn, double dekayPost);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+public:
+    // Scores over last posts of author published before post
+    static double GetPrevPostsScore(const std::string& address, int block, int blockOrig);
+
+    // Txids sorted by rank descending
+    std::shared_ptr<const std::vector<std::string>> GetRanking(int heightIn, const RankingFilter& filter,
+        const std::unordered_set<std::string>& badReputation);
+};
+
+extern PostRanking g_post_ranking;
+
+#endif // POCKETCOIN_RPC_RANKING_H
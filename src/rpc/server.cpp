@@ -8,6 +8,7 @@
 #include <fs.h>
 #include <key_io.h>
 #include <random.h>
+#include <rpc/cache.h>
 #include <shutdown.h>
 #include <sync.h>
 #include <ui_interface.h>
@@ -393,36 +394,40 @@ bool IsDeprecatedRPCEnabled(const std::string& method)
     return find(enabled_methods.begin(), enabled_methods.end(), method) != enabled_methods.end();
 }
 
-static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
+static std::string JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
 {
-    UniValue rpc_result(UniValue::VOBJ);
+    std::string rpc_result;
 
     try {
         jreq.parse(req);
 
-        UniValue result = tableRPC.execute(jreq);
-        rpc_result = JSONRPCReplyObj(result, NullUniValue, jreq.id);
+        rpc_result = tableRPC.executeReply(jreq);
     }
     catch (const UniValue& objError)
     {
-        rpc_result = JSONRPCReplyObj(NullUniValue, objError, jreq.id);
+        rpc_result = JSONRPCReply(NullUniValue, objError, jreq.id);
     }
     catch (const std::exception& e)
     {
-        rpc_result = JSONRPCReplyObj(NullUniValue,
-                                     JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        rpc_result = JSONRPCReply(NullUniValue,
+                                  JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
     }
 
+    // Without newline - item of array
+    rpc_result.pop_back();
     return rpc_result;
 }
 
+// Every reply serialized once straight into batch reply
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    std::string ret = "[";
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        if (reqIdx > 0) ret += ",";
+        ret += JSONRPCExecOne(jreq, vReq[reqIdx]);
+    }
 
-    return ret.write() + "\n";
+    return ret + "]\n";
 }
 
 /**
@@ -506,6 +511,22 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     }
 }
 
+std::string CRPCTable::executeReply(const JSONRPCRequest &request) const
+{
+    if (!RPCResultCache::IsCacheable(request.strMethod))
+        return JSONRPCReply(execute(request), NullUniValue, request.id);
+
+    std::string key = RPCResultCache::MakeKey(request.strMethod, request.params);
+    std::shared_ptr<const std::string> result;
+    uint64_t generation;
+    if (!g_rpc_cache.Get(key, result, generation)) {
+        result = std::make_shared<const std::string>(execute(request).write());
+        g_rpc_cache.Put(key, result, generation);
+    }
+
+    return JSONRPCResultReply(*result, request.id);
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -20,6 +20,7 @@
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
 
 class CRPCCommand;
+class JSONStreamWriter;
 
 namespace RPCServer
 {
@@ -46,8 +47,10 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    // Result can be written to client part by part (single HTTP request only)
+    JSONStreamWriter* stream;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), stream(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
@@ -158,6 +161,13 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    /**
+     * Execute a method and serialize reply.
+     * Results of cacheable methods are served from cache for the same chain tip.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    std::string executeReply(const JSONRPCRequest &request) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -0,0 +1,94 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/stream.h>
+
+#include <rpc/server.h>
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sinkIn, const std::string& headIn) : sink(std::move(sinkIn)), head(headIn)
+{
+}
+
+void JSONStreamWriter::separate()
+{
+    if (!written) {
+        buffer += head;
+        written = true;
+    }
+
+    if (!separators.empty()) {
+        if (separators.back()) buffer += ',';
+        separators.back() = true;
+    }
+}
+
+void JSONStreamWriter::flush()
+{
+    size += buffer.size();
+    flushed = true;
+    sink(buffer);
+    buffer.clear();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    separate();
+    buffer += '[';
+    separators.push_back(false);
+}
+
+void JSONStreamWriter::Push(const UniValue& value)
+{
+    separate();
+    buffer += value.write();
+    if (buffer.size() >= RPC_STREAM_CHUNK_SIZE) flush();
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!separators.empty());
+    buffer += ']';
+    separators.pop_back();
+}
+
+std::string JSONStreamWriter::Finish(const std::string& tail)
+{
+    assert(separators.empty());
+    buffer += tail;
+
+    if (!flushed) {
+        size += buffer.size();
+        std::string text;
+        text.swap(buffer);
+        return text;
+    }
+
+    flush();
+    return "";
+}
+
+RPCArrayResult::RPCArrayResult(const JSONRPCRequest& request) : stream(request.stream), result(UniValue::VARR)
+{
+    // Stream is for result of request itself
+    if (stream && stream->Written()) stream = nullptr;
+    if (stream) stream->BeginArray();
+}
+
+void RPCArrayResult::push_back(const UniValue& value)
+{
+    if (stream)
+        stream->Push(value);
+    else
+        result.push_back(value);
+}
+
+UniValue RPCArrayResult::get()
+{
+    if (!stream) return result;
+
+    stream->EndArray();
+    return NullUniValue;
+}
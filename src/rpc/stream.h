@@ -0,0 +1,79 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef POCKETCOIN_RPC_STREAM_H
+#define POCKETCOIN_RPC_STREAM_H
+
+#include <univalue.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class JSONRPCRequest;
+
+/** Size of text collected before it is passed to sink of stream */
+static const size_t RPC_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/*
+	JSON written part by part. Text is passed to sink by chunks of
+	RPC_STREAM_CHUNK_SIZE so whole value is never kept in memory.
+	Head is written before first value - for envelope of reply.
+	Sink can block while client reads and throw to interrupt writer.
+*/
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+private:
+    Sink sink;
+    std::string head;
+    std::string buffer;
+    // For every opened array - next element needs separator
+    std::vector<bool> separators;
+    bool written = false;
+    bool flushed = false;
+    size_t size = 0;
+
+    void separate();
+    void flush();
+
+public:
+    JSONStreamWriter(Sink sinkIn, const std::string& headIn);
+
+    void BeginArray();
+    void Push(const UniValue& value);
+    void EndArray();
+
+    // Something written
+    bool Written() const { return written; }
+    // Part of text passed to sink and can not be replaced
+    bool Flushed() const { return flushed; }
+    size_t Size() const { return size + buffer.size(); }
+
+    // Write tail. Whole text returned if nothing was passed to sink yet,
+    // otherwise rest of text passed to sink.
+    std::string Finish(const std::string& tail);
+};
+
+/*
+	Array result of RPC method. Elements are streamed to client when request
+	has stream, otherwise collected as usual.
+*/
+class RPCArrayResult
+{
+private:
+    JSONStreamWriter* stream;
+    UniValue result;
+
+public:
+    explicit RPCArrayResult(const JSONRPCRequest& request);
+
+    void push_back(const UniValue& value);
+    // Collected array or null if streamed
+    UniValue get();
+};
+
+#endif // POCKETCOIN_RPC_STREAM_H
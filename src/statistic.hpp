@@ -5,12 +5,19 @@
 #include "chainparams.h"
 #include "validation.h"
 #include <boost/thread.hpp>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <net.h>
 #include <numeric>
 #include <set>
+#include <shared_mutex>
+#include <unordered_map>
 #include "pocketdb/pocketdb.h"
 
 namespace Statistic
@@ -31,98 +38,254 @@ namespace Statistic
         RequestPayloadSize OutputSize;
     };
 
-    class RequestStatEngine
+    // Samples are rolled over in windows, history depth is STAT_WINDOWS * STAT_WINDOW_SECONDS
+    static constexpr int64_t STAT_WINDOW_SECONDS = 30;
+    static constexpr int STAT_WINDOWS = 120;
+    // Heaviest samples kept for every window
+    static constexpr std::size_t STAT_TOP_SAMPLES = 10;
+    // Source IPs listed in detail statistic for every window
+    static constexpr std::size_t STAT_DETAIL_IPS = 1000;
+    // Bits of window bitmap for count of unique source IPs
+    static constexpr std::size_t STAT_IP_BITS = 4096;
+    // New keys over limit are counted together
+    static constexpr std::size_t STAT_MAX_KEYS = 512;
+    static const RequestKey STAT_OTHER_KEY = "Other";
+    static const RequestKey STAT_WORKQUEUE_KEY = "WorkQueue::Enqueue";
+
+    /*
+        Latency histogram in milliseconds with fixed buckets:
+        exact values below 2^STAT_SUB_BITS, then 2^STAT_SUB_BITS linear buckets
+        for every power of two up to 2^STAT_MAX_BITS. Error is below 1/2^STAT_SUB_BITS.
+    */
+    static constexpr int STAT_SUB_BITS = 3;
+    static constexpr int STAT_MAX_BITS = 22;
+    static constexpr int STAT_BUCKETS = (STAT_MAX_BITS - STAT_SUB_BITS + 1) << STAT_SUB_BITS;
+
+    inline int HistogramBucket(uint64_t value)
     {
-    public:
-        RequestStatEngine() = default;
-        RequestStatEngine(const RequestStatEngine&) = delete;
-        RequestStatEngine(RequestStatEngine&&) = default;
+        value = std::min<uint64_t>(value, (uint64_t(1) << STAT_MAX_BITS) - 1);
+        if (value < (uint64_t(1) << STAT_SUB_BITS))
+            return (int) value;
 
-        void AddSample(const RequestSample& sample)
+        int msb = STAT_SUB_BITS;
+        while ((value >> (msb + 1)) != 0)
+            msb++;
+
+        int shift = msb - STAT_SUB_BITS;
+        return ((shift + 1) << STAT_SUB_BITS) + (int) ((value >> shift) - (uint64_t(1) << STAT_SUB_BITS));
+    }
+
+    // Highest value of bucket
+    inline uint64_t HistogramBucketValue(int bucket)
+    {
+        if (bucket < (1 << STAT_SUB_BITS))
+            return (uint64_t) bucket;
+
+        int shift = (bucket >> STAT_SUB_BITS) - 1;
+        uint64_t low = ((uint64_t) (bucket & ((1 << STAT_SUB_BITS) - 1)) + (uint64_t(1) << STAT_SUB_BITS)) << shift;
+        return low + (uint64_t(1) << shift) - 1;
+    }
+
+    // Merged histograms of windows - result of queries
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t> Buckets = std::vector<uint64_t>(STAT_BUCKETS, 0);
+        uint64_t Count = 0;
+        uint64_t Sum = 0;
+        uint64_t Max = 0;
+        uint64_t InputSize = 0;
+        uint64_t OutputSize = 0;
+
+        void Merge(const HistogramSnapshot& other)
         {
-            if (sample.TimestampEnd < sample.TimestampBegin)
-                return;
+            for (int i = 0; i < STAT_BUCKETS; i++)
+                Buckets[i] += other.Buckets[i];
+
+            Count += other.Count;
+            Sum += other.Sum;
+            Max = std::max(Max, other.Max);
+            InputSize += other.InputSize;
+            OutputSize += other.OutputSize;
+        }
 
-            LOCK(_samplesLock);
-            _samples.push_back(sample);
+        RequestTime Avg() const
+        {
+            return RequestTime(Count > 0 ? (int64_t) (Sum / Count) : 0);
         }
 
-        std::size_t GetNumSamples()
+        RequestTime Percentile(double p) const
         {
-            LOCK(_samplesLock);
-            return _samples.size();
+            if (Count == 0)
+                return {};
+
+            uint64_t rank = (uint64_t) std::ceil(p * (double) Count);
+            uint64_t seen = 0;
+            for (int i = 0; i < STAT_BUCKETS; i++)
+            {
+                seen += Buckets[i];
+                if (seen >= std::max<uint64_t>(rank, 1))
+                    return RequestTime((int64_t) std::min(HistogramBucketValue(i), Max));
+            }
+
+            return RequestTime((int64_t) Max);
         }
+    };
 
-        std::size_t GetNumSamplesBetween(RequestTime begin, RequestTime end)
+    // Histogram of one key for one window, written without locks
+    struct HistogramWindow
+    {
+        std::atomic<int64_t> Epoch{-1};
+        std::atomic<uint32_t> Buckets[STAT_BUCKETS];
+        std::atomic<uint64_t> Count{0};
+        std::atomic<uint64_t> Sum{0};
+        std::atomic<uint64_t> Max{0};
+        std::atomic<uint64_t> InputSize{0};
+        std::atomic<uint64_t> OutputSize{0};
+
+        HistogramWindow()
         {
-            LOCK(_samplesLock);
-            return std::count_if(
-                _samples.begin(),
-                _samples.end(),
-                [=](const RequestSample& sample)
-                {
-                    return sample.TimestampBegin >= begin && sample.TimestampEnd <= end;
-                });
+            for (auto& bucket : Buckets)
+                bucket.store(0, std::memory_order_relaxed);
         }
 
-        std::size_t GetNumSamplesBefore(RequestTime time)
+        void Clear()
         {
-            return GetNumSamplesBetween(RequestTime::min(), time);
+            for (auto& bucket : Buckets)
+                bucket.store(0, std::memory_order_relaxed);
+
+            Count.store(0, std::memory_order_relaxed);
+            Sum.store(0, std::memory_order_relaxed);
+            Max.store(0, std::memory_order_relaxed);
+            InputSize.store(0, std::memory_order_relaxed);
+            OutputSize.store(0, std::memory_order_relaxed);
         }
 
-        std::size_t GetNumSamplesSince(RequestTime time)
+        void Add(uint64_t value, const RequestSample& sample)
         {
-            return GetNumSamplesBetween(time, RequestTime::max());
+            Buckets[HistogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+            Count.fetch_add(1, std::memory_order_relaxed);
+            Sum.fetch_add(value, std::memory_order_relaxed);
+            InputSize.fetch_add(sample.InputSize, std::memory_order_relaxed);
+            OutputSize.fetch_add(sample.OutputSize, std::memory_order_relaxed);
+
+            uint64_t max = Max.load(std::memory_order_relaxed);
+            while (value > max && !Max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            {
+            }
         }
 
-        RequestTime GetAvgRequestTimeSince(RequestTime since)
+        void MergeTo(HistogramSnapshot& snapshot) const
         {
-            LOCK(_samplesLock);
+            for (int i = 0; i < STAT_BUCKETS; i++)
+                snapshot.Buckets[i] += Buckets[i].load(std::memory_order_relaxed);
+
+            snapshot.Count += Count.load(std::memory_order_relaxed);
+            snapshot.Sum += Sum.load(std::memory_order_relaxed);
+            snapshot.Max = std::max(snapshot.Max, Max.load(std::memory_order_relaxed));
+            snapshot.InputSize += InputSize.load(std::memory_order_relaxed);
+            snapshot.OutputSize += OutputSize.load(std::memory_order_relaxed);
+        }
+    };
 
-            if (_samples.empty())
-                return {};
+    // Windows ring of one key
+    struct KeyStat
+    {
+        HistogramWindow Windows[STAT_WINDOWS];
+        // Taken only for clear window on roll over
+        std::mutex RollLock;
+    };
 
-            RequestTime sum{};
-            std::size_t count{};
+    // Heaviest samples and source IPs of one window
+    struct SamplesWindow
+    {
+        std::atomic<int64_t> Epoch{-1};
+        std::mutex Lock;
 
-            for (auto& sample : _samples)
-            {
-                if (sample.TimestampBegin >= since && sample.Key != "WorkQueue::Enqueue")
-                {
-                    sum += sample.TimestampEnd - sample.TimestampBegin;
-                    count++;
-                }
-            }
+        // Min heaps by weight, lock taken only for samples heavier than heap top
+        std::vector<RequestSample> TopTime;
+        std::vector<RequestSample> TopInput;
+        std::vector<RequestSample> TopOutput;
+        std::atomic<uint64_t> TopTimeMin{0};
+        std::atomic<uint64_t> TopInputMin{0};
+        std::atomic<uint64_t> TopOutputMin{0};
 
-            if (count <= 0) return {};
-            return sum / count;
+        std::atomic<uint64_t> IPBits[STAT_IP_BITS / 64];
+        std::set<RequestIP> IPs;
+
+        SamplesWindow()
+        {
+            for (auto& bits : IPBits)
+                bits.store(0, std::memory_order_relaxed);
         }
+    };
 
-        int GetWorkQueueAvgCount(RequestTime since)
+    class RequestStatEngine
+    {
+    public:
+        RequestStatEngine() : _samples(new SamplesWindow[STAT_WINDOWS]) {}
+        RequestStatEngine(const RequestStatEngine&) = delete;
+
+        void AddSample(const RequestSample& sample)
         {
-            LOCK(_samplesLock);
+            if (sample.TimestampEnd < sample.TimestampBegin)
+                return;
 
-            if (_samples.empty())
-                return {};
+            int64_t epoch = GetEpoch(sample.TimestampBegin);
+            uint64_t time = (uint64_t) (sample.TimestampEnd - sample.TimestampBegin).count();
 
-            int count = 0;
-            for (auto& sample : _samples)
-            {
-                if (sample.TimestampBegin >= since && sample.Key == "WorkQueue::Enqueue")
-                    count++;
-            }
+            KeyStat& keyStat = GetKeyStat(sample.Key);
+            HistogramWindow& window = keyStat.Windows[epoch % STAT_WINDOWS];
+            if (RollWindow(window, keyStat.RollLock, epoch))
+                window.Add(time, sample);
+
+            if (sample.Key == STAT_WORKQUEUE_KEY)
+                return;
+
+            SamplesWindow& samplesWindow = _samples[epoch % STAT_WINDOWS];
+            if (RollWindow(samplesWindow, epoch))
+                AddToSamplesWindow(samplesWindow, time, sample);
+        }
+
+        std::size_t GetNumSamplesSince(RequestTime since)
+        {
+            auto snapshots = GetSnapshotsSince(since);
+
+            std::size_t count = 0;
+            for (auto& snapshot : snapshots)
+                if (snapshot.first != STAT_WORKQUEUE_KEY)
+                    count += snapshot.second.Count;
 
             return count;
         }
 
+        std::size_t GetNumSamples()
+        {
+            return GetNumSamplesSince(RequestTime::min());
+        }
+
+        RequestTime GetAvgRequestTimeSince(RequestTime since)
+        {
+            return GetRequestsSnapshotSince(since).Avg();
+        }
+
         RequestTime GetAvgRequestTime()
         {
             return GetAvgRequestTimeSince(RequestTime::min());
         }
 
+        int GetWorkQueueAvgCount(RequestTime since)
+        {
+            auto snapshots = GetSnapshotsSince(since);
+            auto it = snapshots.find(STAT_WORKQUEUE_KEY);
+            return it != snapshots.end() ? (int) it->second.Count : 0;
+        }
+
         std::vector<RequestSample> GetTopHeavyTimeSamplesSince(std::size_t limit, RequestTime since)
         {
-            return GetTopTimeSamplesImpl(limit, since);
+            return GetTopSamplesImpl(limit, since, &SamplesWindow::TopTime, [](const RequestSample& sample)
+            {
+                return (uint64_t) (sample.TimestampEnd - sample.TimestampBegin).count();
+            });
         }
 
         std::vector<RequestSample> GetTopHeavyTimeSamples(std::size_t limit)
@@ -132,7 +295,10 @@ namespace Statistic
 
         std::vector<RequestSample> GetTopHeavyInputSamplesSince(std::size_t limit, RequestTime since)
         {
-            return GetTopSizeSamplesImpl(limit, &RequestSample::InputSize, since);
+            return GetTopSamplesImpl(limit, since, &SamplesWindow::TopInput, [](const RequestSample& sample)
+            {
+                return (uint64_t) sample.InputSize;
+            });
         }
 
         std::vector<RequestSample> GetTopHeavyInputSamples(std::size_t limit)
@@ -142,7 +308,10 @@ namespace Statistic
 
         std::vector<RequestSample> GetTopHeavyOutputSamplesSince(std::size_t limit, RequestTime since)
         {
-            return GetTopSizeSamplesImpl(limit, &RequestSample::OutputSize, since);
+            return GetTopSamplesImpl(limit, since, &SamplesWindow::TopOutput, [](const RequestSample& sample)
+            {
+                return (uint64_t) sample.OutputSize;
+            });
         }
 
         std::vector<RequestSample> GetTopHeavyOutputSamples(std::size_t limit)
@@ -150,14 +319,15 @@ namespace Statistic
             return GetTopHeavyOutputSamplesSince(limit, RequestTime::min());
         }
 
+        // Listed only with statdetail logging, limited by STAT_DETAIL_IPS for window
         std::set<RequestIP> GetUniqueSourceIPsSince(RequestTime since)
         {
             std::set<RequestIP> result{};
 
-            LOCK(_samplesLock);
-            for (auto& sample : _samples)
-                if (sample.TimestampBegin >= since)
-                    result.insert(sample.SourceIP);
+            ForEachSamplesWindowSince(since, [&result](SamplesWindow& window)
+            {
+                result.insert(window.IPs.begin(), window.IPs.end());
+            });
 
             return result;
         }
@@ -167,6 +337,29 @@ namespace Statistic
             return GetUniqueSourceIPsSince(RequestTime::min());
         }
 
+        // Estimated by linear counting of merged windows bitmaps
+        std::size_t GetNumUniqueSourceIPsSince(RequestTime since)
+        {
+            std::vector<uint64_t> bits(STAT_IP_BITS / 64, 0);
+
+            ForEachSamplesWindowSince(since, [&bits](SamplesWindow& window)
+            {
+                for (std::size_t i = 0; i < bits.size(); i++)
+                    bits[i] |= window.IPBits[i].load(std::memory_order_relaxed);
+            });
+
+            std::size_t zeros = 0;
+            for (auto word : bits)
+                for (int i = 0; i < 64; i++)
+                    if (((word >> i) & 1) == 0)
+                        zeros++;
+
+            if (zeros == 0)
+                zeros = 1;
+
+            return (std::size_t) std::llround((double) STAT_IP_BITS * std::log((double) STAT_IP_BITS / (double) zeros));
+        }
+
         UniValue CompileStatsAsJsonSince(RequestTime since)
         {
             UniValue result{UniValue::VOBJ};
@@ -192,10 +385,9 @@ namespace Statistic
             UniValue top_in_json{UniValue::VARR};
             UniValue top_out_json{UniValue::VARR};
 
-            auto unique_ips = GetUniqueSourceIPsSince(since);
-            auto unique_ips_count = unique_ips.size();
             if (g_logger->WillLogCategory(BCLog::STATDETAIL))
             {
+                auto unique_ips = GetUniqueSourceIPsSince(since);
                 auto top_tm = GetTopHeavyTimeSamplesSince(top_limit, since);
                 auto top_in = GetTopHeavyInputSamplesSince(top_limit, since);
                 auto top_out = GetTopHeavyOutputSamplesSince(top_limit, since);
@@ -223,16 +415,24 @@ namespace Statistic
             result.pushKV("General", chainStat);
 
             UniValue sync(UniValue::VOBJ);
-            sync.pushKV("CacheItems", (int64_t) POCKETNET_DATA.size());
-            int64_t cacheSize = 0;
-            for (auto& it : POCKETNET_DATA) cacheSize += it.first.size() + it.second.size();
-            sync.pushKV("CacheSize", cacheSize);
+            sync.pushKV("CacheItems", (int64_t) POCKETNET_DATA.Size());
+            sync.pushKV("CacheSize", (int64_t) POCKETNET_DATA.DynamicMemoryUsage());
             result.pushKV("Sync", sync);
 
+            auto snapshots = GetSnapshotsSince(since);
+            HistogramSnapshot requests;
+            for (auto& snapshot : snapshots)
+                if (snapshot.first != STAT_WORKQUEUE_KEY)
+                    requests.Merge(snapshot.second);
+
             UniValue rpcStat(UniValue::VOBJ);
-            rpcStat.pushKV("Requests", (int) GetNumSamplesSince(since));
-            rpcStat.pushKV("AvgReqTime", GetAvgRequestTimeSince(since).count());
-            rpcStat.pushKV("UniqueIPs", (int) unique_ips_count);
+            rpcStat.pushKV("Requests", (int64_t) requests.Count);
+            rpcStat.pushKV("AvgReqTime", requests.Avg().count());
+            rpcStat.pushKV("P50ReqTime", requests.Percentile(0.50).count());
+            rpcStat.pushKV("P95ReqTime", requests.Percentile(0.95).count());
+            rpcStat.pushKV("P99ReqTime", requests.Percentile(0.99).count());
+            rpcStat.pushKV("MaxReqTime", (int64_t) requests.Max);
+            rpcStat.pushKV("UniqueIPs", (int) GetNumUniqueSourceIPsSince(since));
             if (g_logger->WillLogCategory(BCLog::STATDETAIL))
             {
                 rpcStat.pushKV("UniqueIps", unique_ips_json);
@@ -250,6 +450,32 @@ namespace Statistic
             return CompileStatsAsJsonSince(RequestTime::min());
         }
 
+        // Latency percentiles for every method
+        UniValue CompileMethodsStatsAsJsonSince(RequestTime since)
+        {
+            UniValue result{UniValue::VOBJ};
+
+            auto snapshots = GetSnapshotsSince(since);
+            for (auto& snapshot : snapshots)
+            {
+                if (snapshot.second.Count == 0)
+                    continue;
+
+                UniValue method{UniValue::VOBJ};
+                method.pushKV("Requests", (int64_t) snapshot.second.Count);
+                method.pushKV("AvgReqTime", snapshot.second.Avg().count());
+                method.pushKV("P50ReqTime", snapshot.second.Percentile(0.50).count());
+                method.pushKV("P95ReqTime", snapshot.second.Percentile(0.95).count());
+                method.pushKV("P99ReqTime", snapshot.second.Percentile(0.99).count());
+                method.pushKV("MaxReqTime", (int64_t) snapshot.second.Max);
+                method.pushKV("InputSize", (int64_t) snapshot.second.InputSize);
+                method.pushKV("OutputSize", (int64_t) snapshot.second.OutputSize);
+                result.pushKV(snapshot.first, method);
+            }
+
+            return result;
+        }
+
         // Just a helper to prevent copypasta
         RequestTime GetCurrentSystemTime()
         {
@@ -281,92 +507,223 @@ namespace Statistic
                 LogPrint(BCLog::STATDETAIL, msg.c_str(), statLoggerSleep / 1000,
                     CompileStatsAsJsonSince(chunkSize).write(1));
 
-                RemoveSamplesBefore(chunkSize);
                 MilliSleep(statLoggerSleep);
             }
         }
 
     private:
-        std::vector<RequestSample> _samples;
-        Mutex _samplesLock;
+        std::unordered_map<RequestKey, std::unique_ptr<KeyStat>> _keys;
+        std::shared_mutex _keysLock;
+        std::unique_ptr<SamplesWindow[]> _samples;
         bool shutdown = false;
 
-        void RemoveSamplesBefore(RequestTime time)
+        static int64_t GetEpoch(RequestTime time)
         {
-            LOCK(_samplesLock);
-            int64_t sizeBefore = _samples.size();
+            return std::max<int64_t>(0, time.count() / (STAT_WINDOW_SECONDS * 1000));
+        }
 
-            _samples.erase(
-                std::remove_if(
-                    _samples.begin(),
-                    _samples.end(),
-                    [time](const RequestSample& sample)
-                    {
-                        return sample.TimestampBegin < time;
-                    }),
-                _samples.end());
+        // Windows in ring not older than since
+        int64_t GetFirstEpoch(RequestTime since)
+        {
+            int64_t last = GetEpoch(GetCurrentSystemTime());
+            int64_t first = since <= RequestTime(0) ? 0 : GetEpoch(since);
+            return std::max<int64_t>(first, last - STAT_WINDOWS + 1);
+        }
 
-            LogPrint(BCLog::STAT, "Clear statistic cache: %d -> %d items after.\n", sizeBefore, _samples.size());
+        KeyStat& GetKeyStat(const RequestKey& key)
+        {
+            {
+                std::shared_lock<std::shared_mutex> lock(_keysLock);
+                auto it = _keys.find(key);
+                if (it != _keys.end())
+                    return *it->second;
+            }
+
+            std::unique_lock<std::shared_mutex> lock(_keysLock);
+            auto it = _keys.find(key);
+            if (it != _keys.end())
+                return *it->second;
+
+            const RequestKey& newKey = _keys.size() < STAT_MAX_KEYS ? key : STAT_OTHER_KEY;
+            auto& keyStat = _keys[newKey];
+            if (!keyStat)
+                keyStat.reset(new KeyStat());
+
+            return *keyStat;
         }
 
-        std::vector<RequestSample>
-        GetTopSizeSamplesImpl(std::size_t limit, RequestPayloadSize RequestSample::*size_field, RequestTime since)
+        // Clear window left from previous round of ring. False for sample older than window.
+        static bool RollWindow(HistogramWindow& window, std::mutex& rollLock, int64_t epoch)
         {
-            LOCK(_samplesLock);
-            auto samples_copy = _samples;
+            int64_t current = window.Epoch.load(std::memory_order_acquire);
+            if (current == epoch)
+                return true;
+            if (current > epoch)
+                return false;
+
+            std::lock_guard<std::mutex> lock(rollLock);
+            current = window.Epoch.load(std::memory_order_acquire);
+            if (current < epoch)
+            {
+                window.Clear();
+                window.Epoch.store(epoch, std::memory_order_release);
+            }
 
-            samples_copy.erase(
-                std::remove_if(
-                    samples_copy.begin(),
-                    samples_copy.end(),
-                    [since](const RequestSample& sample)
-                    {
-                        return sample.TimestampBegin < since;
-                    }),
-                samples_copy.end());
+            return window.Epoch.load(std::memory_order_acquire) == epoch;
+        }
 
-            std::sort(
-                samples_copy.begin(),
-                samples_copy.end(),
-                [limit, size_field](const RequestSample& left, const RequestSample& right)
+        static bool RollWindow(SamplesWindow& window, int64_t epoch)
+        {
+            int64_t current = window.Epoch.load(std::memory_order_acquire);
+            if (current == epoch)
+                return true;
+            if (current > epoch)
+                return false;
+
+            std::lock_guard<std::mutex> lock(window.Lock);
+            current = window.Epoch.load(std::memory_order_acquire);
+            if (current < epoch)
+            {
+                window.TopTime.clear();
+                window.TopInput.clear();
+                window.TopOutput.clear();
+                window.TopTimeMin.store(0, std::memory_order_relaxed);
+                window.TopInputMin.store(0, std::memory_order_relaxed);
+                window.TopOutputMin.store(0, std::memory_order_relaxed);
+                for (auto& bits : window.IPBits)
+                    bits.store(0, std::memory_order_relaxed);
+                window.IPs.clear();
+                window.Epoch.store(epoch, std::memory_order_release);
+            }
+
+            return window.Epoch.load(std::memory_order_acquire) == epoch;
+        }
+
+        template <typename Weight>
+        static void PushTopSample(std::vector<RequestSample>& heap, std::atomic<uint64_t>& heapMin, const RequestSample& sample, Weight weight)
+        {
+            auto greater = [&weight](const RequestSample& left, const RequestSample& right)
+            {
+                return weight(left) > weight(right);
+            };
+
+            if (heap.size() < STAT_TOP_SAMPLES)
+            {
+                heap.push_back(sample);
+                std::push_heap(heap.begin(), heap.end(), greater);
+            }
+            else if (weight(sample) > weight(heap.front()))
+            {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                heap.back() = sample;
+                std::push_heap(heap.begin(), heap.end(), greater);
+            }
+
+            if (heap.size() >= STAT_TOP_SAMPLES)
+                heapMin.store(weight(heap.front()), std::memory_order_relaxed);
+        }
+
+        static void AddToSamplesWindow(SamplesWindow& window, uint64_t time, const RequestSample& sample)
+        {
+            std::size_t ipBit = std::hash<RequestIP>{}(sample.SourceIP) % STAT_IP_BITS;
+            window.IPBits[ipBit / 64].fetch_or(uint64_t(1) << (ipBit % 64), std::memory_order_relaxed);
+
+            bool detail = g_logger->WillLogCategory(BCLog::STATDETAIL);
+            bool topTime = time >= window.TopTimeMin.load(std::memory_order_relaxed);
+            bool topInput = sample.InputSize >= window.TopInputMin.load(std::memory_order_relaxed);
+            bool topOutput = sample.OutputSize >= window.TopOutputMin.load(std::memory_order_relaxed);
+            if (!detail && !topTime && !topInput && !topOutput)
+                return;
+
+            std::lock_guard<std::mutex> lock(window.Lock);
+
+            if (detail && window.IPs.size() < STAT_DETAIL_IPS)
+                window.IPs.insert(sample.SourceIP);
+
+            if (topTime)
+                PushTopSample(window.TopTime, window.TopTimeMin, sample, [](const RequestSample& s)
+                {
+                    return (uint64_t) (s.TimestampEnd - s.TimestampBegin).count();
+                });
+
+            if (topInput)
+                PushTopSample(window.TopInput, window.TopInputMin, sample, [](const RequestSample& s)
                 {
-                    return left.*size_field > right.*size_field;
+                    return (uint64_t) s.InputSize;
                 });
 
-            if (samples_copy.size() > limit)
-                samples_copy.resize(limit);
+            if (topOutput)
+                PushTopSample(window.TopOutput, window.TopOutputMin, sample, [](const RequestSample& s)
+                {
+                    return (uint64_t) s.OutputSize;
+                });
+        }
+
+        // Histograms of every key merged over windows since time
+        std::map<RequestKey, HistogramSnapshot> GetSnapshotsSince(RequestTime since)
+        {
+            std::map<RequestKey, HistogramSnapshot> result;
+            int64_t first = GetFirstEpoch(since);
+
+            std::shared_lock<std::shared_mutex> lock(_keysLock);
+            for (auto& key : _keys)
+            {
+                HistogramSnapshot& snapshot = result[key.first];
+                for (auto& window : key.second->Windows)
+                {
+                    if (window.Epoch.load(std::memory_order_acquire) >= first)
+                        window.MergeTo(snapshot);
+                }
+            }
 
-            return samples_copy;
+            return result;
         }
 
-        std::vector<RequestSample> GetTopTimeSamplesImpl(std::size_t limit, RequestTime since)
+        HistogramSnapshot GetRequestsSnapshotSince(RequestTime since)
         {
-            LOCK(_samplesLock);
-            auto samples_copy = _samples;
+            HistogramSnapshot result;
+            for (auto& snapshot : GetSnapshotsSince(since))
+                if (snapshot.first != STAT_WORKQUEUE_KEY)
+                    result.Merge(snapshot.second);
 
-            samples_copy.erase(
-                std::remove_if(
-                    samples_copy.begin(),
-                    samples_copy.end(),
-                    [since](const RequestSample& sample)
-                    {
-                        return sample.TimestampBegin < since;
-                    }),
-                samples_copy.end());
+            return result;
+        }
+
+        void ForEachSamplesWindowSince(RequestTime since, const std::function<void(SamplesWindow&)>& func)
+        {
+            int64_t first = GetFirstEpoch(since);
+            for (int i = 0; i < STAT_WINDOWS; i++)
+            {
+                SamplesWindow& window = _samples[i];
+                std::lock_guard<std::mutex> lock(window.Lock);
+                if (window.Epoch.load(std::memory_order_acquire) >= first)
+                    func(window);
+            }
+        }
+
+        template <typename Weight>
+        std::vector<RequestSample> GetTopSamplesImpl(std::size_t limit, RequestTime since, std::vector<RequestSample> SamplesWindow::*heap, Weight weight)
+        {
+            std::vector<RequestSample> result;
+
+            ForEachSamplesWindowSince(since, [&result, heap](SamplesWindow& window)
+            {
+                result.insert(result.end(), (window.*heap).begin(), (window.*heap).end());
+            });
 
             std::sort(
-                samples_copy.begin(),
-                samples_copy.end(),
-                [limit](const RequestSample& left, const RequestSample& right)
+                result.begin(),
+                result.end(),
+                [&weight](const RequestSample& left, const RequestSample& right)
                 {
-                    return left.TimestampEnd - left.TimestampBegin > right.TimestampEnd - right.TimestampBegin;
+                    return weight(left) > weight(right);
                 });
 
-            if (samples_copy.size() > limit)
-                samples_copy.resize(limit);
+            if (result.size() > limit)
+                result.resize(limit);
 
-            return samples_copy;
+            return result;
         }
     };
 
-} // namespace Statistic
\ No newline at end of file
+} // namespace Statistic
@@ -0,0 +1,153 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/server.h>
+#include <rpc/stream.h>
+
+#include <test/test_pocketcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+static const std::string HEAD = "{\"result\":";
+static const std::string TAIL = ",\"error\":null,\"id\":1}";
+
+// Elements of array streamed one by one, text of sink and Finish joined
+static std::string StreamArray(const UniValue& array, size_t* sinkCalls = nullptr)
+{
+    std::string text;
+    size_t calls = 0;
+    JSONStreamWriter writer([&](const std::string& chunk) {
+        text += chunk;
+        calls++;
+    }, HEAD);
+
+    writer.BeginArray();
+    for (size_t i = 0; i < array.size(); i++)
+        writer.Push(array[i]);
+    writer.EndArray();
+    text += writer.Finish(TAIL);
+
+    BOOST_CHECK_EQUAL(writer.Size(), text.size());
+    if (sinkCalls) *sinkCalls = calls;
+    return text;
+}
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(jsonstream_escapes)
+{
+    UniValue array(UniValue::VARR);
+    array.push_back("quote \" backslash \\ slash /");
+    array.push_back("control \n\r\t\b\f \x01 \x1f");
+    array.push_back("utf8 \xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82");
+    array.push_back("");
+    array.push_back(-12345);
+    array.push_back(1.5);
+    array.push_back(true);
+    array.push_back(NullUniValue);
+
+    BOOST_CHECK_EQUAL(StreamArray(array), HEAD + array.write() + TAIL);
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_nesting)
+{
+    UniValue inner(UniValue::VARR);
+    inner.push_back("a");
+    inner.push_back(UniValue(UniValue::VARR));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("key \"q\"", "value");
+    obj.pushKV("list", inner);
+    obj.pushKV("empty", UniValue(UniValue::VOBJ));
+
+    UniValue array(UniValue::VARR);
+    array.push_back(obj);
+    array.push_back(inner);
+    array.push_back(UniValue(UniValue::VARR));
+
+    BOOST_CHECK_EQUAL(StreamArray(array), HEAD + array.write() + TAIL);
+
+    // Nested arrays opened on writer
+    std::string text;
+    JSONStreamWriter writer([&](const std::string& chunk) { text += chunk; }, HEAD);
+    writer.BeginArray();
+    writer.BeginArray();
+    writer.Push("a");
+    writer.EndArray();
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Push(obj);
+    writer.EndArray();
+    text += writer.Finish(TAIL);
+
+    UniValue expected(UniValue::VARR);
+    UniValue first(UniValue::VARR);
+    first.push_back("a");
+    expected.push_back(first);
+    expected.push_back(UniValue(UniValue::VARR));
+    expected.push_back(obj);
+    BOOST_CHECK_EQUAL(text, HEAD + expected.write() + TAIL);
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_empty)
+{
+    UniValue array(UniValue::VARR);
+    size_t calls = 0;
+    BOOST_CHECK_EQUAL(StreamArray(array, &calls), HEAD + "[]" + TAIL);
+    // Small result returned whole - reply can still be replaced
+    BOOST_CHECK_EQUAL(calls, 0U);
+
+    // Nothing written - head is not written either
+    JSONStreamWriter writer([](const std::string&) {}, HEAD);
+    BOOST_CHECK(!writer.Written());
+    BOOST_CHECK_EQUAL(writer.Finish(TAIL), TAIL);
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_chunks)
+{
+    UniValue array(UniValue::VARR);
+    std::string big(1000, 'x');
+    for (size_t i = 0; i < 3 * RPC_STREAM_CHUNK_SIZE / big.size(); i++) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("i", (int64_t)i);
+        obj.pushKV("text", big + "\"");
+        array.push_back(obj);
+    }
+
+    size_t calls = 0;
+    BOOST_CHECK_EQUAL(StreamArray(array, &calls), HEAD + array.write() + TAIL);
+    BOOST_CHECK(calls >= 3);
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_array_result)
+{
+    UniValue array(UniValue::VARR);
+    array.push_back("a");
+    array.push_back(1);
+
+    // Without stream elements are collected
+    JSONRPCRequest request;
+    RPCArrayResult collected(request);
+    for (size_t i = 0; i < array.size(); i++)
+        collected.push_back(array[i]);
+    BOOST_CHECK_EQUAL(collected.get().write(), array.write());
+
+    // With stream elements are written and result is null
+    std::string text;
+    JSONStreamWriter writer([&](const std::string& chunk) { text += chunk; }, HEAD);
+    request.stream = &writer;
+    RPCArrayResult streamed(request);
+    for (size_t i = 0; i < array.size(); i++)
+        streamed.push_back(array[i]);
+    BOOST_CHECK(streamed.get().isNull());
+    text += writer.Finish(TAIL);
+    BOOST_CHECK_EQUAL(text, HEAD + array.write() + TAIL);
+
+    // Stream already used by request - nested result is collected
+    RPCArrayResult nested(request);
+    nested.push_back("b");
+    BOOST_CHECK_EQUAL(nested.get().write(), "[\"b\"]");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
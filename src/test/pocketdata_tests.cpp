@@ -0,0 +1,105 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addrindex.h>
+#include <streams.h>
+#include <version.h>
+
+#include <test/test_pocketcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+// Stream versions of replies: TX and BLOCK messages carry witness flag
+static const std::vector<int> LEGACY_VERSIONS = {
+    POCKET_DATA_BINARY_VERSION - 1,
+    (POCKET_DATA_BINARY_VERSION - 1) | SERIALIZE_TRANSACTION_NO_WITNESS,
+};
+static const std::vector<int> BINARY_VERSIONS = {
+    POCKET_DATA_BINARY_VERSION,
+    POCKET_DATA_BINARY_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS,
+};
+
+static PocketTxData MakeTxData(const std::string& table, const std::string& data)
+{
+    PocketTxData txData;
+    txData.table = table;
+    txData.data = data;
+    return txData;
+}
+
+BOOST_FIXTURE_TEST_SUITE(pocketdata_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pocketdata_tx)
+{
+    PocketTxData txData = MakeTxData("Posts", "{\"txid\":\"a\",\"caption\":\"\\u0442\"}");
+
+    for (bool binary : {false, true}) {
+        for (int version : binary ? BINARY_VERSIONS : LEGACY_VERSIONS) {
+            CDataStream ss(SER_NETWORK, version);
+            ss << WrapPocketData(txData);
+
+            // Format chosen by peer version only
+            CDataStream expected(SER_NETWORK, version);
+            if (binary)
+                expected << txData;
+            else
+                expected << AddrIndex::EncodeTXRIData(txData);
+            BOOST_CHECK(ss.str() == expected.str());
+
+            PocketTxData read;
+            ss >> WrapPocketData(read);
+            BOOST_CHECK(ss.empty());
+            BOOST_CHECK_EQUAL(read.table, txData.table);
+            BOOST_CHECK_EQUAL(read.data, txData.data);
+        }
+    }
+
+    // Transaction without data is empty string for legacy peers
+    PocketTxData empty;
+    CDataStream ss(SER_NETWORK, LEGACY_VERSIONS[1]);
+    ss << WrapPocketData(empty);
+    CDataStream expected(SER_NETWORK, LEGACY_VERSIONS[1]);
+    expected << std::string();
+    BOOST_CHECK(ss.str() == expected.str());
+}
+
+BOOST_AUTO_TEST_CASE(pocketdata_block)
+{
+    PocketBlockData blockData;
+    blockData.emplace(uint256S("01"), MakeTxData("Posts", "{\"txid\":\"01\"}"));
+    blockData.emplace(uint256S("02"), MakeTxData("Scores", "{\"txid\":\"02\",\"value\":5}"));
+
+    for (bool binary : {false, true}) {
+        for (int version : binary ? BINARY_VERSIONS : LEGACY_VERSIONS) {
+            CDataStream ss(SER_NETWORK, version);
+            ss << WrapPocketData(blockData);
+
+            CDataStream expected(SER_NETWORK, version);
+            if (binary)
+                expected << blockData;
+            else
+                expected << AddrIndex::EncodeBlockRIData(blockData);
+            BOOST_CHECK(ss.str() == expected.str());
+
+            PocketBlockData read;
+            ss >> WrapPocketData(read);
+            BOOST_CHECK(ss.empty());
+            BOOST_CHECK_EQUAL(read.size(), blockData.size());
+            for (const auto& it : blockData) {
+                BOOST_CHECK(read.count(it.first));
+                BOOST_CHECK_EQUAL(read[it.first].table, it.second.table);
+                BOOST_CHECK_EQUAL(read[it.first].data, it.second.data);
+            }
+        }
+    }
+
+    // Undecodable legacy data is dropped
+    CDataStream ss(SER_NETWORK, LEGACY_VERSIONS[1]);
+    ss << std::string("not json");
+    PocketBlockData read;
+    ss >> WrapPocketData(read);
+    BOOST_CHECK(read.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
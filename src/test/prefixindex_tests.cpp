@@ -0,0 +1,153 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pocketdb/prefixindex.h>
+
+#include <test/test_pocketcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+typedef std::vector<std::pair<std::string, int64_t>> Completions;
+
+static std::vector<std::string> Keys(const Completions& completions)
+{
+    std::vector<std::string> keys;
+    for (const auto& completion : completions)
+        keys.push_back(completion.first);
+    return keys;
+}
+
+BOOST_FIXTURE_TEST_SUITE(prefixindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(prefixindex_mid_label)
+{
+    PrefixIndex index;
+    index.Set("abcdef", 1);
+    index.Set("abcxyz", 2);
+
+    size_t total = 0;
+
+    // Prefix ends inside edge label of split node
+    BOOST_CHECK(Keys(index.Complete("ab", 10, total)) == std::vector<std::string>({"abcxyz", "abcdef"}));
+    BOOST_CHECK_EQUAL(total, 2U);
+
+    // Prefix ends inside edge label of leaf
+    BOOST_CHECK(Keys(index.Complete("abcd", 10, total)) == std::vector<std::string>({"abcdef"}));
+    BOOST_CHECK_EQUAL(total, 1U);
+    BOOST_CHECK_EQUAL(index.Complete("abcd", 10, total)[0].second, 1);
+
+    // Prefix leaves label or runs past key
+    BOOST_CHECK(index.Complete("abd", 10, total).empty());
+    BOOST_CHECK_EQUAL(total, 0U);
+    BOOST_CHECK(index.Complete("abcdefg", 10, total).empty());
+    BOOST_CHECK_EQUAL(total, 0U);
+
+    // Inner node is not a key
+    int64_t weight = 0;
+    BOOST_CHECK(!index.Get("abc", weight));
+    BOOST_CHECK(!index.Erase("abc"));
+    BOOST_CHECK_EQUAL(index.Size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(prefixindex_erase_merge)
+{
+    PrefixIndex index;
+    index.Set("ab", 3);
+    index.Set("abc", 2);
+    index.Set("abd", 1);
+    BOOST_CHECK_EQUAL(index.Size(), 3U);
+
+    // Leaf dropped, parent is key - kept
+    BOOST_CHECK(index.Erase("abc"));
+    BOOST_CHECK(!index.Erase("abc"));
+    BOOST_CHECK_EQUAL(index.Size(), 2U);
+
+    // Parent not a key any more with one child - merged into it
+    BOOST_CHECK(index.Erase("ab"));
+    BOOST_CHECK_EQUAL(index.Size(), 1U);
+
+    int64_t weight = 0;
+    BOOST_CHECK(!index.Get("ab", weight));
+    BOOST_CHECK(index.Get("abd", weight));
+    BOOST_CHECK_EQUAL(weight, 1);
+
+    size_t total = 0;
+    BOOST_CHECK(Keys(index.Complete("a", 10, total)) == std::vector<std::string>({"abd"}));
+    BOOST_CHECK_EQUAL(total, 1U);
+    BOOST_CHECK(Keys(index.Complete("abd", 10, total)) == std::vector<std::string>({"abd"}));
+
+    // Best weight of subtree recounted after merge
+    BOOST_CHECK_EQUAL(index.Complete("", 10, total)[0].second, 1);
+
+    // Merged node split again
+    index.Set("ab", 5);
+    BOOST_CHECK(Keys(index.Complete("a", 10, total)) == std::vector<std::string>({"ab", "abd"}));
+    BOOST_CHECK_EQUAL(total, 2U);
+
+    // Last key erased - index empty
+    BOOST_CHECK(index.Erase("ab"));
+    BOOST_CHECK(index.Erase("abd"));
+    BOOST_CHECK_EQUAL(index.Size(), 0U);
+    BOOST_CHECK(index.Complete("", 10, total).empty());
+    BOOST_CHECK_EQUAL(total, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(prefixindex_weight_ties)
+{
+    PrefixIndex index;
+    index.Set("b", 5);
+    index.Set("a", 5);
+    index.Set("c", 5);
+    index.Set("d", 7);
+    index.Set("ca", 5);
+
+    // Equal weights sorted by key
+    size_t total = 0;
+    BOOST_CHECK(Keys(index.Complete("", 10, total)) == std::vector<std::string>({"d", "a", "b", "c", "ca"}));
+    BOOST_CHECK(Keys(index.Complete("", 3, total)) == std::vector<std::string>({"d", "a", "b"}));
+
+    // Weight replaced
+    index.Set("d", 5);
+    index.Set("ca", 6);
+    BOOST_CHECK(Keys(index.Complete("", 10, total)) == std::vector<std::string>({"ca", "a", "b", "c", "d"}));
+    BOOST_CHECK(Keys(index.Complete("c", 10, total)) == std::vector<std::string>({"ca", "c"}));
+}
+
+BOOST_AUTO_TEST_CASE(prefixindex_total)
+{
+    PrefixIndex index;
+    for (int i = 0; i < 100; i++)
+        index.Set("tag" + std::to_string(i), i);
+    index.Set("other", 1000);
+
+    // Total counts all keys of prefix, not only returned
+    size_t total = 0;
+    Completions completions = index.Complete("tag", 5, total);
+    BOOST_CHECK_EQUAL(completions.size(), 5U);
+    BOOST_CHECK_EQUAL(total, 100U);
+    BOOST_CHECK_EQUAL(completions[0].first, "tag99");
+    BOOST_CHECK_EQUAL(completions[4].first, "tag95");
+
+    BOOST_CHECK(index.Complete("tag", 0, total).empty());
+    BOOST_CHECK_EQUAL(total, 100U);
+
+    index.Complete("tag1", 100, total);
+    BOOST_CHECK_EQUAL(total, 11U);
+
+    index.Complete("", 1, total);
+    BOOST_CHECK_EQUAL(total, 101U);
+    BOOST_CHECK_EQUAL(total, index.Size());
+
+    // Replaced key not counted twice
+    index.Set("tag1", 50);
+    index.Complete("tag", 1, total);
+    BOOST_CHECK_EQUAL(total, 100U);
+
+    index.Clear();
+    BOOST_CHECK_EQUAL(index.Size(), 0U);
+    BOOST_CHECK(index.Complete("tag", 5, total).empty());
+    BOOST_CHECK_EQUAL(total, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,157 @@
+// Copyright (c) 2019-2021 The Pocketcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <statistic.hpp>
+
+#include <test/test_pocketcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace Statistic;
+
+static RequestTime EpochStart(int64_t epoch)
+{
+    return RequestTime(epoch * STAT_WINDOW_SECONDS * 1000);
+}
+
+static RequestSample MakeSample(const RequestKey& key, RequestTime begin, int64_t duration, const RequestIP& ip = "127.0.0.1")
+{
+    return {key, begin, begin + RequestTime(duration), ip, 10, 20};
+}
+
+BOOST_FIXTURE_TEST_SUITE(statistic_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(histogram_buckets)
+{
+    // Exact values below 2^STAT_SUB_BITS
+    for (uint64_t value = 0; value < (1 << STAT_SUB_BITS); value++) {
+        BOOST_CHECK_EQUAL(HistogramBucket(value), (int)value);
+        BOOST_CHECK_EQUAL(HistogramBucketValue((int)value), value);
+    }
+
+    // Bucket holds value and error is below 1/2^STAT_SUB_BITS
+    int prev = 0;
+    for (uint64_t value = 1; value < (uint64_t(1) << STAT_MAX_BITS); value = value * 3 / 2 + 1) {
+        int bucket = HistogramBucket(value);
+        BOOST_CHECK(bucket >= prev);
+        BOOST_CHECK(bucket < STAT_BUCKETS);
+        BOOST_CHECK(HistogramBucketValue(bucket) >= value);
+        BOOST_CHECK((HistogramBucketValue(bucket) - value) * (1 << STAT_SUB_BITS) <= value);
+        if (bucket > 0) BOOST_CHECK(HistogramBucketValue(bucket - 1) < value);
+        prev = bucket;
+    }
+
+    // Values above range go to last bucket
+    BOOST_CHECK_EQUAL(HistogramBucket(uint64_t(1) << 40), STAT_BUCKETS - 1);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_percentile)
+{
+    RequestSample sample = MakeSample("test", RequestTime(0), 0);
+
+    HistogramSnapshot empty;
+    BOOST_CHECK_EQUAL(empty.Percentile(0.5).count(), 0);
+    BOOST_CHECK_EQUAL(empty.Avg().count(), 0);
+
+    HistogramWindow window;
+    for (uint64_t value = 1; value <= 1000; value++)
+        window.Add(value, sample);
+
+    HistogramSnapshot snapshot;
+    window.MergeTo(snapshot);
+    BOOST_CHECK_EQUAL(snapshot.Count, 1000U);
+    BOOST_CHECK_EQUAL(snapshot.Max, 1000U);
+    BOOST_CHECK_EQUAL(snapshot.Avg().count(), 500);
+    BOOST_CHECK_EQUAL(snapshot.InputSize, 10000U);
+    BOOST_CHECK_EQUAL(snapshot.OutputSize, 20000U);
+
+    // Percentile is upper value of bucket - not below exact, within bucket error
+    for (double p : {0.01, 0.5, 0.95, 0.99}) {
+        int64_t exact = (int64_t)std::ceil(p * 1000);
+        int64_t estimated = snapshot.Percentile(p).count();
+        BOOST_CHECK(estimated >= exact);
+        BOOST_CHECK((estimated - exact) * (1 << STAT_SUB_BITS) <= exact);
+    }
+
+    // Top percentile is capped by max
+    BOOST_CHECK_EQUAL(snapshot.Percentile(1.0).count(), 1000);
+
+    // Merge of windows sums counts
+    HistogramSnapshot merged;
+    merged.Merge(snapshot);
+    merged.Merge(snapshot);
+    BOOST_CHECK_EQUAL(merged.Count, 2000U);
+    BOOST_CHECK_EQUAL(merged.Percentile(0.5).count(), snapshot.Percentile(0.5).count());
+
+    // Exact values for small latencies
+    HistogramWindow small;
+    for (uint64_t value : {1, 2, 3, 4})
+        small.Add(value, sample);
+    HistogramSnapshot smallSnapshot;
+    small.MergeTo(smallSnapshot);
+    BOOST_CHECK_EQUAL(smallSnapshot.Percentile(0.5).count(), 2);
+    BOOST_CHECK_EQUAL(smallSnapshot.Percentile(0.75).count(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(window_rotation)
+{
+    RequestStatEngine engine;
+    int64_t now = engine.GetCurrentSystemTime().count() / (STAT_WINDOW_SECONDS * 1000);
+
+    // Same slot of ring - one round apart
+    int64_t recent = now - 5;
+    int64_t expired = recent - STAT_WINDOWS;
+
+    // Sample older than ring is stored but not counted
+    engine.AddSample(MakeSample("test", EpochStart(expired) + RequestTime(1000), 100));
+    BOOST_CHECK_EQUAL(engine.GetNumSamples(), 0U);
+
+    // Next round clears window
+    engine.AddSample(MakeSample("test", EpochStart(recent) + RequestTime(1000), 200));
+    BOOST_CHECK_EQUAL(engine.GetNumSamples(), 1U);
+    BOOST_CHECK_EQUAL(engine.GetAvgRequestTime().count(), 200);
+
+    // Late sample of previous round is dropped
+    engine.AddSample(MakeSample("test", EpochStart(expired) + RequestTime(2000), 100));
+    BOOST_CHECK_EQUAL(engine.GetNumSamples(), 1U);
+
+    // Windows before since are skipped
+    engine.AddSample(MakeSample("other", EpochStart(now - 3) + RequestTime(1000), 400));
+    BOOST_CHECK_EQUAL(engine.GetNumSamples(), 2U);
+    BOOST_CHECK_EQUAL(engine.GetNumSamplesSince(EpochStart(now - 3)), 1U);
+    BOOST_CHECK_EQUAL(engine.GetAvgRequestTimeSince(EpochStart(now - 3)).count(), 400);
+    BOOST_CHECK_EQUAL(engine.GetAvgRequestTime().count(), 300);
+
+    // Work queue samples are not requests
+    engine.AddSample(MakeSample(STAT_WORKQUEUE_KEY, EpochStart(now - 3) + RequestTime(1000), 10));
+    BOOST_CHECK_EQUAL(engine.GetNumSamples(), 2U);
+    BOOST_CHECK_EQUAL(engine.GetWorkQueueAvgCount(RequestTime::min()), 1);
+
+    // Top samples of counted windows only
+    auto top = engine.GetTopHeavyTimeSamples(10);
+    BOOST_CHECK_EQUAL(top.size(), 2U);
+    BOOST_CHECK_EQUAL(top[0].Key, "other");
+}
+
+BOOST_AUTO_TEST_CASE(unique_ips)
+{
+    RequestStatEngine engine;
+    int64_t now = engine.GetCurrentSystemTime().count() / (STAT_WINDOW_SECONDS * 1000);
+
+    BOOST_CHECK_EQUAL(engine.GetNumUniqueSourceIPsSince(RequestTime::min()), 0U);
+
+    // Repeated source counted once
+    for (int i = 0; i < 10; i++)
+        engine.AddSample(MakeSample("test", EpochStart(now - 2) + RequestTime(1000), 1, "10.0.0.1"));
+    BOOST_CHECK_EQUAL(engine.GetNumUniqueSourceIPsSince(RequestTime::min()), 1U);
+
+    // Linear counting error is small while bitmap is sparse
+    for (int i = 0; i < 500; i++)
+        engine.AddSample(MakeSample("test", EpochStart(now - 2 - i % 3) + RequestTime(1000), 1, "10.1." + std::to_string(i / 256) + "." + std::to_string(i % 256)));
+
+    size_t estimated = engine.GetNumUniqueSourceIPsSince(RequestTime::min());
+    BOOST_CHECK(estimated >= 470 && estimated <= 530);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -43,8 +43,13 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -55,7 +60,7 @@
 #include <index/addrindex.h>
 
 using WsServer = SimpleWeb::SocketServer<SimpleWeb::WS>;
-std::map<std::string, WSUser> WSConnections;
+WSConnectionRegistry WSConnections;
 
 #if defined(NDEBUG)
 #error "Pocketcoin cannot be compiled without assertions."
@@ -199,6 +204,10 @@ public:
 
     void PruneBlockIndexCandidates();
 
+    // Build and send messages of connected block to WebSocket clients
+    void NotifyWSClients(const CBlock& block, const CBlockIndex* blockIndex);
+    void PrepareWSMessage(std::map<std::string, std::vector<UniValue>>& messages, std::string msg_type, std::string addrTo, std::string txid, int64_t txtime, custom_fields cFields = custom_fields());
+
     void UnloadBlockIndex();
 
     void InvalidBlockFound(CBlockIndex* pindex, const CValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -206,8 +215,6 @@ public:
 private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions& disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    void NotifyWSClients(const CBlock& block, CBlockIndex* blockIndex);
-    void PrepareWSMessage(std::map<std::string, std::vector<UniValue>>& messages, std::string msg_type, std::string addrTo, std::string txid, int64_t txtime, custom_fields cFields = custom_fields());
 
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
@@ -1836,6 +1843,39 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
+/** Write PocketNET data of block to RIDB and index block.
+ *  Data can received by another node or this node created new block
+ *  and data in mempool. */
+static bool WriteBlockRIData(const CBlock& block, CBlockIndex* pindex)
+{
+    uint256 blockhash = block.GetHash();
+
+    // Write received PocketNET data to RIDB
+    PocketBlockData _pocket_data;
+    if (POCKETNET_DATA.Get(blockhash, _pocket_data)) {
+        if (!g_addrindex->SetBlockRIData(block, _pocket_data, pindex->nHeight)) {
+            LogPrintf("--- Failed restore received data (%s) (AddrIndex::SetBlockRIData)\n", blockhash.GetHex());
+            return false;
+        }
+
+        POCKETNET_DATA.Erase(blockhash);
+    }
+
+    // Get data from RIMempool and write to general RI tables
+    if (!g_addrindex->CommitRIMempool(block, pindex->nHeight)) {
+        LogPrintf("--- Failed restore RI Mempool block (%s) (AddrIndex::CommitRIMempool)\n", blockhash.GetHex());
+        return false;
+    }
+
+    // Indexing new block
+    if (!g_addrindex->IndexBlock(block, pindex)) {
+        LogPrintf("--- Failed indexing block (%s)\n", blockhash.GetHex());
+        return false;
+    }
+
+    return true;
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -2202,34 +2242,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     // Try write reindexer data
-    // Data can received by another node or this node created new block
-    // and data in mempool
-    {
-        uint256 blockhash = block.GetHash();
-
-        // Write received PocketNET data to RIDB
-        if (POCKETNET_DATA.find(blockhash) != POCKETNET_DATA.end()) {
-            std::string _pocket_data = POCKETNET_DATA[blockhash];
-            if (!g_addrindex->SetBlockRIData(block, _pocket_data, pindex->nHeight)) {
-                LogPrintf("--- Failed restore received data (%s) (AddrIndex::SetBlockRIData)\n", blockhash.GetHex());
-                return false;
-            }
-
-            POCKETNET_DATA.erase(blockhash);
-        }
-
-        // Get data from RIMempool and write to general RI tables
-        if (!g_addrindex->CommitRIMempool(block, pindex->nHeight)) {
-            LogPrintf("--- Failed restore RI Mempool block (%s) (AddrIndex::CommitRIMempool)\n", blockhash.GetHex());
-            return false;
-        }
-
-        // Indexing new block
-        if (!g_addrindex->IndexBlock(block, pindex)) {
-            LogPrintf("--- Failed indexing block (%s)\n", blockhash.GetHex());
-            return false;
-        }
+    // Items of block hashed for RHash while written
+    g_pocketdb->BeginBlockWrite(pindex->nHeight, true);
+    if (!WriteBlockRIData(block, pindex)) {
+        // Remove partially written data of this block
+        g_pocketdb->AbortBlockWrite();
+        g_addrindex->RollbackDB(pindex->nHeight - 1, true);
+        return false;
     }
+    g_pocketdb->EndBlockWrite();
     //-----------------------------------------------------
     int64_t nTime4 = GetTimeMicros();
     nTimeVerify += nTime4 - nTime2;
@@ -2238,6 +2259,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (fJustCheck)
         return true;
 
+    // Spent outputs and rating history below reorg horizon not needed
+    if (!g_pocketdb->PruneUTXO(pindex->nHeight).ok())
+        LogPrintf("--- Failed prune UTXO on block (%s)\n", block.GetHash().GetHex());
+    if (!g_pocketdb->CheckpointRatings(pindex->nHeight).ok())
+        LogPrintf("--- Failed checkpoint ratings on block (%s)\n", block.GetHash().GetHex());
+
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
@@ -2411,11 +2438,29 @@ static void AppendWarning(std::string& res, const std::string& warn)
     res += warn;
 }
 
+/** Drop received PocketNET data of blocks that will not be connected anymore:
+ *  already connected, invalid and side chain blocks deep below the new tip. */
+static void EvictStalePocketData(const CBlockIndex* pindexNew)
+{
+    AssertLockHeld(cs_main);
+
+    POCKETNET_DATA.EraseIf([pindexNew](const uint256& blockhash) {
+        auto mi = mapBlockIndex.find(blockhash);
+        if (mi == mapBlockIndex.end()) return false;
+
+        const CBlockIndex* pindex = mi->second;
+        if (pindex->nStatus & BLOCK_FAILED_MASK) return true;
+        if (chainActive.Contains(pindex)) return true;
+        return pindex->nHeight + POCKET_DATA_FORK_DEPTH < pindexNew->nHeight;
+    });
+}
+
 /** Check warning conditions and do some notifications on new chain tip set. */
 void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainParams)
 {
     // New best block
     mempool.AddTransactionsUpdated(1);
+    EvictStalePocketData(pindexNew);
 
     {
         LOCK(g_best_block_mutex);
@@ -2681,15 +2726,6 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
-    uint256 _block_hash = blockConnecting.GetHash();
-    std::string _block_hash_str = _block_hash.GetHex();
-
-    // Compute messages for sending by WebSocket
-    if (!WSConnections.empty()) {
-        //std::thread server_thread(&NotifyWSClients, blockConnecting);
-        //server_thread.detach();
-        NotifyWSClients(blockConnecting, pindexNew);
-    }
     //-----------------------------------------------------
     LogPrint(BCLog::SYNC, "+++ Block connected to chain: %d BH:%s\n", pindexNew->nHeight, pindexNew->GetBlockHash().GetHex());
     //-----------------------------------------------------
@@ -2699,7 +2735,103 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
 
 typedef std::map<std::string, std::string> custom_fields;
 
-void CChainState::NotifyWSClients(const CBlock& block, CBlockIndex* blockIndex)
+/** Max connected blocks waiting for WebSocket notification, older blocks dropped */
+static const size_t WS_NOTIFY_QUEUE_SIZE = 100;
+
+namespace {
+/**
+ * Builds WebSocket messages for connected blocks in own thread,
+ * so block connection not waits for the messages DB queries.
+ */
+class WSNotifier final : public CValidationInterface
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::pair<std::shared_ptr<const CBlock>, const CBlockIndex*>> queue;
+    bool fStop = false;
+    std::thread thread;
+
+    void Loop()
+    {
+        RenameThread("pocketcoin-wsnotify");
+
+        while (true) {
+            std::shared_ptr<const CBlock> block;
+            const CBlockIndex* pindex;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                cond.wait(lock, [this] { return fStop || !queue.empty(); });
+                if (fStop) return;
+
+                block = queue.front().first;
+                pindex = queue.front().second;
+                queue.pop_front();
+            }
+
+            try {
+                g_chainstate.NotifyWSClients(*block, pindex);
+            } catch (const std::exception& e) {
+                LogPrintf("Error: WSNotifier - %s\n", e.what());
+            }
+        }
+    }
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override
+    {
+        if (WSConnections.Empty()) return;
+
+        std::lock_guard<std::mutex> lock(cs);
+        if (queue.size() >= WS_NOTIFY_QUEUE_SIZE) {
+            LogPrint(BCLog::SYNC, "WSNotifier queue full, skip notifications for block %s\n", queue.front().first->GetHash().GetHex());
+            queue.pop_front();
+        }
+
+        queue.emplace_back(block, pindex);
+        cond.notify_one();
+    }
+
+public:
+    void Start()
+    {
+        thread = std::thread(&WSNotifier::Loop, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+            queue.clear();
+        }
+        cond.notify_all();
+
+        if (thread.joinable()) thread.join();
+    }
+};
+} // namespace
+
+static std::unique_ptr<WSNotifier> g_ws_notifier;
+
+void StartWSNotifications()
+{
+    assert(!g_ws_notifier);
+    g_ws_notifier.reset(new WSNotifier());
+    g_ws_notifier->Start();
+    RegisterValidationInterface(g_ws_notifier.get());
+}
+
+void StopWSNotifications()
+{
+    if (!g_ws_notifier) return;
+
+    UnregisterValidationInterface(g_ws_notifier.get());
+    g_ws_notifier->Stop();
+    g_ws_notifier.reset();
+}
+
+void CChainState::NotifyWSClients(const CBlock& block, const CBlockIndex* blockIndex)
 {
     // <address, [messages]>
     std::map<std::string, std::vector<UniValue>> messages;
@@ -3026,9 +3158,61 @@ void CChainState::NotifyWSClients(const CBlock& block, CBlockIndex* blockIndex)
         }
         contentsLang.pushKV(getcontenttype(getcontenttype(itemContent.first)), langContents);
     }
-    for (auto& connWS : WSConnections) {
+
+    // Count of new posts from subscriptions for connected clients:
+    // one reverse index <author, posts count> for block instead of queries for every client
+    std::map<std::string, int> sharesSubscr;
+    {
+        std::vector<std::string> clientAddrs = WSConnections.Addresses();
+
+        std::map<std::string, int> authorShares;
+        reindexer::QueryResults queryResShares;
+        reindexer::Error err = g_pocketdb->DB()->Select(
+            reindexer::Query("Posts")
+                .Where("block", CondEq, blockIndex->nHeight),
+            queryResShares);
+        if (err.ok()) {
+            for (auto it : queryResShares) {
+                reindexer::Item itm(it.GetItem());
+                authorShares[itm["address"].As<string>()] += 1;
+            }
+        }
+
+        if (!authorShares.empty() && !clientAddrs.empty()) {
+            std::vector<std::string> authors;
+            for (const auto& author : authorShares) authors.push_back(author.first);
+
+            reindexer::QueryResults queryResSubscribes;
+            err = g_pocketdb->DB()->Select(
+                reindexer::Query("SubscribesView")
+                    .Where("address", CondSet, clientAddrs)
+                    .Where("address_to", CondSet, authors),
+                queryResSubscribes);
+            if (err.ok()) {
+                for (auto it : queryResSubscribes) {
+                    reindexer::Item itm(it.GetItem());
+                    sharesSubscr[itm["address"].As<string>()] += authorShares[itm["address_to"].As<string>()];
+                }
+            }
+        }
+    }
+
+    std::string pocketnetMsg;
+    if (txidpocketnet != "") {
+        UniValue m(UniValue::VOBJ);
+        m.pushKV("msg", "sharepocketnet");
+        m.pushKV("time", std::to_string(block.nTime));
+        m.pushKV("txids", txidpocketnet.substr(0, txidpocketnet.size() - 1));
+        pocketnetMsg = m.write();
+    }
+
+    // Broadcast new block to all clients - shard by shard
+    std::unordered_set<std::string> notified;
+    WSConnections.ForEach([&](const std::string& id, WSUser& connWS) {
+        if (blockIndex->nHeight <= connWS.Block) return;
+
         UniValue msg(UniValue::VOBJ);
-        msg.pushKV("addr", connWS.second.Address);
+        msg.pushKV("addr", connWS.Address);
         msg.pushKV("msg", "new block");
         msg.pushKV("blockhash", _block_hash.GetHex());
         msg.pushKV("time", std::to_string(block.nTime));
@@ -3037,61 +3221,45 @@ void CChainState::NotifyWSClients(const CBlock& block, CBlockIndex* blockIndex)
         //msg.pushKV("sharesLang", sharesLang);
         msg.pushKV("contentsLang", contentsLang);
 
-        reindexer::QueryResults queryResSubscribes;
-        reindexer::Error err = g_pocketdb->DB()->Select(
-            reindexer::Query("SubscribesView")
-                .Where("address", CondEq, connWS.second.Address),
-            queryResSubscribes);
-
-        if (err.ok() && queryResSubscribes.Count() > 0) {
-            std::vector<string> _addrs;
-            for (auto it : queryResSubscribes) {
-                reindexer::Item itm(it.GetItem());
-                _addrs.push_back(itm["address_to"].As<string>());
-            }
+        auto itSubscr = sharesSubscr.find(connWS.Address);
+        if (itSubscr != sharesSubscr.end()) {
+            msg.pushKV("sharesSubscr", itSubscr->second);
+        }
 
-            reindexer::QueryResults queryResShares;
-            reindexer::Error err = g_pocketdb->DB()->Select(
-                reindexer::Query("Posts")
-                    .Where("block", CondEq, blockIndex->nHeight)
-                    .Where("address", CondSet, _addrs),
-                queryResShares);
-            if (err.ok() && queryResShares.Count() > 0) {
-                msg.pushKV("sharesSubscr", (int)queryResShares.Count());
-            }
+        try {
+            connWS.Connection->send(msg.write(), [](const SimpleWeb::error_code& ec) {});
+        } catch (const std::exception& e) {
+            LogPrintf("Error: CChainState::NotifyWSClients (1) - %s\n", e.what());
         }
 
-        if (blockIndex->nHeight > connWS.second.Block) {
+        if (!pocketnetMsg.empty()) {
             try {
-                connWS.second.Connection->send(msg.write(), [](const SimpleWeb::error_code& ec) {});
+                connWS.Connection->send(pocketnetMsg, [](const SimpleWeb::error_code& ec) {});
             } catch (const std::exception& e) {
                 LogPrintf("Error: CChainState::NotifyWSClients (1) - %s\n", e.what());
             }
+        }
+
+        connWS.Block = blockIndex->nHeight;
+        notified.insert(id);
+    });
+
+    // Events only to connections of recipients
+    for (const auto& addrMessages : messages) {
+        std::vector<std::string> _messages;
+        for (const auto& m : addrMessages.second) _messages.push_back(m.write());
+
+        WSConnections.ForEachByAddress(addrMessages.first, [&](const std::string& id, WSUser& connWS) {
+            if (notified.find(id) == notified.end()) return;
 
-            if (txidpocketnet != "") {
+            for (const auto& m : _messages) {
                 try {
-                    UniValue m(UniValue::VOBJ);
-                    m.pushKV("msg", "sharepocketnet");
-                    m.pushKV("time", std::to_string(block.nTime));
-                    m.pushKV("txids", txidpocketnet.substr(0, txidpocketnet.size() - 1));
-                    connWS.second.Connection->send(m.write(), [](const SimpleWeb::error_code& ec) {});
+                    connWS.Connection->send(m, [](const SimpleWeb::error_code& ec) {});
                 } catch (const std::exception& e) {
-                    LogPrintf("Error: CChainState::NotifyWSClients (1) - %s\n", e.what());
+                    LogPrintf("Error: CChainState::NotifyWSClients (2) - %s\n", e.what());
                 }
             }
-
-            if (messages.find(connWS.second.Address) != messages.end()) {
-                for (auto m : messages[connWS.second.Address]) {
-                    try {
-                        connWS.second.Connection->send(m.write(), [](const SimpleWeb::error_code& ec) {});
-                    } catch (const std::exception& e) {
-                        LogPrintf("Error: CChainState::NotifyWSClients (2) - %s\n", e.what());
-                    }
-                }
-            }
-
-            connWS.second.Block = blockIndex->nHeight;
-        }
+        });
     }
 }
 
@@ -3818,22 +3986,21 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     return true;
 }
 
-bool FindRTransaction(UniValue& _txs_src, const CTransactionRef& tx, std::string ri_table, reindexer::Item& itm)
+bool FindRTransaction(const PocketBlockData& _txs_src, const CTransactionRef& tx, std::string ri_table, reindexer::Item& itm)
 {
     std::string txid = tx->GetHash().GetHex();
 
     // Maybe data received from another node?
-    if (_txs_src.exists(txid)) {
-        std::string _tx_src = _txs_src[txid].get_str();
-        UniValue _tx(UniValue::VOBJ);
-        if (!_tx.read(_tx_src)) {
-            LogPrintf("700001: Transaction RI data parse failed (%s): %s\n", txid, _tx_src);
+    auto _tx = _txs_src.find(tx->GetHash());
+    if (_tx != _txs_src.end()) {
+        if (_tx->second.table.empty()) {
+            LogPrintf("700001: Transaction RI data parse failed (%s): empty table\n", txid);
             return false;
         }
 
-        ri_table = _tx["t"].get_str();
+        ri_table = _tx->second.table;
         itm = g_pocketdb->DB()->NewItem(ri_table);
-        _tx_src = DecodeBase64(_tx["d"].get_str());
+        std::string _tx_src = _tx->second.data;
         if (!itm.FromJSON(_tx_src).ok()) {
             LogPrintf("700002: Transaction RI data parse failed (%s): %s\n", txid, _tx_src);
             return false;
@@ -3896,11 +4063,8 @@ bool CheckBlockAdditional(CBlockIndex* pindex, const CBlock& block, CValidationS
         // }
 
         // Read and parse received block data
-        UniValue _txs_src(UniValue::VOBJ);
-        if (POCKETNET_DATA.find(blockhash) != POCKETNET_DATA.end()) {
-            std::string _pocket_data = POCKETNET_DATA[blockhash];
-            _txs_src.read(_pocket_data);
-        }
+        PocketBlockData _txs_src;
+        POCKETNET_DATA.Get(blockhash, _txs_src);
 
         // TODO (brangr): change UniValue to RTransaction
         BlockVTX blockVtx;
@@ -35,7 +35,7 @@
 #include <atomic>
 
 #include <websocket/ws.h>
-extern std::map<std::string, WSUser> WSConnections;
+extern WSConnectionRegistry WSConnections;
 
 class CBlockIndex;
 class CBlockTreeDB;
@@ -420,7 +420,7 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
 
-bool FindRTransaction(UniValue& _txs_src, const CTransactionRef& tx, std::string ri_table, reindexer::Item& itm);
+bool FindRTransaction(const PocketBlockData& _txs_src, const CTransactionRef& tx, std::string ri_table, reindexer::Item& itm);
 bool CheckBlockAdditional(CBlockIndex* pindex, const CBlock& block, CValidationState& state);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
@@ -534,6 +534,10 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Start/stop thread sending notifications of connected blocks to WebSocket clients. */
+void StartWSNotifications();
+void StopWSNotifications();
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
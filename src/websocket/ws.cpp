@@ -1 +1,108 @@
 #include <websocket/ws.h>
+
+WSConnectionRegistry::Shard& WSConnectionRegistry::shard(const std::string& id)
+{
+    return shards[std::hash<std::string>()(id) % SHARDS];
+}
+
+void WSConnectionRegistry::eraseAddress(const std::string& address, const std::string& id)
+{
+    auto it = addresses.find(address);
+    if (it == addresses.end()) return;
+
+    it->second.erase(id);
+    if (it->second.empty()) addresses.erase(it);
+}
+
+void WSConnectionRegistry::Set(const std::string& id, const WSUser& user)
+{
+    bool replaced = false;
+    std::string oldAddress;
+    {
+        Shard& s = shard(id);
+        std::lock_guard<std::mutex> lock(s.cs);
+
+        auto it = s.connections.find(id);
+        if (it != s.connections.end()) {
+            replaced = true;
+            oldAddress = it->second.Address;
+            it->second = user;
+        } else {
+            s.connections.emplace(id, user);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cs_addresses);
+    if (replaced) eraseAddress(oldAddress, id);
+    addresses[user.Address].insert(id);
+}
+
+void WSConnectionRegistry::Erase(const std::string& id)
+{
+    std::string address;
+    {
+        Shard& s = shard(id);
+        std::lock_guard<std::mutex> lock(s.cs);
+
+        auto it = s.connections.find(id);
+        if (it == s.connections.end()) return;
+
+        address = it->second.Address;
+        s.connections.erase(it);
+    }
+
+    std::lock_guard<std::mutex> lock(cs_addresses);
+    eraseAddress(address, id);
+}
+
+bool WSConnectionRegistry::Empty() const
+{
+    std::lock_guard<std::mutex> lock(cs_addresses);
+    return addresses.empty();
+}
+
+size_t WSConnectionRegistry::Size() const
+{
+    std::lock_guard<std::mutex> lock(cs_addresses);
+
+    size_t size = 0;
+    for (const auto& it : addresses) size += it.second.size();
+    return size;
+}
+
+std::vector<std::string> WSConnectionRegistry::Addresses() const
+{
+    std::lock_guard<std::mutex> lock(cs_addresses);
+
+    std::vector<std::string> result;
+    result.reserve(addresses.size());
+    for (const auto& it : addresses) result.push_back(it.first);
+    return result;
+}
+
+void WSConnectionRegistry::ForEach(const std::function<void(const std::string& id, WSUser& user)>& func)
+{
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s.cs);
+        for (auto& it : s.connections) func(it.first, it.second);
+    }
+}
+
+void WSConnectionRegistry::ForEachByAddress(const std::string& address, const std::function<void(const std::string& id, WSUser& user)>& func)
+{
+    std::vector<std::string> ids;
+    {
+        std::lock_guard<std::mutex> lock(cs_addresses);
+        auto it = addresses.find(address);
+        if (it == addresses.end()) return;
+        ids.assign(it->second.begin(), it->second.end());
+    }
+
+    for (const auto& id : ids) {
+        Shard& s = shard(id);
+        std::lock_guard<std::mutex> lock(s.cs);
+
+        auto it = s.connections.find(id);
+        if (it != s.connections.end()) func(it->first, it->second);
+    }
+}
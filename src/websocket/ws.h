@@ -6,13 +6,18 @@
 
 #include <array>
 #include <atomic>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #ifdef USE_STANDALONE_ASIO
 #include <asio.hpp>
@@ -890,5 +895,41 @@ struct WSUser {
     int WssPort;
 };
 
+// Registry of connected users
+// Connections are split by id to shards with own locks,
+// secondary index address -> connection ids used for send events to recipients only
+class WSConnectionRegistry {
+private:
+    static const size_t SHARDS = 16;
+
+    struct Shard {
+        std::mutex cs;
+        std::map<std::string, WSUser> connections;
+    };
+
+    std::array<Shard, SHARDS> shards;
+
+    mutable std::mutex cs_addresses;
+    std::unordered_map<std::string, std::set<std::string>> addresses;
+
+    Shard& shard(const std::string& id);
+    void eraseAddress(const std::string& address, const std::string& id);
+
+public:
+    // Add or replace connection
+    void Set(const std::string& id, const WSUser& user);
+    void Erase(const std::string& id);
+
+    bool Empty() const;
+    size_t Size() const;
+    // Unique addresses of all connections
+    std::vector<std::string> Addresses() const;
+
+    // Call func for every connection, shard locked while called
+    void ForEach(const std::function<void(const std::string& id, WSUser& user)>& func);
+    // Call func for every connection of address
+    void ForEachByAddress(const std::string& address, const std::function<void(const std::string& id, WSUser& user)>& func);
+};
+
 
 #endif /* SERVER_WS_HPP */